@@ -0,0 +1,59 @@
+#include "CommitScheduler.h"
+
+CommitScheduler::CommitScheduler(CommitFn commit, std::chrono::microseconds window)
+    : commitFn(std::move(commit)), window(window), hasPending(false), stopping(false), commitCount(0) {
+    worker = std::thread(&CommitScheduler::run, this);
+}
+
+CommitScheduler::~CommitScheduler() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+std::shared_future<bool> CommitScheduler::request() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!hasPending) {
+        pending = std::promise<bool>();
+        pendingResult = pending.get_future().share();
+        hasPending = true;
+        firstRequest = std::chrono::steady_clock::now();
+        wake.notify_one();
+    }
+    return pendingResult;
+}
+
+void CommitScheduler::setWindow(std::chrono::microseconds newWindow) {
+    std::lock_guard<std::mutex> guard(lock);
+    window = newWindow;
+    wake.notify_one();
+}
+
+void CommitScheduler::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        wake.wait(guard, [this] { return hasPending || stopping; });
+        if (!hasPending) return; // Stopping with nothing left to commit
+
+        // Let the batch fill until its window closes (at once when stopping)
+        while (!stopping && std::chrono::steady_clock::now() < firstRequest + window) {
+            wake.wait_until(guard, firstRequest + window);
+        }
+        std::promise<bool> batch = std::move(pending);
+        hasPending = false;
+
+        guard.unlock();
+        bool ok;
+        try {
+            ok = commitFn();
+        } catch (...) {
+            ok = false;
+        }
+        ++commitCount;
+        batch.set_value(ok);
+        guard.lock();
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef COMMITSCHEDULER_H
+#define COMMITSCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+// Group commit. request() asks for every change made so far to become durable and
+// returns a future for it. A background thread waits up to `window` after the first
+// pending request so that others can join it, then runs the commit function once
+// for the whole batch. A request is only satisfied by a commit that starts after it
+// was made; requests arriving during a commit form the next batch.
+class CommitScheduler {
+public:
+    typedef std::function<bool()> CommitFn;
+
+    CommitScheduler(CommitFn commit, std::chrono::microseconds window);
+    // Commits any pending batch, then stops the thread
+    ~CommitScheduler();
+    CommitScheduler(const CommitScheduler&) = delete;
+    CommitScheduler& operator=(const CommitScheduler&) = delete;
+
+    std::shared_future<bool> request();
+    void setWindow(std::chrono::microseconds window);
+
+    uint64_t commits() const { return commitCount; } // Commit function runs so far
+
+private:
+    void run();
+
+    CommitFn commitFn;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::chrono::microseconds window;
+    std::promise<bool> pending;             // Batch being collected
+    std::shared_future<bool> pendingResult;
+    bool hasPending;
+    std::chrono::steady_clock::time_point firstRequest; // Start of the current window
+    bool stopping;
+    std::atomic<uint64_t> commitCount;
+    std::thread worker;
+};
+
+#endif
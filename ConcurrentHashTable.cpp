@@ -0,0 +1,130 @@
+#include "ConcurrentHashTable.h"
+#include <functional>
+#include <mutex>
+
+ConcurrentHashTable::ConcurrentHashTable(int shardCount, int capPerShard) {
+    size_t n = 1;
+    while (n < static_cast<size_t>(shardCount)) n *= 2;
+    for (size_t i = 0; i < n; ++i) {
+        shards.push_back(std::unique_ptr<Shard>(new Shard(capPerShard)));
+    }
+    shardMask = n - 1;
+}
+
+// Picks the shard for a site. The high bits of the mixed hash are used, so shard
+// choice stays independent of the bits each shard's own table probes with.
+ConcurrentHashTable::Shard& ConcurrentHashTable::shardFor(std::string_view site) const {
+    uint64_t h = std::hash<std::string_view>()(site);
+    h *= 0x9E3779B97F4A7C15ULL;
+    return *shards[(h >> 40) & shardMask];
+}
+
+void ConcurrentHashTable::insert(const Credential& cred) {
+    emplace(cred.site, cred.username, cred.password);
+}
+
+void ConcurrentHashTable::emplace(std::string_view site, std::string_view username, std::string_view password) {
+    Shard& shard = shardFor(site);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    shard.table.emplace(site, username, password);
+}
+
+// Returns a heap copy of the credential, independent of the shard's storage
+std::optional<Credential> ConcurrentHashTable::search(std::string_view site, std::string_view username) const {
+    Shard& shard = shardFor(site);
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    const HashTable& table = shard.table; // The read-only lookup: readers share the lock
+    const Credential* cred = table.search(site, username);
+    if (cred == nullptr) return std::nullopt;
+    return Credential(*cred);
+}
+
+bool ConcurrentHashTable::update(std::string_view site, std::string_view username, std::string_view newPassword) {
+    Shard& shard = shardFor(site);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    return shard.table.update(site, username, newPassword);
+}
+
+bool ConcurrentHashTable::remove(std::string_view site, std::string_view username) {
+    Shard& shard = shardFor(site);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    return shard.table.remove(site, username);
+}
+
+int ConcurrentHashTable::size() const {
+    int total = 0;
+    for (const std::unique_ptr<Shard>& shard : shards) {
+        std::shared_lock<std::shared_mutex> guard(shard->lock);
+        total += shard->table.size();
+    }
+    return total;
+}
+
+// Locks are always taken in shard order, so save/load/clear cannot deadlock each other
+bool ConcurrentHashTable::save(const std::string& filename, std::string_view key) const {
+    HashTable merged(101);
+    {
+        std::vector<std::shared_lock<std::shared_mutex>> guards;
+        int total = 0;
+        for (const std::unique_ptr<Shard>& shard : shards) {
+            guards.emplace_back(shard->lock);
+            total += shard->table.size();
+        }
+        merged.reserve(total);
+        for (const std::unique_ptr<Shard>& shard : shards) {
+            shard->table.forEach([&merged](const Credential& cred) {
+                merged.emplace(cred.site, cred.username, cred.password);
+            });
+        }
+    }
+    // Writers may continue while the copy is encrypted and synced to disk
+    return merged.save(filename, key);
+}
+
+bool ConcurrentHashTable::load(const std::string& filename, std::string_view key) {
+    // Read and verify outside the locks; readers keep going until the swap
+    HashTable loaded(101);
+    if (!loaded.load(filename, key)) return false;
+
+    std::vector<std::unique_lock<std::shared_mutex>> guards;
+    for (std::unique_ptr<Shard>& shard : shards) {
+        guards.emplace_back(shard->lock);
+        shard->table.clear();
+    }
+    loaded.forEach([this](const Credential& cred) {
+        shardFor(cred.site).table.emplace(cred.site, cred.username, cred.password);
+    });
+    return true;
+}
+
+void ConcurrentHashTable::clear() {
+    for (std::unique_ptr<Shard>& shard : shards) {
+        std::unique_lock<std::shared_mutex> guard(shard->lock);
+        shard->table.clear();
+    }
+}
+
+ConcurrentHashTable::~ConcurrentHashTable() {
+    disableGroupCommit();
+}
+
+void ConcurrentHashTable::enableGroupCommit(const std::string& filename, std::string_view key,
+                                            std::chrono::microseconds window) {
+    disableGroupCommit();
+    commitFile = filename;
+    commitKey.assign(key.data(), key.size());
+    committer = std::make_unique<CommitScheduler>([this]() { return save(commitFile, commitKey); }, window);
+}
+
+void ConcurrentHashTable::disableGroupCommit() {
+    committer.reset(); // Runs a pending save first
+}
+
+std::shared_future<bool> ConcurrentHashTable::commit() {
+    if (!committer) {
+        std::promise<bool> disabled;
+        disabled.set_value(false);
+        return disabled.get_future().share();
+    }
+    return committer->request();
+}
@@ -0,0 +1,87 @@
+#ifndef CONCURRENTHASHTABLE_H
+#define CONCURRENTHASHTABLE_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <memory>
+#include <shared_mutex>
+#include <future>
+#include <chrono>
+#include "HashTable.h"
+#include "CommitScheduler.h"
+
+// Thread-safe credential store for multi-threaded services.
+// The key space is split by site across independent HashTable shards, each
+// guarded by its own reader-writer lock: lookups on any shard run in parallel,
+// and an insert (or the incremental resize it drives) only blocks its own shard.
+// All accounts of a site live in the same shard, so site-only lookups touch one lock.
+//
+// Lookups return copies (or run a callback under the shard's read lock) instead
+// of raw pointers, because a pointer into a shard is not protected once its lock
+// is released.
+class ConcurrentHashTable {
+private:
+    struct Shard {
+        mutable std::shared_mutex lock;
+        HashTable table;
+
+        explicit Shard(int cap) : table(cap) {}
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t shardMask;
+    std::string commitFile;                     // Target of group commits
+    std::string commitKey;
+    std::unique_ptr<CommitScheduler> committer; // Set by enableGroupCommit()
+
+    Shard& shardFor(std::string_view site) const;
+
+public:
+    // shardCount is rounded up to a power of two
+    explicit ConcurrentHashTable(int shardCount = 16, int capPerShard = 101);
+    ~ConcurrentHashTable();
+
+    void insert(const Credential& cred);
+    void emplace(std::string_view site, std::string_view username, std::string_view password);
+    std::optional<Credential> search(std::string_view site, std::string_view username = std::string_view()) const;
+    bool update(std::string_view site, std::string_view username, std::string_view newPassword);
+    bool remove(std::string_view site, std::string_view username);
+
+    // Guarded access: calls fn(const Credential&) while the shard is read-locked.
+    // Returns false (without calling fn) if the credential is not found.
+    template <class Fn>
+    bool visit(std::string_view site, std::string_view username, Fn fn) const {
+        Shard& shard = shardFor(site);
+        std::shared_lock<std::shared_mutex> guard(shard.lock);
+        const HashTable& table = shard.table; // The read-only lookup: readers share the lock
+        const Credential* cred = table.search(site, username);
+        if (cred == nullptr) return false;
+        fn(*cred);
+        return true;
+    }
+
+    int size() const;
+    int shardCount() const { return static_cast<int>(shards.size()); }
+
+    // Persistence uses the single-table file format. save() holds every shard's
+    // read lock while copying the entries out (not while writing them); load()
+    // replaces the contents of all shards.
+    bool save(const std::string& filename, std::string_view key) const;
+    bool load(const std::string& filename, std::string_view key);
+    void clear();
+
+    // Group commit. After enableGroupCommit(), commit() returns a future that becomes
+    // true once the table as of the call is durably saved to filename. Calls within
+    // `window` of the first pending one, and calls made while a save is running,
+    // share one save (file fsync, rename, directory fsync). Set up before the table
+    // is shared between threads; disableGroupCommit() waits for a pending save.
+    void enableGroupCommit(const std::string& filename, std::string_view key,
+                           std::chrono::microseconds window = std::chrono::milliseconds(2));
+    void disableGroupCommit();
+    std::shared_future<bool> commit();
+    uint64_t commits() const { return committer ? committer->commits() : 0; } // Saves run so far
+};
+
+#endif
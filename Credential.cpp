@@ -1,40 +1,87 @@
 #include "Credential.h"
-#include <sstream>
+#include <algorithm>
 
 // Constructor implementation
-Credential::Credential(std::string s, std::string u, std::string p) 
+Credential::Credential(std::string_view s, std::string_view u, std::string_view p)
     : site(s), username(u), password(p) {}
 
+Credential::Credential(const allocator_type& alloc)
+    : site(alloc), username(alloc), password(alloc) {}
+
+void Credential::wipePassword() {
+    volatile char* bytes = password.data();
+    for (size_t i = 0; i < password.size(); ++i) bytes[i] = '\0';
+    password.clear();
+}
+
 // formatting: "site","username","password"
 std::string Credential::toCSV() const {
-    return "\"" + site + "\",\"" + username + "\",\"" + password + "\"";
+    std::string out;
+    out.reserve(site.size() + username.size() + password.size() + 8);
+    appendCSV(out);
+    return out;
+}
+
+namespace {
+    // Appends field in quotes, doubling the quotes inside it
+    void appendQuoted(std::string& out, std::string_view field) {
+        out += '"';
+        for (size_t pos = 0;;) {
+            const size_t quote = field.find('"', pos);
+            out.append(field.data() + pos, std::min(quote, field.size()) - pos);
+            if (quote == std::string_view::npos) break;
+            out += "\"\"";
+            pos = quote + 1;
+        }
+        out += '"';
+    }
+
+    // Turns each "" of a parsed field back into one quote
+    void unescapeQuotes(std::pmr::string& field) {
+        size_t out = 0;
+        for (size_t i = 0; i < field.size(); ++i, ++out) {
+            field[out] = field[i];
+            if (field[i] == '"') ++i;
+        }
+        field.resize(out);
+    }
+}
+
+void Credential::appendCSV(std::string& out) const {
+    appendQuoted(out, site);
+    out += ',';
+    appendQuoted(out, username);
+    out += ',';
+    appendQuoted(out, password);
 }
 
 // Parses a line like: "google.com","bob","123"
-// This manually extracts text between quotes to handle the format safely.
+// Each field is the text between a pair of quotes, where "" stands for a quote;
+// anything outside quotes is skipped.
 Credential Credential::fromCSV(const std::string& line) {
-    std::string s, u, p;
-    std::string temp;
-    int state = 0; // 0 = site, 1 = username, 2 = password
-
-    // Simple parser: loops through the line and extracts content between quotes
-    bool insideQuotes = false;
-    for (char c : line) {
-        if (c == '\"') {
-            // Toggle state when we hit a quote
-            if (insideQuotes) {
-                // End of a field
-                if (state == 0) s = temp;
-                else if (state == 1) u = temp;
-                else if (state == 2) p = temp;
-                temp = "";
-                state++;
-            }
-            insideQuotes = !insideQuotes;
-        } else if (insideQuotes) {
-            // Add character to current field if we are inside quotes
-            temp += c;
+    std::string_view s, u, p;
+    parseCSV(line, s, u, p);
+    Credential cred(s, u, p);
+    unescapeQuotes(cred.site);
+    unescapeQuotes(cred.username);
+    unescapeQuotes(cred.password);
+    return cred;
+}
+
+void Credential::parseCSV(std::string_view line, std::string_view& site,
+                          std::string_view& username, std::string_view& password) {
+    site = username = password = std::string_view();
+    std::string_view* fields[3] = {&site, &username, &password};
+    size_t pos = 0;
+    for (std::string_view* field : fields) {
+        size_t open = line.find('"', pos);
+        if (open == std::string_view::npos) return;
+        size_t close = line.find('"', open + 1);
+        while (close != std::string_view::npos && close + 1 < line.size() && line[close + 1] == '"') {
+            close = line.find('"', close + 2); // An escaped quote, not the end of the field
         }
+        if (close == std::string_view::npos) return;
+        *field = line.substr(open + 1, close - open - 1);
+        pos = close + 1;
     }
-    return Credential(s, u, p);
-}
\ No newline at end of file
+}
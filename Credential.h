@@ -2,23 +2,57 @@
 #define CREDENTIAL_H
 
 #include <string>
+#include <string_view>
 #include <iostream>
+#include <memory_resource>
 
 // The Credential class stores a single login entry.
+// Fields use a polymorphic allocator: credentials stored in a HashTable keep their
+// bytes in the table's string pool, standalone ones use the normal heap. Copying a
+// credential always yields one on the normal heap.
 class Credential {
 public:
-    std::string site;
-    std::string username;
-    std::string password;
+    typedef std::pmr::polymorphic_allocator<char> allocator_type;
+
+    std::pmr::string site;
+    std::pmr::string username;
+    std::pmr::string password;
 
     // Constructor
-    Credential(std::string s = "", std::string u = "", std::string p = "");
+    Credential(std::string_view s = std::string_view(), std::string_view u = std::string_view(),
+               std::string_view p = std::string_view());
+
+    // Empty credential whose strings allocate from the given resource
+    explicit Credential(const allocator_type& alloc);
+
+    // Overwrites the password's bytes with zeros (a write the compiler keeps) and
+    // empties it; the buffer stays allocated
+    void wipePassword();
 
-    // Converts the object data to a CSV formatted string: "site","user","pass"
+    // Converts the object data to a CSV formatted string: "site","user","pass".
+    // A quote inside a field is doubled (RFC 4180); other bytes, newlines included,
+    // are written as they are.
     std::string toCSV() const;
 
+    // Appends the CSV form to out (no temporary string)
+    void appendCSV(std::string& out) const;
+
     // Static method to create a Credential object from a CSV line
     static Credential fromCSV(const std::string& line);
+
+    // Zero-copy counterpart of fromCSV: points the three fields into line. It splits
+    // the line like fromCSV, but an escaped quote stays doubled ("") in the view.
+    // Fields missing from the line are left empty.
+    static void parseCSV(std::string_view line, std::string_view& site,
+                         std::string_view& username, std::string_view& password);
 };
 
-#endif
\ No newline at end of file
+// std::pmr::string and std::string differ in allocator type, and the standard
+// library does not compare them with each other. These keep comparisons of a field
+// with a std::string compiling as they did when the fields were std::string.
+inline bool operator==(const std::pmr::string& a, const std::string& b) { return std::string_view(a) == std::string_view(b); }
+inline bool operator==(const std::string& a, const std::pmr::string& b) { return std::string_view(a) == std::string_view(b); }
+inline bool operator!=(const std::pmr::string& a, const std::string& b) { return !(a == b); }
+inline bool operator!=(const std::string& a, const std::pmr::string& b) { return !(a == b); }
+
+#endif
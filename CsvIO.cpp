@@ -0,0 +1,123 @@
+#include "CsvIO.h"
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    const size_t BLOCK_SIZE = 1 << 20; // Bytes read or written per step
+
+    // The line break that ends the record at pos, or nullptr if there is none before
+    // stop. A line break inside quotes is part of a field; an escaped quote ("")
+    // toggles twice, so the parity of the quotes before a break tells which it is.
+    char* recordEnd(char* pos, const char* stop) {
+        bool quoted = false;
+        while (true) {
+            char* eol = static_cast<char*>(std::memchr(pos, '\n', static_cast<size_t>(stop - pos)));
+            if (eol == nullptr) return nullptr;
+            quoted ^= (std::count(pos, eol, '"') & 1) != 0;
+            if (!quoted) return eol;
+            pos = eol + 1;
+        }
+    }
+
+    // Splits the complete record [pos, end) (without its line break) into three
+    // fields, unquoting quoted fields in place. False unless it holds exactly three
+    // fields, each bare or quoted with nothing but spaces or tabs around the quotes.
+    bool splitRecord(char* pos, char* end, std::string_view (&fields)[3]) {
+        for (size_t count = 0;; ++pos) {
+            while (pos < end && (*pos == ' ' || *pos == '\t')) ++pos;
+            char* const begin = pos + (pos < end && *pos == '"');
+            char* out = begin;
+            if (begin != pos) {
+                for (pos = begin;; ++pos) {
+                    if (pos == end) return false; // No closing quote
+                    if (*pos == '"' && (pos + 1 == end || pos[1] != '"')) break;
+                    pos += *pos == '"';
+                    *out++ = *pos;
+                }
+                ++pos;
+                while (pos < end && (*pos == ' ' || *pos == '\t')) ++pos;
+            } else {
+                while (pos < end && *pos != ',' && *pos != '"') ++pos;
+                out = pos;
+            }
+            if (count == 3) return false;
+            fields[count++] = std::string_view(begin, static_cast<size_t>(out - begin));
+            if (pos == end) return count == 3;
+            if (*pos != ',') return false; // A quote in a bare field, or text after a quoted one
+        }
+    }
+}
+
+// Reads the input a block at a time. Complete records are parsed in place; the
+// unfinished record at the end of a block is moved to the front and completed by
+// the next read, so a record may be longer than a block.
+bool importCsv(HashTable& table, std::istream& in, size_t* imported, size_t* badLine) {
+    size_t records = 0;
+    size_t lineNumber = 0;
+    bool ok = true;
+    std::string block;
+    for (bool last = false; !last && ok;) {
+        const size_t carried = block.size();
+        block.resize(carried + BLOCK_SIZE);
+        in.read(&block[carried], static_cast<std::streamsize>(BLOCK_SIZE));
+        block.resize(carried + static_cast<size_t>(in.gcount()));
+        if (in.bad()) {
+            lineNumber = 0;
+            ok = false;
+            break;
+        }
+        last = !in; // End of input: whatever is left is the last line
+
+        char* pos = &block[0];
+        char* const stop = pos + block.size();
+        table.reserve(table.size() + static_cast<int>(std::count(pos, stop, '\n')) + 1);
+        while (pos < stop) {
+            char* eol = recordEnd(pos, stop);
+            if (eol == nullptr) {
+                if (!last) break; // Completed by the next read
+                eol = stop;
+            }
+            char* const next = eol + (eol < stop);
+            ++lineNumber;
+            const size_t breaks = static_cast<size_t>(std::count(pos, eol, '\n')); // Inside quotes
+            if (eol > pos && eol[-1] == '\r') --eol;
+            if (std::find_if(pos, eol, [](char ch) { return ch != ' ' && ch != '\t'; }) != eol) {
+                std::string_view f[3];
+                if (!splitRecord(pos, eol, f)) {
+                    ok = false;
+                    break;
+                }
+                table.emplace(f[0], f[1], f[2]);
+                ++records;
+            }
+            lineNumber += breaks;
+            pos = next;
+        }
+        block.erase(0, static_cast<size_t>(pos - block.data()));
+    }
+    if (imported != nullptr) *imported = records;
+    if (badLine != nullptr) *badLine = ok ? 0 : lineNumber;
+    return ok;
+}
+
+// Lines are collected in one buffer and written a block at a time
+bool exportCsv(const HashTable& table, std::ostream& out, size_t* exported) {
+    std::string buffer;
+    buffer.reserve(BLOCK_SIZE + 1024);
+    size_t records = 0;
+    table.forEach([&](const Credential& cred) {
+        cred.appendCSV(buffer);
+        buffer += '\n';
+        ++records;
+        if (buffer.size() >= BLOCK_SIZE) {
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    });
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.flush();
+    if (exported != nullptr) *exported = records;
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,27 @@
+#ifndef CSVIO_H
+#define CSVIO_H
+
+#include <iostream>
+#include <cstddef>
+#include "HashTable.h"
+
+// Plain CSV import and export, one "site","username","password" record per credential
+// (the Credential::toCSV format). Fields are quoted as in RFC 4180: a quote inside a
+// field is doubled, and a line break inside quotes belongs to the field, so any
+// bytes round-trip. Both stream in blocks of about 1 MiB, so memory use does not
+// grow with the file.
+
+// Reads every record of in into table. Each block of records is presized with
+// reserve(), unquoted in place and stored with emplace() straight from views into
+// the block, like insertBulk() without building Credentials. An existing
+// site+username is updated. Fields may also be bare (unquoted), spaces and tabs
+// around quoted fields are skipped, blank lines are skipped and "\r\n" endings
+// accepted. False on a read error or a record that is not three well-formed fields;
+// records before it stay in the table, and *badLine (if given) is the 1-based
+// number of the line it starts on (0 for a read error).
+bool importCsv(HashTable& table, std::istream& in, size_t* imported = nullptr, size_t* badLine = nullptr);
+
+// Writes every credential of table to out (unspecified order). False on a write error.
+bool exportCsv(const HashTable& table, std::ostream& out, size_t* exported = nullptr);
+
+#endif
@@ -1,16 +1,20 @@
 #ifndef HASHNODE_H
 #define HASHNODE_H
 
+#include <cstdint>
 #include "Credential.h"
 
-// HashNode represents a node in the linked list bucket.
-// It holds the data (Credential) and a pointer to the next node.
+// HashNode is the storage record for one credential.
+// Nodes live in the table's node slabs and are referenced from slots by id,
+// so a slot only needs 4 bytes and rehashing never moves the credential itself.
+// A node's strings allocate from the table's string pool.
 class HashNode {
 public:
     Credential credential;
-    HashNode* next;
+    uint64_t hash;     // Full hash of the key, so resizes never rehash strings
+    uint32_t nextFree; // Link in the free list while the node is unused (a marker while in use)
 
-    HashNode(Credential cred) : credential(cred), next(nullptr) {}
+    explicit HashNode(const Credential::allocator_type& alloc) : credential(alloc), hash(0), nextFree(0) {}
 };
 
-#endif
\ No newline at end of file
+#endif
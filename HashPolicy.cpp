@@ -0,0 +1,80 @@
+#include "HashPolicy.h"
+#include <cstring>
+#include <random>
+#include <chrono>
+#include <atomic>
+
+namespace {
+    const uint64_t K0 = 0xa0761d6478bd642fULL;
+    const uint64_t K1 = 0xe7037ed1a0b428dbULL;
+    const uint64_t K2 = 0x8ebc6af09c88c6e3ULL;
+
+    inline uint64_t read64(const char* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+    inline uint64_t read32(const char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+    // 64x64 -> 128-bit multiply, folded back to 64 bits
+    inline uint64_t mix(uint64_t a, uint64_t b) {
+        __uint128_t r = static_cast<__uint128_t>(a) * b;
+        return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+    }
+
+    uint64_t randomSeed() {
+        static std::atomic<uint64_t> counter(0);
+        std::random_device rd;
+        uint64_t s = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+        s ^= static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        return mix(s ^ K2, ++counter ^ K1);
+    }
+}
+
+SeededHash::SeededHash() : seedValue(randomSeed()) {}
+
+SeededHash::SeededHash(uint64_t seed) : seedValue(seed) {}
+
+uint64_t SeededHash::hashBytes(const char* p, size_t len, uint64_t seed) {
+    uint64_t h = seed ^ K0;
+    size_t n = len;
+    while (n > 16) {
+        h = mix(read64(p) ^ K1, read64(p + 8) ^ h);
+        p += 16;
+        n -= 16;
+    }
+    // Tail of 0-16 bytes: two (possibly overlapping) loads
+    uint64_t a = 0, b = 0;
+    if (n > 8) {
+        a = read64(p);
+        b = read64(p + n - 8);
+    } else if (n >= 4) {
+        a = read32(p);
+        b = read32(p + n - 4);
+    } else if (n > 0) {
+        a = (static_cast<uint64_t>(static_cast<unsigned char>(p[0])) << 16) |
+            (static_cast<uint64_t>(static_cast<unsigned char>(p[n >> 1])) << 8) |
+            static_cast<unsigned char>(p[n - 1]);
+    }
+    return mix(K2 ^ len, mix(a ^ K1, b ^ h));
+}
+
+// The site hash seeds the username hash, so ("ab", "c") and ("a", "bc") differ
+uint64_t SeededHash::operator()(std::string_view site, std::string_view username) const {
+    return hashBytes(username.data(), username.size(), this->site(site));
+}
+
+uint64_t PolynomialHash::operator()(std::string_view site, std::string_view) const {
+    long long hashValue = 0;
+    long long p = 31;
+    long long m = 1000000009LL; // 1e9+9 as integer literal
+    long long power = 1;
+
+    for (char c : site) {
+        hashValue = (hashValue + (c - 'a' + 1) * power) % m;
+        power = (power * p) % m;
+    }
+    uint64_t h = static_cast<uint64_t>((hashValue % m + m) % m);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
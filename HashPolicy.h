@@ -0,0 +1,43 @@
+#ifndef HASHPOLICY_H
+#define HASHPOLICY_H
+
+#include <cstdint>
+#include <string_view>
+
+// Hash policies for BasicHashTable.
+// A policy is a small copyable object with
+//   uint64_t operator()(std::string_view site, std::string_view username) const;
+//   uint64_t site(std::string_view site) const;
+// operator() places an entry in the table; site() places the site in the table's
+// site directory, which a search(site) without a username probes.
+
+// Default policy: word-at-a-time multiply-mix hash over site and username,
+// keyed with a per-table random seed so crafted site names cannot force collisions.
+// Every bit of the entry hash depends on both, so the accounts of one site spread
+// over the whole table.
+class SeededHash {
+public:
+    // Seeds from std::random_device (mixed with a clock and a counter)
+    SeededHash();
+    explicit SeededHash(uint64_t seed);
+
+    uint64_t operator()(std::string_view site, std::string_view username) const;
+    uint64_t site(std::string_view site) const { return hashBytes(site.data(), site.size(), seedValue); }
+    uint64_t seed() const { return seedValue; }
+
+    // Hashes one byte string with the given seed (16 bytes per step)
+    static uint64_t hashBytes(const char* data, size_t len, uint64_t seed);
+
+private:
+    uint64_t seedValue;
+};
+
+// The original base-31 polynomial hash of the site name (mod 1e9+9), finished with
+// a 64-bit mixer. Unseeded and site-only; kept for comparison and benchmarks.
+class PolynomialHash {
+public:
+    uint64_t operator()(std::string_view site, std::string_view username) const;
+    uint64_t site(std::string_view site) const { return (*this)(site, std::string_view()); }
+};
+
+#endif
@@ -2,371 +2,2350 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
-#include <sstream>
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <type_traits>
+#include <unordered_map>
+#include <functional>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #if HASH_HAS_OPENSSL
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
 #endif
 #include "sha256.h"
+#include "VaultIO.h"
+#include "CommitScheduler.h"
+#include "LzCodec.h"
+#include "StreamCipher.h"
 
-// Constructor: Initializes the table with nullptrs
-HashTable::HashTable(int cap) : capacity(cap), count(0), loadFactorThreshold(0.75f) {
-    table.resize(capacity, nullptr);
-}
+namespace {
+    // Metadata byte for a free slot is 0 (what calloc hands out).
+    // Full slots store 0x80 | 7-bit hash fragment, so the high bit marks them.
+    const uint8_t CTRL_EMPTY = 0x00;
+    const uint32_t NO_NODE = 0xFFFFFFFFu;
+    const uint32_t NODE_LIVE = 0xFFFFFFFEu; // nextFree of a node that holds a credential
 
-// Destructor: Cleans up all dynamic memory (linked list nodes)
-HashTable::~HashTable() {
-    for (int i = 0; i < capacity; i++) {
-        HashNode* entry = table[i];
-        while (entry != nullptr) {
-            HashNode* prev = entry;
-            entry = entry->next;
-            delete prev;
+    inline uint8_t hashFragment(size_t h) { return static_cast<uint8_t>(0x80 | (h & 0x7F)); }
+    inline size_t homeGroup(size_t h, size_t groupMask) { return (h >> 7) & groupMask; }
+
+    // Returns a 16-bit mask with bit i set where group[i] == b.
+    inline uint32_t matchByte(const uint8_t* group, uint8_t b) {
+#if defined(__SSE2__)
+        __m128i ctrlBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrlBytes, _mm_set1_epi8(static_cast<char>(b)))));
+#elif defined(__ARM_NEON)
+        static const uint8_t bitValues[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+        uint8x16_t eq = vceqq_u8(vld1q_u8(group), vdupq_n_u8(b));
+        uint8x16_t bits = vandq_u8(eq, vld1q_u8(bitValues));
+        return static_cast<uint32_t>(vaddv_u8(vget_low_u8(bits))) |
+               (static_cast<uint32_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < 16; ++i) {
+            if (group[i] == b) mask |= (1u << i);
         }
-        table[i] = nullptr;
+        return mask;
+#endif
+    }
+
+    // Returns a 16-bit mask with bit i set where slot i of the group is empty.
+    inline uint32_t matchEmpty(const uint8_t* group) {
+        return matchByte(group, CTRL_EMPTY);
     }
+
+    // Returns a 16-bit mask with bit i set where slot i of the group is full.
+    inline uint32_t matchFull(const uint8_t* group) {
+#if defined(__SSE2__)
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+        return ~matchEmpty(group) & 0xFFFFu;
+#endif
+    }
+
+    inline int lowestBit(uint32_t mask) { return __builtin_ctz(mask); }
+}
+
+template <class Hasher>
+void BasicHashTable<Hasher>::SlotIndex::allocate(int cap) {
+    capacity = cap;
+    ctrl = static_cast<uint8_t*>(std::calloc(static_cast<size_t>(cap), 1));
+    overflow = static_cast<uint32_t*>(std::calloc(static_cast<size_t>(cap / GROUP_SIZE), sizeof(uint32_t)));
+    slots = static_cast<uint32_t*>(std::malloc(static_cast<size_t>(cap) * sizeof(uint32_t)));
+    if (!ctrl || !overflow || !slots) {
+        release();
+        throw std::bad_alloc();
+    }
+}
+
+template <class Hasher>
+void BasicHashTable<Hasher>::SlotIndex::release() {
+    std::free(ctrl);
+    std::free(slots);
+    std::free(overflow);
+    ctrl = nullptr;
+    slots = nullptr;
+    overflow = nullptr;
+    capacity = 0;
+}
+
+// Constructor: Initializes an empty table with all slots marked free
+template <class Hasher>
+BasicHashTable<Hasher>::BasicHashTable(int cap, const Hasher& hashPolicy)
+    : migrateGroup(0), incrementalRehash(true), saveLayout(false), compressSaves(false), layoutLoaded(false),
+      nodeCount(0),
+      freeList(NO_NODE), count(0), loadFactorThreshold(0.875f), hasher(hashPolicy) {
+    capacity = roundCapacity(cap);
+    index.allocate(capacity);
+    siteIndex.allocate(capacity);
+}
+
+// Destructor: releases both slot indexes and every node slab.
+// Nodes are not destroyed one by one: their strings live in stringPool,
+// which hands all of its chunks back at once. Passwords are zeroed first.
+template <class Hasher>
+BasicHashTable<Hasher>::~BasicHashTable() {
+    closeJournal();
+    finishSnapshot();
+    wipePasswords();
+    index.release();
+    oldIndex.release();
+    siteIndex.release();
+    oldSiteIndex.release();
+    for (HashNode* slab : nodeSlabs) {
+        ::operator delete(slab);
+    }
+}
+
+// Rounds a requested slot count up to a power-of-two number of groups,
+// so the probe sequence can wrap with a mask instead of a modulo.
+template <class Hasher>
+int BasicHashTable<Hasher>::roundCapacity(int n) {
+    int groups = 1;
+    while (groups * GROUP_SIZE < n) groups *= 2;
+    return groups * GROUP_SIZE;
 }
 
 // DSA1: Hash Function
-// Uses a polynomial rolling hash (base 31) to compute index.
-int HashTable::hash(std::string key) {
-    long long hashValue = 0;
-    long long p = 31;
-    long long m = 1000000009LL; // 1e9+9 as integer literal
-    long long power = 1;
+// Returns the home group of a key: the first group its probe sequence visits.
+template <class Hasher>
+int BasicHashTable<Hasher>::hash(std::string_view site, std::string_view username) {
+    return static_cast<int>(homeGroup(hasher(site, username), index.groupMask()));
+}
+
+// Probes idx for (site, username) and returns its slot index, or -1.
+// Groups are visited in triangular order (g, g+1, g+3, g+6, ...), which covers
+// every group exactly once when the group count is a power of two.
+template <class Hasher>
+int BasicHashTable<Hasher>::findSlot(const SlotIndex& idx, std::string_view site, std::string_view username, size_t h) const {
+    const size_t groupMask = idx.groupMask();
+    const uint8_t fragment = hashFragment(h);
+    size_t g = homeGroup(h, groupMask);
+
+    for (size_t step = 1; step <= groupMask + 1; ++step) {
+        TABLE_STAT(TableCounters::bump(counters.groupsProbed));
+        // The slot ids live in a separate array; start loading them alongside the metadata
+        __builtin_prefetch(&idx.slots[g * GROUP_SIZE]);
+        uint32_t candidates = matchByte(&idx.ctrl[g * GROUP_SIZE], fragment);
+        while (candidates != 0) {
+            size_t slot = g * GROUP_SIZE + static_cast<size_t>(lowestBit(candidates));
+            // The cached full hash rejects fragment collisions without touching the strings
+            const HashNode& n = node(idx.slots[slot]);
+            if (n.hash == h && n.credential.site == site && n.credential.username == username) {
+                return static_cast<int>(slot);
+            }
+            candidates &= candidates - 1;
+        }
+        // Nothing inserted ever probed past this group, so the key cannot be further on
+        if (idx.overflow[g] == 0) return -1;
+        g = (g + step) & groupMask;
+    }
+    return -1;
+}
 
-    for (char c : key) {
-        hashValue = (hashValue + (c - 'a' + 1) * power) % m;
-        power = (power * p) % m;
+// findSlot for the site directory: h is the site hash, and the slot found names
+// some node of the site. A fragment match is checked against that node's site.
+template <class Hasher>
+int BasicHashTable<Hasher>::findSiteSlot(const SlotIndex& idx, std::string_view site, size_t h) const {
+    const size_t groupMask = idx.groupMask();
+    const uint8_t fragment = hashFragment(h);
+    size_t g = homeGroup(h, groupMask);
+
+    for (size_t step = 1; step <= groupMask + 1; ++step) {
+        TABLE_STAT(TableCounters::bump(counters.groupsProbed));
+        __builtin_prefetch(&idx.slots[g * GROUP_SIZE]);
+        uint32_t candidates = matchByte(&idx.ctrl[g * GROUP_SIZE], fragment);
+        while (candidates != 0) {
+            size_t slot = g * GROUP_SIZE + static_cast<size_t>(lowestBit(candidates));
+            if (node(idx.slots[slot]).credential.site == site) return static_cast<int>(slot);
+            candidates &= candidates - 1;
+        }
+        if (idx.overflow[g] == 0) return -1;
+        g = (g + step) & groupMask;
     }
-    // Ensure index is positive and fits in capacity
-    long long idx = (hashValue % capacity + capacity) % capacity;
-    return static_cast<int>(idx);
+    return -1;
 }
 
-// DSA2: Insert
-// Inserts a credential. Updates if site+user exists, otherwise adds new node.
-void HashTable::insert(Credential cred) {
-    int index = hash(cred.site);
-    HashNode* node = table[index];
+// Some node of the site (the head of its list), or NO_NODE
+template <class Hasher>
+uint32_t BasicHashTable<Hasher>::findSiteNode(std::string_view site) const {
+    const uint64_t h = hasher.site(site);
+    uint32_t id = NO_NODE;
+    int slot = findSiteSlot(siteIndex, site, h);
+    if (slot >= 0) {
+        id = siteIndex.slots[slot];
+    } else if (migrating()) {
+        slot = findSiteSlot(oldSiteIndex, site, h);
+        if (slot >= 0) id = oldSiteIndex.slots[slot];
+    }
+    TABLE_STAT(TableCounters::bump(id != NO_NODE ? counters.hits : counters.misses);)
+    return id;
+}
 
-    // Check if it already exists to update it
-    while (node != nullptr) {
-        if (node->credential.site == cred.site && node->credential.username == cred.username) {
-            node->credential.password = cred.password; // Update password
+// Adds a new live node to the directory: behind its site's head, or as the head
+// of a new directory slot for a site not seen yet
+template <class Hasher>
+void BasicHashTable<Hasher>::linkSite(uint32_t id) {
+    while (id / NODE_SLAB_SIZE >= siteLinkSlabs.size()) siteLinkSlabs.emplace_back(new SiteLink[NODE_SLAB_SIZE]);
+    const std::string_view site = node(id).credential.site;
+    const uint64_t h = hasher.site(site);
+    const SlotIndex* idx = &siteIndex;
+    int slot = findSiteSlot(siteIndex, site, h);
+    if (slot < 0 && migrating()) {
+        idx = &oldSiteIndex;
+        slot = findSiteSlot(oldSiteIndex, site, h);
+    }
+    SiteLink& link = siteLink(id);
+    if (slot < 0) {
+        link = SiteLink{NO_NODE, NO_NODE};
+        placeNode(siteIndex, id, h);
+        return;
+    }
+    const uint32_t head = idx->slots[slot];
+    link = SiteLink{siteLink(head).next, head};
+    if (link.next != NO_NODE) siteLink(link.next).prev = id;
+    siteLink(head).next = id;
+}
+
+// Takes a node that is about to be freed out of the directory. A head hands its
+// directory slot to the next node of the site, or frees it if it was the last.
+template <class Hasher>
+void BasicHashTable<Hasher>::unlinkSite(uint32_t id) {
+    const SiteLink link = siteLink(id);
+    if (link.next != NO_NODE) siteLink(link.next).prev = link.prev;
+    if (link.prev != NO_NODE) {
+        siteLink(link.prev).next = link.next;
+        return;
+    }
+    const std::string_view site = node(id).credential.site;
+    const uint64_t h = hasher.site(site);
+    SlotIndex* idx = &siteIndex;
+    int slot = findSiteSlot(siteIndex, site, h);
+    if (slot < 0) {
+        idx = &oldSiteIndex;
+        slot = findSiteSlot(oldSiteIndex, site, h);
+    }
+    if (link.next != NO_NODE) {
+        idx->slots[slot] = link.next;
+    } else {
+        removeSlot(*idx, slot, h);
+    }
+}
+
+// Builds the directory for nodes that were made without it (parallel load)
+template <class Hasher>
+void BasicHashTable<Hasher>::rebuildSiteIndex() {
+    if (migrating()) migrateStep(oldIndex.capacity / GROUP_SIZE);
+    siteIndex.release();
+    siteIndex.allocate(capacity);
+    for (uint32_t id = 0; id < nodeCount; ++id) {
+        if (node(id).nextFree == NODE_LIVE) linkSite(id);
+    }
+}
+
+// Stores node `id` in the first free slot along its probe sequence in idx.
+// Every full group passed on the way records the overflow so lookups keep going.
+template <class Hasher>
+void BasicHashTable<Hasher>::placeNode(SlotIndex& idx, uint32_t id, size_t h) {
+    const size_t groupMask = idx.groupMask();
+    size_t g = homeGroup(h, groupMask);
+
+    for (size_t step = 1; ; ++step) {
+        uint32_t empty = matchEmpty(&idx.ctrl[g * GROUP_SIZE]);
+        if (empty != 0) {
+            size_t slot = g * GROUP_SIZE + static_cast<size_t>(lowestBit(empty));
+            idx.ctrl[slot] = hashFragment(h);
+            idx.slots[slot] = id;
             return;
         }
-        node = node->next;
+        idx.overflow[g]++;
+        g = (g + step) & groupMask;
     }
+}
 
-    // Insert at HEAD of the list (Separate Chaining)
-    HashNode* newNode = new HashNode(cred);
-    newNode->next = table[index];
-    table[index] = newNode;
+// placeNode restricted to groups [firstGroup, endGroup): if the probe sequence would
+// pass or end in a group outside the range, nothing is changed and false is returned.
+template <class Hasher>
+bool BasicHashTable<Hasher>::placeNodeWithin(SlotIndex& idx, uint32_t id, size_t h, size_t firstGroup, size_t endGroup) {
+    const size_t groupMask = idx.groupMask();
+    size_t target = homeGroup(h, groupMask);
+    for (size_t step = 1; ; ++step) {
+        if (target < firstGroup || target >= endGroup) return false;
+        if (matchEmpty(&idx.ctrl[target * GROUP_SIZE]) != 0) break;
+        target = (target + step) & groupMask;
+    }
+    placeNode(idx, id, h); // Walks the same groups, recording their overflow, and lands in target
+    return true;
+}
+
+// Frees a slot of idx. The groups passed while its entry was inserted
+// give back their overflow count, so no tombstone is needed.
+template <class Hasher>
+void BasicHashTable<Hasher>::removeSlot(SlotIndex& idx, int slot, size_t h) {
+    const size_t groupMask = idx.groupMask();
+    const size_t targetGroup = static_cast<size_t>(slot) / GROUP_SIZE;
+    size_t g = homeGroup(h, groupMask);
+    for (size_t step = 1; g != targetGroup; ++step) {
+        idx.overflow[g]--;
+        g = (g + step) & groupMask;
+    }
+    idx.ctrl[slot] = CTRL_EMPTY;
+}
+
+// Takes a node from the free list (or the next slab position) and copies the fields into it.
+// Slabs are never reallocated, so node addresses stay valid while the table grows.
+// The node's strings belong to stringPool; a reused node keeps its buffers when they fit.
+template <class Hasher>
+uint32_t BasicHashTable<Hasher>::allocNode(std::string_view site, std::string_view username, std::string_view password, uint64_t h) {
+    uint32_t id;
+    if (freeList != NO_NODE) {
+        id = freeList;
+        freeList = writableNode(id).nextFree;
+    } else {
+        if (nodeCount / NODE_SLAB_SIZE == nodeSlabs.size()) {
+            nodeSlabs.push_back(static_cast<HashNode*>(::operator new(sizeof(HashNode) * NODE_SLAB_SIZE)));
+        }
+        id = nodeCount;
+        writableNode(id); // Unshares a frozen last slab before the new node joins it
+        nodeCount++;
+        new (&node(id)) HashNode(Credential::allocator_type(&stringPool));
+    }
+    HashNode& n = node(id);
+    n.hash = h;
+    n.nextFree = NODE_LIVE;
+    n.credential.site.assign(site);
+    n.credential.username.assign(username);
+    n.credential.password.assign(password);
+    if (secondary) {
+        secondary->sites.add(n.credential.site, id);
+        secondary->usernames.add(n.credential.username, id);
+    }
+    return id;
+}
+
+// Returns a node to the free list with its password zeroed. The node keeps its
+// buffers for the next credential; a node from a parallel load worker gets empty
+// strings from the pool instead, so nothing more is written to the worker's arena.
+template <class Hasher>
+void BasicHashTable<Hasher>::freeNode(uint32_t id) {
+    HashNode& n = writableNode(id);
+    if (secondary) {
+        secondary->sites.remove(n.credential.site, id);
+        secondary->usernames.remove(n.credential.username, id);
+    }
+    n.credential.wipePassword();
+    if (n.credential.site.get_allocator().resource() != &stringPool) {
+        n.credential.~Credential();
+        new (&n.credential) Credential(Credential::allocator_type(&stringPool));
+    }
+    n.credential.site.clear();
+    n.credential.username.clear();
+    n.nextFree = freeList;
+    freeList = id;
+}
+
+// Replaces a stored password, zeroing the old bytes before their buffer is reused
+// or freed. A password given from the node's own buffer is assigned as is.
+template <class Hasher>
+void BasicHashTable<Hasher>::setPassword(uint32_t id, std::string_view password) {
+    HashNode& n = writableNode(id);
+    moveToPool(n);
+    std::pmr::string& stored = n.credential.password;
+    const std::less_equal<const char*> notAfter;
+    const bool aliased = notAfter(stored.data(), password.data()) && notAfter(password.data(), stored.data() + stored.size());
+    if (!aliased) n.credential.wipePassword();
+    stored.assign(password);
+}
+
+// Nodes built by parallel load workers allocate from the workers' monotonic
+// arenas, which never reuse freed bytes. Such a node moves its strings to the pool
+// before its password changes, so rewriting it cannot grow those arenas.
+template <class Hasher>
+void BasicHashTable<Hasher>::moveToPool(HashNode& n) {
+    if (n.credential.site.get_allocator().resource() == &stringPool) return;
+    Credential moved{Credential::allocator_type(&stringPool)};
+    moved.site.assign(n.credential.site);
+    moved.username.assign(n.credential.username);
+    moved.password.assign(n.credential.password);
+    n.credential.wipePassword();
+    n.credential.~Credential();
+    new (&n.credential) Credential(std::move(moved)); // Keeps the pool allocator
+}
+
+// Zeroes every live password before the pool hands its chunks back
+template <class Hasher>
+void BasicHashTable<Hasher>::wipePasswords() {
+    for (uint32_t id = 0; id < nodeCount; ++id) {
+        HashNode& n = node(id);
+        if (n.nextFree == NODE_LIVE) n.credential.wipePassword();
+    }
+}
+
+// Allocates the larger index and either migrates everything now (stop-the-world)
+// or leaves the old index to be drained by later operations.
+template <class Hasher>
+void BasicHashTable<Hasher>::startResize(int newCapacity) {
+    // A resize requested mid-migration first finishes the one in progress
+    if (migrating()) migrateStep(oldIndex.capacity / GROUP_SIZE);
+
+    TABLE_STAT(const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();)
+    oldIndex = index;
+    index = SlotIndex();
+    index.allocate(newCapacity);
+    oldSiteIndex = siteIndex;
+    siteIndex = SlotIndex();
+    siteIndex.allocate(newCapacity);
+    capacity = newCapacity;
+    migrateGroup = 0;
+    TABLE_STAT(TableCounters::bump(counters.rehashes);)
+    TABLE_STAT(TableCounters::bump(counters.rehashNanos, TableCounters::nanosSince(t0));)
+
+    if (!incrementalRehash) migrateStep(oldIndex.capacity / GROUP_SIZE);
+}
+
+// Moves up to `groups` groups from the old index into the current one.
+// Migrated old groups are emptied but keep their overflow counts, so lookups for
+// entries still waiting further along the old probe sequence are unaffected.
+template <class Hasher>
+void BasicHashTable<Hasher>::migrateStep(int groups) {
+    TABLE_STAT(const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();)
+    const int oldGroups = oldIndex.capacity / GROUP_SIZE;
+    for (int n = 0; n < groups && migrateGroup < oldGroups; ++n, ++migrateGroup) {
+        uint8_t* group = &oldIndex.ctrl[migrateGroup * GROUP_SIZE];
+        uint32_t full = matchFull(group);
+        while (full != 0) {
+            int i = lowestBit(full);
+            uint32_t id = oldIndex.slots[migrateGroup * GROUP_SIZE + i];
+            placeNode(index, id, node(id).hash);
+            group[i] = CTRL_EMPTY;
+            full &= full - 1;
+        }
+        // The directory group with the same number moves along; its site hashes are not cached
+        uint8_t* sites = &oldSiteIndex.ctrl[migrateGroup * GROUP_SIZE];
+        full = matchFull(sites);
+        while (full != 0) {
+            int i = lowestBit(full);
+            uint32_t id = oldSiteIndex.slots[migrateGroup * GROUP_SIZE + i];
+            placeNode(siteIndex, id, hasher.site(node(id).credential.site));
+            sites[i] = CTRL_EMPTY;
+            full &= full - 1;
+        }
+    }
+    if (migrateGroup >= oldGroups) {
+        oldIndex.release();
+        oldSiteIndex.release();
+    }
+    TABLE_STAT(TableCounters::bump(counters.rehashNanos, TableCounters::nanosSince(t0));)
+}
+
+template <class Hasher>
+void BasicHashTable<Hasher>::setIncrementalRehash(bool enabled) {
+    incrementalRehash = enabled;
+    if (!enabled && migrating()) migrateStep(oldIndex.capacity / GROUP_SIZE);
+}
+
+template <class Hasher>
+void BasicHashTable<Hasher>::setSaveLayout(bool enabled) {
+    saveLayout = enabled;
+}
+
+template <class Hasher>
+void BasicHashTable<Hasher>::setCompression(bool enabled) {
+    compressSaves = enabled;
+}
+
+// Looks (site, username) up in the current index and, while resizing, the old one.
+// Returns the node id, or NO_NODE.
+template <class Hasher>
+uint32_t BasicHashTable<Hasher>::findNode(std::string_view site, std::string_view username, size_t h) const {
+    uint32_t id = NO_NODE;
+    int slot = findSlot(index, site, username, h);
+    if (slot >= 0) {
+        id = index.slots[slot];
+    } else if (migrating()) {
+        slot = findSlot(oldIndex, site, username, h);
+        if (slot >= 0) id = oldIndex.slots[slot];
+    }
+    TABLE_STAT(TableCounters::bump(id != NO_NODE ? counters.hits : counters.misses);)
+    return id;
+}
+
+// DSA2: Insert
+// Inserts a credential. Updates if site+user exists, otherwise stores a new node.
+// The fields are copied straight into the table's arena; no temporaries are made.
+template <class Hasher>
+void BasicHashTable<Hasher>::insert(const Credential& cred) {
+    emplace(cred.site, cred.username, cred.password);
+}
+
+// In-place insert from the three fields
+template <class Hasher>
+void BasicHashTable<Hasher>::emplace(std::string_view site, std::string_view username, std::string_view password) {
+    if (migrating()) migrateStep(MIGRATE_GROUPS_PER_OP);
+    uint64_t h = hasher(site, username);
+
+    // Check if it already exists to update it
+    uint32_t existing = findNode(site, username, h);
+    if (existing != NO_NODE) {
+        setPassword(existing, password); // Update password
+        if (journal) journalRecord(JOURNAL_PUT, site, username, password);
+        return;
+    }
+
+    // Check Load Factor and Resize if needed (before placing, so a free slot always exists)
+    if (static_cast<float>(count + 1) / capacity > loadFactorThreshold) {
+        startResize(capacity * 2);
+    }
+
+    const uint32_t id = allocNode(site, username, password, h);
+    placeNode(index, id, h);
+    linkSite(id);
     count++;
+    if (journal) journalRecord(JOURNAL_PUT, site, username, password);
+}
 
-    // Check Load Factor and Resize if needed
-    if (static_cast<float>(count) / capacity > loadFactorThreshold) {
-        rehash(nextPrime(2 * capacity));
+// Stores a credential known not to be in the table yet (no duplicate probe)
+template <class Hasher>
+void BasicHashTable<Hasher>::insertUnique(std::string_view site, std::string_view username, std::string_view password) {
+    if (static_cast<float>(count + 1) / capacity > loadFactorThreshold) {
+        startResize(capacity * 2);
+    } else if (migrating()) {
+        migrateStep(MIGRATE_GROUPS_PER_OP);
     }
+    uint64_t h = hasher(site, username);
+    const uint32_t id = allocNode(site, username, password, h);
+    placeNode(index, id, h);
+    linkSite(id);
+    count++;
 }
 
-// DSA3: Search
-// Returns a pointer to the credential if found, or nullptr.
-Credential* HashTable::search(std::string site, std::string username) {
-    int index = hash(site);
-    HashNode* node = table[index];
-
-    while (node != nullptr) {
-        // Match site
-        if (node->credential.site == site) {
-            // If username is provided, match that too. If not, return first match (simple logic)
-            if (username == "" || node->credential.username == username) {
-                return &node->credential;
-            }
+// Bulk insert: presizes once for the whole range, then inserts each credential.
+// With assumeUnique the duplicate probe is skipped; the caller guarantees that no
+// (site, username) pair repeats within the range or is already in the table.
+template <class Hasher>
+void BasicHashTable<Hasher>::insertBulk(const Credential* first, const Credential* last, bool assumeUnique) {
+    reserve(count + static_cast<int>(last - first));
+    for (const Credential* cred = first; cred != last; ++cred) {
+        if (assumeUnique) {
+            insertUnique(cred->site, cred->username, cred->password);
+            if (journal) journalRecord(JOURNAL_PUT, cred->site, cred->username, cred->password);
+        } else {
+            insert(*cred);
         }
-        node = node->next;
     }
-    return nullptr;
+}
+
+template <class Hasher>
+void BasicHashTable<Hasher>::insertBulk(const std::vector<Credential>& creds, bool assumeUnique) {
+    insertBulk(creds.data(), creds.data() + creds.size(), assumeUnique);
+}
+
+// Makes room for n entries in total: the index is grown (once, all at once) so
+// that n entries stay under the load factor, and the node slab list is presized.
+template <class Hasher>
+void BasicHashTable<Hasher>::reserve(int n) {
+    int needed = roundCapacity(n);
+    while (static_cast<float>(n) / needed > loadFactorThreshold) {
+        needed *= 2;
+    }
+    if (needed > capacity) {
+        rehash(needed);
+    }
+    nodeSlabs.reserve(static_cast<size_t>(n + NODE_SLAB_SIZE - 1) / NODE_SLAB_SIZE);
+}
+
+// DSA3: Search
+// Returns a pointer to the credential if found, or nullptr.
+// If username is empty, some account of the site is returned, found through the
+// site directory. The credential may be modified through the pointer, so during a
+// background save its slab is unshared like for any other write.
+template <class Hasher>
+Credential* BasicHashTable<Hasher>::search(std::string_view site, std::string_view username) {
+    uint32_t id = username.empty() ? findSiteNode(site) : findNode(site, username, hasher(site, username));
+    return id == NO_NODE ? nullptr : &writableNode(id).credential;
+}
+
+// A frozen slab is fine to read, so the node is returned where it is
+template <class Hasher>
+const Credential* BasicHashTable<Hasher>::search(std::string_view site, std::string_view username) const {
+    uint32_t id = username.empty() ? findSiteNode(site) : findNode(site, username, hasher(site, username));
+    return id == NO_NODE ? nullptr : &node(id).credential;
 }
 
 // DSA4: Update
-bool HashTable::update(std::string site, std::string username, std::string newPassword) {
-    Credential* cred = search(site, username);
-    if (cred != nullptr) {
-        cred->password = newPassword;
+template <class Hasher>
+bool BasicHashTable<Hasher>::update(std::string_view site, std::string_view username, std::string_view newPassword) {
+    uint32_t id = findNode(site, username, hasher(site, username));
+    if (id != NO_NODE) {
+        setPassword(id, newPassword);
+        if (journal) journalRecord(JOURNAL_PUT, site, username, newPassword);
         return true;
     }
     return false;
 }
 
 // DSA5: Remove
-bool HashTable::remove(std::string site, std::string username) {
-    int index = hash(site);
-    HashNode* node = table[index];
-    HashNode* prev = nullptr;
-
-    while (node != nullptr) {
-        if (node->credential.site == site && node->credential.username == username) {
-            // Found it. Unlink the node.
-            if (prev == nullptr) {
-                // It was the head
-                table[index] = node->next;
-            } else {
-                // It was in the middle/end
-                prev->next = node->next;
-            }
-            delete node;
-            count--;
-            return true;
-        }
-        prev = node;
-        node = node->next;
+template <class Hasher>
+bool BasicHashTable<Hasher>::remove(std::string_view site, std::string_view username) {
+    if (migrating()) migrateStep(MIGRATE_GROUPS_PER_OP);
+    uint64_t h = hasher(site, username);
+
+    SlotIndex* idx = &index;
+    int slot = findSlot(index, site, username, h);
+    if (slot < 0 && migrating()) {
+        idx = &oldIndex;
+        slot = findSlot(oldIndex, site, username, h);
     }
-    return false;
+    TABLE_STAT(TableCounters::bump(slot >= 0 ? counters.hits : counters.misses);)
+    if (slot < 0) return false;
+
+    uint32_t id = idx->slots[slot];
+    // Logged first: site and username may view the node's own strings
+    if (journal) journalRecord(JOURNAL_REMOVE, site, username, std::string_view());
+    removeSlot(*idx, slot, h);
+    unlinkSite(id);
+    freeNode(id);
+    count--;
+    return true;
 }
 
 // DSA6: Rehash
-// Creates a larger table and re-inserts all existing items.
-void HashTable::rehash(int newCapacity) {
-    std::cout << "Resizing table from " << capacity << " to " << newCapacity << "...\n";
-    std::vector<HashNode*> oldTable = table;
-    int oldCapacity = capacity;
-
-    // Reset current table
-    table.clear();
-    table.resize(newCapacity, nullptr);
-    capacity = newCapacity;
-    count = 0; // Reset count because insert() increments it
+// Rebuilds the slot index at (at least) newCapacity slots right away.
+// Only node ids are moved; the credentials stay where they are in their slabs.
+template <class Hasher>
+void BasicHashTable<Hasher>::rehash(int newCapacity) {
+    newCapacity = roundCapacity(newCapacity);
+    while (static_cast<float>(count) / newCapacity > loadFactorThreshold) {
+        newCapacity *= 2;
+    }
+    startResize(newCapacity);
+    if (migrating()) migrateStep(oldIndex.capacity / GROUP_SIZE);
+}
 
-    // Move old items to new table
-    for (int i = 0; i < oldCapacity; i++) {
-        HashNode* node = oldTable[i];
-        while (node != nullptr) {
-            insert(node->credential); // Re-hash and insert
-            HashNode* temp = node;
-            node = node->next;
-            delete temp; // Clean up old node wrapper (insert makes a new one)
+// Calls fn(node) for every stored entry, in slot order (old index first while migrating)
+template <class Hasher>
+template <class Fn>
+void BasicHashTable<Hasher>::forEachNode(Fn fn) const {
+    const SlotIndex* indexes[2] = {&oldIndex, &index};
+    for (const SlotIndex* idx : indexes) {
+        for (int g = 0; g < idx->capacity / GROUP_SIZE; g++) {
+            uint32_t full = matchFull(&idx->ctrl[g * GROUP_SIZE]);
+            while (full != 0) {
+                fn(node(idx->slots[g * GROUP_SIZE + lowestBit(full)]));
+                full &= full - 1;
+            }
         }
     }
 }
 
-// Helper: XOR Cipher
-std::string HashTable::xorCipher(std::string data, std::string key) {
-    std::string result = data;
-    if (key.empty()) return result; // avoid div by zero mod
-    for (size_t i = 0; i < data.size(); i++) {
-        result[i] = data[i] ^ key[i % key.size()];
-    }
-    return result;
+template <class Hasher>
+void BasicHashTable<Hasher>::forEach(const std::function<void(const Credential&)>& fn) const {
+    forEachNode([&](const HashNode& n) { fn(n.credential); });
 }
 
-// Helper: compute HMAC-SHA256 of data using key. Returns binary string of length 32.
-// computeHMAC_SHA256: prefer OpenSSL when available, otherwise use embedded SHA256
+namespace {
+// Incremental HMAC-SHA256 over the encrypted payload: OpenSSL when available,
+// otherwise the embedded HmacSha256.
+class PayloadMac {
+public:
 #if HASH_HAS_OPENSSL
-static std::string computeHMAC_SHA256(const std::string &data, const std::string &key) {
-    unsigned int len = EVP_MAX_MD_SIZE;
-    unsigned char digest[EVP_MAX_MD_SIZE];
-    HMAC_CTX *ctx = HMAC_CTX_new();
-    if (!ctx) return std::string();
-    if (HMAC_Init_ex(ctx, key.data(), static_cast<int>(key.size()), EVP_sha256(), NULL) != 1) {
-        HMAC_CTX_free(ctx);
-        return std::string();
-    }
-    HMAC_Update(ctx, reinterpret_cast<const unsigned char*>(data.data()), data.size());
-    HMAC_Final(ctx, digest, &len);
-    HMAC_CTX_free(ctx);
-    return std::string(reinterpret_cast<char*>(digest), static_cast<size_t>(len));
-}
+    explicit PayloadMac(std::string_view key) : ctx(HMAC_CTX_new()) {
+        if (ctx != nullptr && HMAC_Init_ex(ctx, key.data(), static_cast<int>(key.size()), EVP_sha256(), NULL) != 1) {
+            HMAC_CTX_free(ctx);
+            ctx = nullptr;
+        }
+    }
+    ~PayloadMac() { if (ctx != nullptr) HMAC_CTX_free(ctx); }
+    bool ok() const { return ctx != nullptr; }
+    void update(const char* data, size_t len) {
+        HMAC_Update(ctx, reinterpret_cast<const unsigned char*>(data), len);
+    }
+    bool final(unsigned char out[Sha256::DIGEST_SIZE]) {
+        unsigned int len = 0;
+        return HMAC_Final(ctx, out, &len) == 1 && len == Sha256::DIGEST_SIZE;
+    }
+    // Starts a new MAC with the same key
+    bool reset() { return HMAC_Init_ex(ctx, NULL, 0, NULL, NULL) == 1; }
 #else
-static std::string computeHMAC_SHA256(const std::string &data, const std::string &key) {
-    // HMAC with SHA-256: block size = 64 bytes
-    const size_t blockSize = 64;
-    std::string k = key;
-    if (k.size() > blockSize) k = sha256_raw(k);
-    if (k.size() < blockSize) k.append(blockSize - k.size(), '\0');
-
-    std::string o_key_pad(blockSize, '\0');
-    std::string i_key_pad(blockSize, '\0');
-    for (size_t i = 0; i < blockSize; ++i) {
-        o_key_pad[i] = static_cast<char>(k[i] ^ 0x5c);
-        i_key_pad[i] = static_cast<char>(k[i] ^ 0x36);
-    }
-
-    std::string inner = i_key_pad + data;
-    std::string inner_hash = sha256_raw(inner);
-    std::string outer = o_key_pad + inner_hash;
-    std::string hmac = sha256_raw(outer);
-    return hmac;
-}
+    explicit PayloadMac(std::string_view key) : mac(key) {}
+    bool ok() const { return true; }
+    void update(const char* data, size_t len) { mac.update(data, len); }
+    bool final(unsigned char out[Sha256::DIGEST_SIZE]) {
+        mac.final(out);
+        return true;
+    }
+    bool reset() {
+        mac.init();
+        return true;
+    }
+#endif
+    PayloadMac(const PayloadMac&) = delete;
+    PayloadMac& operator=(const PayloadMac&) = delete;
+
+private:
+#if HASH_HAS_OPENSSL
+    HMAC_CTX* ctx;
+#else
+    HmacSha256 mac;
 #endif
+};
+}
 
-// Constant magic header to identify file format
-static const char FILE_MAGIC[] = "SPASSv01"; // 8 bytes
+// File format. Both versions start with an 8-byte magic and the HMAC-SHA256 of
+// everything after it; the payload is XOR-encrypted with the key repeated from the
+// start of the payload (RepeatingKeyXor, StreamCipher.h). Everything below only
+// sees the StreamCipher interface and the stream position of what it ciphers.
+//   SPASSv01: payload = "site","user","pass" CSV lines (read only)
+//   SPASSv02: header fields (plain, little-endian, covered by the HMAC) then a payload
+//             of records, each three varint-length-prefixed fields
+// With FLAG_CHUNKED (always set by save()) the payload is a run of chunks that each
+// end on a record boundary, followed by a chunk table: per chunk its length, record
+// count and own HMAC (over its index and ciphertext), then the chunk count. The file
+// HMAC then covers the header fields and the chunk table, and the chunks can be
+// verified, decrypted and parsed independently.
+// With FLAG_INDEXED (also always set by save()) records are ordered by a keyed hash
+// of their site and every chunk-table entry ends with the hash of the chunk's first
+// record, so the table doubles as an index: VaultReader finds the one or two blocks
+// that can hold a site and only verifies and decrypts those. Blocks are kept small
+// (about SAVE_CHUNK_SIZE) for that reason.
+// With FLAG_LAYOUT (setSaveLayout) the chunk table is followed by the saving table's
+// slot index and the layout's size (u64, last in the file). The layout holds its
+// version (u32), then, encrypted at their position after the chunk table, the hash
+// policy's state size (u32) and bytes (LAYOUT_POLICY_SIZE) and a check hash of a
+// fixed key; then the capacity (u64) and the index arrays as they sit in memory
+// (ctrl bytes, overflow u32 per group, node id u32 per slot) and the cached hash
+// (u64) of every record in payload order. Node ids are record numbers, so load()
+// can copy the arrays into place and give record i node id i. The arrays are not
+// encrypted: like the index hashes in the chunk table, they are hashes under a
+// secret seed, probe counts and record numbers.
+// With FLAG_COMPRESSED (setCompression; requires FLAG_CHUNKED and FLAG_INDEXED) every
+// chunk is LZ-compressed (LzCodec.h) before it is encrypted and MACed, and its entry
+// in the chunk table gains its uncompressed length (u64); a chunk whose stored and
+// uncompressed lengths are equal was stored as is. The compression dictionary
+// follows the chunk table, encrypted at its position, then its size (u64). Like the
+// chunk table it is covered by the file HMAC, and the layout (if any) comes after it.
+static const char FILE_MAGIC_V1[] = "SPASSv01"; // 8 bytes
+static const char FILE_MAGIC_V2[] = "SPASSv02";
 static const size_t FILE_MAGIC_SIZE = 8;
 static const size_t HMAC_SIZE = 32; // SHA256
+static const size_t V2_FIELDS_SIZE = 20; // flags u32, record count u64, capacity hint u64
+static const uint32_t FLAG_CHUNKED = 1;
+static const uint32_t FLAG_INDEXED = 2;
+static const uint32_t FLAG_LAYOUT = 4;
+static const uint32_t FLAG_COMPRESSED = 8;
+static const uint32_t KNOWN_FLAGS = FLAG_CHUNKED | FLAG_INDEXED | FLAG_LAYOUT | FLAG_COMPRESSED;
+static const size_t CHUNK_ENTRY_SIZE = 16 + HMAC_SIZE; // length u64, records u64, HMAC
+static const size_t INDEXED_ENTRY_SIZE = CHUNK_ENTRY_SIZE + 8; // ... then first lookup hash u64
+static const size_t COMPRESSED_ENTRY_SIZE = INDEXED_ENTRY_SIZE + 8; // ... then uncompressed length u64
+static const size_t DICTIONARY_FOOTER_SIZE = 8; // Dictionary size u64
+static const size_t MAX_EXPANSION = 256;        // Bound on uncompressed / compressed length of a block
+static const uint32_t DICTIONARY_SAMPLE = 16384; // Records sampled to build a compression dictionary
+static const size_t CHUNK_FOOTER_SIZE = 8;              // chunk count u64
+static const size_t SAVE_CHUNK_SIZE = 4 * 1024; // Payload bytes per block (encrypted and written per step)
+static const uint32_t LAYOUT_VERSION = 1;       // Bump when the index arrays or probing change
+static const size_t LAYOUT_POLICY_SIZE = 32;    // Room for the hash policy's state
+static const size_t LAYOUT_SECRET_SIZE = 4 + LAYOUT_POLICY_SIZE + 8; // Encrypted part of the header
+static const size_t LAYOUT_HEADER_SIZE = 4 + LAYOUT_SECRET_SIZE + 8;
+static const size_t LAYOUT_FOOTER_SIZE = 8;     // Layout size u64
+static const char LAYOUT_CHECK_SITE[] = "SPASSv02 layout";
+static const char LAYOUT_CHECK_USER[] = "check";
+// The index arrays are stored in host order, which must then be little-endian
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+static const bool LAYOUT_SUPPORTED = false;
+#else
+static const bool LAYOUT_SUPPORTED = true;
+#endif
 
-// DSA7: Save
-// Encrypts and writes to file.
-bool HashTable::save(std::string filename, std::string key) {
-    std::string buffer = "";
-    
-    // Serialize all data to one big string
-    for (int i = 0; i < capacity; i++) {
-        HashNode* node = table[i];
-        while (node != nullptr) {
-            buffer += node->credential.toCSV() + "\n";
-            node = node->next;
-        }
-    }
-
-    // Encrypt
-    std::string encryptedData = xorCipher(buffer, key);
-
-    // Always write new format (MAGIC + HMAC + payload) atomically for integrity
-    // Compute HMAC over encrypted payload
-    std::string hmac = computeHMAC_SHA256(encryptedData, key);
-    if (hmac.size() != HMAC_SIZE) {
-        // HMAC failure
-        return false;
+namespace {
+    void putLE(char* out, uint64_t v, int bytes) {
+        for (int i = 0; i < bytes; ++i) out[i] = static_cast<char>((v >> (8 * i)) & 0xff);
+    }
+
+    uint64_t getLE(const char* in, int bytes) {
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) v |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+        return v;
+    }
+
+    // LEB128: 7 bits per byte, high bit set on every byte but the last
+    void appendVarint(std::string& out, uint64_t v) {
+        while (v >= 0x80) {
+            out += static_cast<char>((v & 0x7f) | 0x80);
+            v >>= 7;
+        }
+        out += static_cast<char>(v);
+    }
+
+    bool readVarint(const char*& p, const char* end, uint64_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 64 && p < end; shift += 7) {
+            unsigned char b = static_cast<unsigned char>(*p++);
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) return true;
+        }
+        return false; // truncated or longer than 10 bytes
+    }
+
+    // One length-prefixed field; fails if it runs past the end of the payload
+    bool readField(const char*& p, const char* end, std::string_view& field) {
+        uint64_t len;
+        if (!readVarint(p, end, len) || len > static_cast<uint64_t>(end - p)) return false;
+        field = std::string_view(p, static_cast<size_t>(len));
+        p += len;
+        return true;
+    }
+
+    void appendField(std::string& out, std::string_view field) {
+        appendVarint(out, field.size());
+        out.append(field.data(), field.size());
+    }
+
+    // Lookup hash of an indexed payload: the site hashed with a seed derived from the
+    // key, so the hashes in the index say nothing about site names without the key
+    uint64_t indexSeed(std::string_view key) {
+        HmacSha256 mac(key);
+        mac.update(std::string_view("SPASSv02 index"));
+        unsigned char digest[Sha256::DIGEST_SIZE];
+        mac.final(digest);
+        return getLE(reinterpret_cast<const char*>(digest), 8);
+    }
+
+    uint64_t indexHash(std::string_view site, uint64_t seed) {
+        return SeededHash::hashBytes(site.data(), site.size(), seed);
     }
 
-    // Write atomically to a temp file then rename
-    std::string tmpName = filename + ".tmp";
-    std::ofstream outFile(tmpName, std::ios::binary | std::ios::trunc);
-    if (!outFile.is_open()) return false;
+    // Where the parts of a mapped vault file are. For chunked files the payload
+    // excludes the chunk table.
+    struct VaultLayout {
+        int version;
+        uint64_t flags, records, capacityHint;
+        const char* fileHmac;
+        const char* body; // Everything after the HMAC
+        size_t bodySize;
+        const char* payload;
+        size_t payloadSize;
+        const char* chunkTable; // Null unless chunked
+        uint64_t chunks;
+        size_t entrySize;       // Bytes per chunk-table entry
+        const char* layout;     // Saved slot index (null unless FLAG_LAYOUT)
+        size_t layoutSize;
+        const char* dictionary; // Encrypted compression dictionary (null unless FLAG_COMPRESSED)
+        size_t dictionarySize;
+    };
+
+    // Splits a vault file into its parts; false if it is not a well-formed vault
+    bool parseLayout(const char* data, size_t size, VaultLayout& v) {
+        // Always expect MAGIC + HMAC (+ header fields for v02) for integrity/auth
+        if (size < FILE_MAGIC_SIZE + HMAC_SIZE) {
+            return false; // File too small to be valid format
+        }
+        if (std::memcmp(data, FILE_MAGIC_V2, FILE_MAGIC_SIZE) == 0) {
+            v.version = 2;
+            if (size < FILE_MAGIC_SIZE + HMAC_SIZE + V2_FIELDS_SIZE) return false;
+        } else if (std::memcmp(data, FILE_MAGIC_V1, FILE_MAGIC_SIZE) == 0) {
+            v.version = 1;
+        } else {
+            return false; // Magic header mismatch: file corrupted or wrong format
+        }
+        v.fileHmac = data + FILE_MAGIC_SIZE;
+        v.body = v.fileHmac + HMAC_SIZE;
+        v.bodySize = size - FILE_MAGIC_SIZE - HMAC_SIZE;
 
-    // Write magic
-    outFile.write(FILE_MAGIC, static_cast<std::streamsize>(FILE_MAGIC_SIZE));
-    // Write HMAC
-    outFile.write(hmac.data(), static_cast<std::streamsize>(hmac.size()));
-    // Write payload
-    outFile.write(encryptedData.data(), static_cast<std::streamsize>(encryptedData.size()));
-    outFile.close();
+        v.flags = v.records = v.capacityHint = 0;
+        v.payload = v.body;
+        if (v.version == 2) {
+            v.flags = getLE(v.body, 4);
+            v.records = getLE(v.body + 4, 8);
+            v.capacityHint = getLE(v.body + 12, 8);
+            v.payload = v.body + V2_FIELDS_SIZE;
+        }
+        if ((v.flags & ~static_cast<uint64_t>(KNOWN_FLAGS)) != 0) return false; // Written with features this reader lacks
+        v.payloadSize = v.bodySize - static_cast<size_t>(v.payload - v.body);
+
+        // A saved layout closes the file; its size comes from the trailing u64
+        v.layout = nullptr;
+        v.layoutSize = 0;
+        if ((v.flags & FLAG_LAYOUT) != 0) {
+            if ((v.flags & FLAG_CHUNKED) == 0 || v.payloadSize < LAYOUT_FOOTER_SIZE) return false;
+            uint64_t layoutSize = getLE(v.payload + v.payloadSize - LAYOUT_FOOTER_SIZE, 8);
+            if (layoutSize > v.payloadSize - LAYOUT_FOOTER_SIZE) return false;
+            v.layoutSize = static_cast<size_t>(layoutSize);
+            v.payloadSize -= v.layoutSize + LAYOUT_FOOTER_SIZE;
+            v.layout = v.payload + v.payloadSize;
+        }
 
-    // Rename temp to final file
-    if (std::rename(tmpName.c_str(), filename.c_str()) != 0) {
-        // rename failed, remove temp
-        std::remove(tmpName.c_str());
+        // Then the compression dictionary, sized by the u64 before the layout
+        v.dictionary = nullptr;
+        v.dictionarySize = 0;
+        if ((v.flags & FLAG_COMPRESSED) != 0) {
+            if ((v.flags & FLAG_INDEXED) == 0 || (v.flags & FLAG_CHUNKED) == 0 ||
+                v.payloadSize < DICTIONARY_FOOTER_SIZE) {
+                return false;
+            }
+            uint64_t dictionarySize = getLE(v.payload + v.payloadSize - DICTIONARY_FOOTER_SIZE, 8);
+            if (dictionarySize > v.payloadSize - DICTIONARY_FOOTER_SIZE) return false;
+            v.dictionarySize = static_cast<size_t>(dictionarySize);
+            v.payloadSize -= v.dictionarySize + DICTIONARY_FOOTER_SIZE;
+            v.dictionary = v.payload + v.payloadSize;
+        }
+
+        // A chunked payload ends with the chunk table; its size comes from the trailing count
+        v.chunkTable = nullptr;
+        v.chunks = 0;
+        v.entrySize = (v.flags & FLAG_COMPRESSED) != 0 ? COMPRESSED_ENTRY_SIZE
+                    : (v.flags & FLAG_INDEXED) != 0  ? INDEXED_ENTRY_SIZE
+                                                     : CHUNK_ENTRY_SIZE;
+        if ((v.flags & FLAG_CHUNKED) != 0) {
+            if (v.payloadSize < CHUNK_FOOTER_SIZE) return false;
+            v.chunks = getLE(v.payload + v.payloadSize - CHUNK_FOOTER_SIZE, 8);
+            if (v.chunks > (v.payloadSize - CHUNK_FOOTER_SIZE) / v.entrySize) return false;
+            v.payloadSize -= static_cast<size_t>(v.chunks) * v.entrySize + CHUNK_FOOTER_SIZE;
+            v.chunkTable = v.payload + v.payloadSize;
+        } else if ((v.flags & FLAG_INDEXED) != 0) {
+            return false; // The index lives in the chunk table
+        }
+        return true;
+    }
+
+    // Verifies the file HMAC (always, regardless of OpenSSL). For chunked files it
+    // covers the header fields and everything after the payload (chunk table, saved
+    // layout); the per-chunk MACs cover the payload.
+    bool verifyLayout(const VaultLayout& v, PayloadMac& mac) {
+        if (v.chunkTable != nullptr) {
+            mac.update(v.body, V2_FIELDS_SIZE);
+            mac.update(v.chunkTable, static_cast<size_t>(v.body + v.bodySize - v.chunkTable));
+        } else {
+            mac.update(v.body, v.bodySize);
+        }
+        unsigned char calcHmac[HMAC_SIZE];
+        return mac.final(calcHmac) && std::memcmp(calcHmac, v.fileHmac, HMAC_SIZE) == 0;
+    }
+
+    // The compression dictionary of a FLAG_COMPRESSED file, decrypted into out
+    void readDictionary(const VaultLayout& v, const StreamCipher& cipher, std::string& out) {
+        out.resize(v.dictionarySize);
+        cipher.apply(v.dictionary, &out[0], v.dictionarySize, static_cast<uint64_t>(v.dictionary - v.payload));
+    }
+
+    // Decrypts a verified chunk (data, at payload offset `offset`) into plain.
+    // A compressed chunk is decrypted into packed and expanded to rawLen bytes.
+    bool openChunk(const char* data, size_t len, size_t offset, uint64_t rawLen, const StreamCipher& cipher,
+                   std::string_view dictionary, std::string& packed, std::string& plain
+                   TABLE_STAT(, PhaseTimer* timer = nullptr)) {
+        if (rawLen == len) {
+            plain.resize(len);
+            cipher.apply(data, &plain[0], len, offset);
+            TABLE_STAT(if (timer != nullptr) timer->lap(&PhaseCounters::cipher);)
+            return true;
+        }
+        packed.resize(len);
+        cipher.apply(data, &packed[0], len, offset);
+        TABLE_STAT(if (timer != nullptr) timer->lap(&PhaseCounters::cipher);)
+        plain.resize(static_cast<size_t>(rawLen));
+        const bool ok = lzDecompress(packed.data(), len, &plain[0], plain.size(), dictionary);
+        TABLE_STAT(if (timer != nullptr) timer->lap(&PhaseCounters::compress);)
+        return ok;
+    }
+
+    // Uncompressed length of the chunk with this table entry, stored in len bytes
+    // (the entry records it when compressed); false if the lengths cannot both hold
+    bool rawChunkLength(const char* entry, size_t entrySize, uint64_t len, uint64_t& raw) {
+        raw = entrySize == COMPRESSED_ENTRY_SIZE ? getLE(entry + INDEXED_ENTRY_SIZE, 8) : len;
+        return raw >= len && raw / MAX_EXPANSION <= len;
+    }
+
+    // MAC of one chunk, bound to its position so chunks cannot be reordered
+    bool chunkMac(PayloadMac& mac, uint64_t chunkIndex, const char* data, size_t len, unsigned char out[HMAC_SIZE]) {
+        char position[8];
+        putLE(position, chunkIndex, 8);
+        if (!mac.reset()) return false;
+        mac.update(position, sizeof(position));
+        mac.update(data, len);
+        return mac.final(out);
+    }
+
+    // Runs fn(worker) for workers 0..threads-1, worker 0 on the calling thread, and waits for all
+    template <class Fn>
+    void runWorkers(int threads, Fn fn) {
+        std::vector<std::thread> pool;
+        for (int w = 1; w < threads; ++w) pool.emplace_back(fn, w);
+        fn(0);
+        for (std::thread& t : pool) t.join();
+    }
+
+    // One chunked SPASSv02 file being written. Chunks of whole records are encrypted
+    // in place, MACed and written one at a time, so memory use is one chunk plus the
+    // small chunk table whatever the vault size. The file HMAC is only known at the
+    // end, so its header slot is written as zeros and patched by finish(). Everything
+    // goes to filename + ".tmp", which finish() fsyncs and renames over filename before
+    // fsyncing the directory, so a save that returned true survives a power loss.
+    // Given a dictionary, chunks are compressed against it before they are encrypted.
+    // In a HASHTABLE_STATS build, `timer` charges each step to its save phase; the
+    // time between chunks is the caller serializing.
+    class VaultWriter {
+    public:
+        VaultWriter(const std::string& filename, std::string_view key)
+            : filename(filename), tmpName(filename + ".tmp"), cipher(key), mac(key), chunkMacCtx(key),
+              entrySize(INDEXED_ENTRY_SIZE), payloadOffset(0), failed(false), finished(false) {}
+        ~VaultWriter() {
+            if (!finished && out.is_open()) {
+                out.close();
+                std::remove(tmpName.c_str());
+            }
+        }
+
+        // Magic, HMAC placeholder, then the header fields (authenticated, not encrypted).
+        // withLayout announces a layout passed to finish(); a non-null dictionary turns
+        // on compression and is stored by finish().
+        bool begin(uint64_t records, uint64_t capacityHint, bool withLayout, const std::string* compressionDictionary) {
+            if (!mac.ok() || !chunkMacCtx.ok()) return false; // HMAC failure
+            out.open(tmpName, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) return false;
+            const char placeholder[HMAC_SIZE] = {0};
+            char fields[V2_FIELDS_SIZE];
+            if (compressionDictionary != nullptr) {
+                dictionary = *compressionDictionary;
+                encoder = std::make_unique<LzEncoder>(dictionary);
+                entrySize = COMPRESSED_ENTRY_SIZE;
+            }
+            putLE(fields, FLAG_CHUNKED | FLAG_INDEXED | (withLayout ? FLAG_LAYOUT : 0) |
+                          (encoder ? FLAG_COMPRESSED : 0), 4);
+            putLE(fields + 4, records, 8);
+            putLE(fields + 12, capacityHint, 8);
+            out.write(FILE_MAGIC_V2, static_cast<std::streamsize>(FILE_MAGIC_SIZE));
+            out.write(placeholder, static_cast<std::streamsize>(HMAC_SIZE));
+            out.write(fields, static_cast<std::streamsize>(V2_FIELDS_SIZE));
+            mac.update(fields, V2_FIELDS_SIZE);
+            TABLE_STAT(timer.lap(&PhaseCounters::io);)
+            return true;
+        }
+
+        // Compresses plain (serialized records, the first with lookup hash firstHash)
+        // if enabled and it helps, encrypts it in place, then MACs and writes it
+        void addChunk(std::string& plain, uint64_t records, uint64_t firstHash) {
+            TABLE_STAT(timer.lap(&PhaseCounters::serialize);)
+            const size_t rawLen = plain.size();
+            if (encoder) {
+                packed.clear();
+                encoder->compress(plain.data(), plain.size(), packed);
+                if (packed.size() < plain.size()) plain.swap(packed);
+                TABLE_STAT(timer.lap(&PhaseCounters::compress);)
+            }
+            cipher.apply(&plain[0], plain.size(), payloadOffset);
+            TABLE_STAT(timer.lap(&PhaseCounters::cipher);)
+            char entry[COMPRESSED_ENTRY_SIZE];
+            putLE(entry, plain.size(), 8);
+            putLE(entry + 8, records, 8);
+            if (!chunkMac(chunkMacCtx, chunkTable.size() / entrySize, plain.data(), plain.size(),
+                          reinterpret_cast<unsigned char*>(entry + 16))) {
+                failed = true;
+            }
+            putLE(entry + CHUNK_ENTRY_SIZE, firstHash, 8);
+            putLE(entry + INDEXED_ENTRY_SIZE, rawLen, 8);
+            chunkTable.append(entry, entrySize);
+            TABLE_STAT(timer.lap(&PhaseCounters::mac);)
+            out.write(plain.data(), static_cast<std::streamsize>(plain.size()));
+            payloadOffset += plain.size();
+            TABLE_STAT(timer.lap(&PhaseCounters::io);)
+        }
+
+        // Chunk table and count close the file, followed by the compression dictionary
+        // (encrypted) if compressing and the layout built by buildLayout (its secret
+        // part is encrypted here, in place) if begin() announced one. The file HMAC
+        // covers them.
+        bool finish(std::string* layout = nullptr) {
+            TABLE_STAT(timer.lap(&PhaseCounters::serialize);)
+            char footer[CHUNK_FOOTER_SIZE];
+            putLE(footer, chunkTable.size() / entrySize, 8);
+            chunkTable.append(footer, CHUNK_FOOTER_SIZE);
+            mac.update(chunkTable.data(), chunkTable.size());
+            TABLE_STAT(timer.lap(&PhaseCounters::mac);)
+            out.write(chunkTable.data(), static_cast<std::streamsize>(chunkTable.size()));
+            TABLE_STAT(timer.lap(&PhaseCounters::io);)
+            size_t offset = payloadOffset + chunkTable.size();
+            if (encoder) {
+                cipher.apply(&dictionary[0], dictionary.size(), offset);
+                TABLE_STAT(timer.lap(&PhaseCounters::cipher);)
+                char size[DICTIONARY_FOOTER_SIZE];
+                putLE(size, dictionary.size(), 8);
+                dictionary.append(size, DICTIONARY_FOOTER_SIZE);
+                mac.update(dictionary.data(), dictionary.size());
+                TABLE_STAT(timer.lap(&PhaseCounters::mac);)
+                out.write(dictionary.data(), static_cast<std::streamsize>(dictionary.size()));
+                offset += dictionary.size();
+                TABLE_STAT(timer.lap(&PhaseCounters::io);)
+            }
+            if (layout != nullptr) {
+                const size_t version = 4;
+                cipher.apply(&(*layout)[version], LAYOUT_SECRET_SIZE, offset + version);
+                TABLE_STAT(timer.lap(&PhaseCounters::cipher);)
+                char size[LAYOUT_FOOTER_SIZE];
+                putLE(size, layout->size(), 8);
+                layout->append(size, LAYOUT_FOOTER_SIZE);
+                mac.update(layout->data(), layout->size());
+                TABLE_STAT(timer.lap(&PhaseCounters::mac);)
+                out.write(layout->data(), static_cast<std::streamsize>(layout->size()));
+                TABLE_STAT(timer.lap(&PhaseCounters::io);)
+            }
+
+            // Patch the HMAC into its header slot
+            unsigned char hmac[HMAC_SIZE];
+            if (failed || !mac.final(hmac)) return false;
+            TABLE_STAT(timer.lap(&PhaseCounters::mac);)
+            out.seekp(static_cast<std::streamoff>(FILE_MAGIC_SIZE));
+            out.write(reinterpret_cast<const char*>(hmac), static_cast<std::streamsize>(HMAC_SIZE));
+            out.close();
+            if (!out || !syncFile(tmpName)) {
+                std::remove(tmpName.c_str());
+                return false;
+            }
+
+            // Rename temp to final file, then make the new directory entry durable too
+            finished = true;
+            if (std::rename(tmpName.c_str(), filename.c_str()) != 0) {
+                // rename failed, remove temp
+                std::remove(tmpName.c_str());
+                return false;
+            }
+            const bool synced = syncParentDirectory(filename);
+            TABLE_STAT(timer.lap(&PhaseCounters::io);)
+            return synced;
+        }
+
+        TABLE_STAT(PhaseTimer timer;)
+
+    private:
+        std::string filename;
+        std::string tmpName;
+        RepeatingKeyXor cipher;
+        PayloadMac mac;
+        PayloadMac chunkMacCtx;
+        std::ofstream out;
+        std::string chunkTable;
+        size_t entrySize;
+        std::string dictionary;
+        std::unique_ptr<LzEncoder> encoder;
+        std::string packed; // Compressed chunk
+        size_t payloadOffset;
+        bool failed;
+        bool finished;
+    };
+}
+
+// Write-ahead log (journaled mode), kept next to the snapshot as filename + ".log":
+//   [MAGIC: 8 bytes "SPLOGv01"][log id: 8 random bytes][HMAC-SHA256 of magic and id]
+//   then per change: [body length u32][encrypted body][HMAC-SHA256]
+// A body is an op byte and its varint-prefixed fields (put: site, username, password;
+// remove: site, username; clear: none), XOR-encrypted at its offset in the file.
+// Each record's HMAC covers the previous one (the header's, for the first record)
+// plus its own length and ciphertext, so records cannot be dropped, reordered or
+// moved between logs. Replay stops at the first record that is incomplete or fails
+// its MAC, which is where a crash cut the log.
+//
+// Replaying any suffix of the changes since a snapshot over a state that already
+// contains them is harmless: a put overwrites and removing a missing key does
+// nothing. Compaction relies on this. It renames the log to filename + ".log.1",
+// starts a fresh log, writes the snapshot in the background and only then deletes
+// ".log.1"; a crash at any point leaves a snapshot plus logs whose replay (".log.1",
+// then ".log") rebuilds the latest state.
+//
+// Appends are not fsynced one by one. commit() hands out a future that completes
+// once the log is synced past every change made before the call; commits made
+// within the commit window share a single fsync (group commit).
+static const char LOG_MAGIC[] = "SPLOGv01"; // 8 bytes
+static const size_t LOG_ID_SIZE = 8;
+static const size_t LOG_HEADER_SIZE = FILE_MAGIC_SIZE + LOG_ID_SIZE + HMAC_SIZE;
+static const size_t LOG_LENGTH_SIZE = 4;
+static const size_t LOG_MAX_FIELDS = 3;
+static const size_t DEFAULT_COMPACTION_THRESHOLD = 4 * 1024 * 1024; // Log bytes
+static const std::chrono::microseconds DEFAULT_COMMIT_WINDOW(2000);
+
+namespace {
+    bool fileExists(const std::string& name) {
+        std::ifstream probe(name, std::ios::binary);
+        return probe.is_open();
+    }
+
+    // HMAC of one log record (length and ciphertext), chained to the previous one
+    bool recordMac(PayloadMac& mac, const unsigned char prev[HMAC_SIZE], const char* data, size_t len,
+                   unsigned char out[HMAC_SIZE]) {
+        if (!mac.reset()) return false;
+        mac.update(reinterpret_cast<const char*>(prev), HMAC_SIZE);
+        mac.update(data, len);
+        return mac.final(out);
+    }
+
+    // Verifies a log's header, then calls apply(op, fields, fieldCount) for each intact
+    // record until one is incomplete, fails its MAC or is rejected by apply. Returns
+    // false only if the header does not verify (wrong key, or not a log). intact is
+    // the length of the verified prefix (0 for a log torn before its header was
+    // complete) and chain the HMAC the next record must chain from.
+    template <class Apply>
+    bool replayLog(const char* data, size_t size, const StreamCipher& cipher, PayloadMac& mac, size_t& intact,
+                   unsigned char chain[HMAC_SIZE], Apply apply) {
+        intact = 0;
+        if (size < LOG_HEADER_SIZE) return true;
+        if (std::memcmp(data, LOG_MAGIC, FILE_MAGIC_SIZE) != 0 || !mac.reset()) return false;
+        mac.update(data, FILE_MAGIC_SIZE + LOG_ID_SIZE);
+        if (!mac.final(chain) || std::memcmp(chain, data + FILE_MAGIC_SIZE + LOG_ID_SIZE, HMAC_SIZE) != 0) {
+            return false;
+        }
+
+        size_t pos = LOG_HEADER_SIZE;
+        std::string body;
+        unsigned char next[HMAC_SIZE];
+        while (size - pos >= LOG_LENGTH_SIZE + HMAC_SIZE) {
+            const size_t len = static_cast<size_t>(getLE(data + pos, 4));
+            if (len == 0 || len > size - pos - LOG_LENGTH_SIZE - HMAC_SIZE) break; // Torn record
+            if (!recordMac(mac, chain, data + pos, LOG_LENGTH_SIZE + len, next) ||
+                std::memcmp(next, data + pos + LOG_LENGTH_SIZE + len, HMAC_SIZE) != 0) {
+                break;
+            }
+            body.resize(len);
+            cipher.apply(data + pos + LOG_LENGTH_SIZE, &body[0], len, pos + LOG_LENGTH_SIZE);
+
+            const char* p = body.data() + 1;
+            const char* end = body.data() + len;
+            std::string_view fields[LOG_MAX_FIELDS];
+            size_t n = 0;
+            while (p < end && n < LOG_MAX_FIELDS && readField(p, end, fields[n])) ++n;
+            if (p != end || !apply(body[0], fields, n)) break;
+
+            std::memcpy(chain, next, HMAC_SIZE);
+            pos += LOG_LENGTH_SIZE + len + HMAC_SIZE;
+        }
+        intact = pos;
+        return true;
+    }
+}
+
+// State of an open write-ahead log
+class VaultJournal {
+public:
+    VaultJournal(const std::string& vaultName, std::string_view key)
+        : vaultName(vaultName), key(key), cipher(key), mac(this->key), threshold(DEFAULT_COMPACTION_THRESHOLD), failed(false),
+          commitWindow(DEFAULT_COMMIT_WINDOW) {}
+
+    std::string vaultName;          // Snapshot file
+    std::string key;
+    RepeatingKeyXor cipher;
+    PayloadMac mac;
+    AppendFile log;                 // vaultName + ".log"
+    unsigned char chain[HMAC_SIZE]; // HMAC of the last record (or of the header)
+    size_t threshold;               // Log size that starts a background compaction (0 = never)
+    std::shared_future<bool> compaction; // Background compaction in flight, if any
+    bool failed;                    // A change may be missing from disk
+    std::string record;             // Length placeholder and plain body of the next record
+    std::mutex fileLock;            // Held by the commit thread's fsync and by anything reopening `log`
+    std::chrono::microseconds commitWindow;
+    std::unique_ptr<CommitScheduler> committer; // Started by the first commit()
+
+    std::string logName() const { return vaultName + ".log"; }
+    std::string oldLogName() const { return vaultName + ".log.1"; }
+
+    // Starts an empty log with a fresh id; the header and the directory entry are
+    // synced, so later fsyncs of the log are enough to make records durable.
+    // Callers hold fileLock once a committer exists.
+    bool create() {
+        char header[LOG_HEADER_SIZE];
+        std::memcpy(header, LOG_MAGIC, FILE_MAGIC_SIZE);
+        std::random_device rd;
+        putLE(header + FILE_MAGIC_SIZE, (static_cast<uint64_t>(rd()) << 32) ^ rd(), 8);
+        if (!mac.ok() || !mac.reset()) return false;
+        mac.update(header, FILE_MAGIC_SIZE + LOG_ID_SIZE);
+        if (!mac.final(chain)) return false;
+        std::memcpy(header + FILE_MAGIC_SIZE + LOG_ID_SIZE, chain, HMAC_SIZE);
+        return log.open(logName(), true) && log.append(header, LOG_HEADER_SIZE) && log.sync() &&
+               syncParentDirectory(logName());
+    }
+
+    // Encrypts and MACs `record` and appends it with a single write. A failed write
+    // is cut back off, so the log never holds a torn record followed by more.
+    bool appendRecord() {
+        const size_t before = log.size();
+        const size_t bodyLen = record.size() - LOG_LENGTH_SIZE;
+        putLE(&record[0], bodyLen, 4);
+        cipher.apply(&record[LOG_LENGTH_SIZE], bodyLen, before + LOG_LENGTH_SIZE);
+        unsigned char next[HMAC_SIZE];
+        if (!recordMac(mac, chain, record.data(), record.size(), next)) return false;
+        record.append(reinterpret_cast<const char*>(next), HMAC_SIZE);
+        if (!log.append(record.data(), record.size())) {
+            log.truncate(before);
+            return false;
+        }
+        std::memcpy(chain, next, HMAC_SIZE);
+        return true;
+    }
+
+    // Waits for a background compaction; false if it failed
+    bool finishCompaction() {
+        if (!compaction.valid()) return true;
+        const bool ok = compaction.get();
+        compaction = std::shared_future<bool>();
+        if (!ok) failed = true;
+        return ok;
+    }
+};
+
+// Serializes every record of s, in lookup-hash order, into chunks of about
+// SAVE_CHUNK_SIZE bytes, calling fn(chunk, records, firstHash) for each; fn may
+// modify the chunk. Records are found by walking the node slabs, not the slot
+// index, so a snapshot needs nothing but its slabs. Ordering takes one
+// (hash, node) pair per record, 16 bytes each. If tableHashes is given it
+// receives every record's cached table hash, in file order.
+template <class Hasher>
+template <class Fn>
+void BasicHashTable<Hasher>::forEachChunk(const Snapshot& s, std::string_view key, Fn fn,
+                                          std::vector<uint64_t>* tableHashes) {
+    const uint64_t seed = indexSeed(key);
+    std::vector<std::pair<uint64_t, const HashNode*>> order;
+    order.reserve(static_cast<size_t>(s.count));
+    for (uint32_t id = 0; id < s.nodeCount; ++id) {
+        const HashNode& n = s.slabs[id / NODE_SLAB_SIZE][id % NODE_SLAB_SIZE];
+        if (n.nextFree == NODE_LIVE) order.emplace_back(indexHash(n.credential.site, seed), &n);
+    }
+    std::sort(order.begin(), order.end(),
+              [](const std::pair<uint64_t, const HashNode*>& a, const std::pair<uint64_t, const HashNode*>& b) {
+                  return a.first < b.first;
+              });
+    if (tableHashes != nullptr) {
+        tableHashes->resize(order.size());
+        for (size_t i = 0; i < order.size(); ++i) (*tableHashes)[i] = order[i].second->hash;
+    }
+
+    std::string chunk;
+    chunk.reserve(SAVE_CHUNK_SIZE + 1024);
+    uint64_t chunkRecords = 0;
+    uint64_t firstHash = 0;
+    for (const std::pair<uint64_t, const HashNode*>& entry : order) {
+        const Credential& cred = entry.second->credential;
+        if (chunkRecords == 0) firstHash = entry.first;
+        appendField(chunk, cred.site);
+        appendField(chunk, cred.username);
+        appendField(chunk, cred.password);
+        ++chunkRecords;
+        if (chunk.size() >= SAVE_CHUNK_SIZE) {
+            fn(chunk, chunkRecords, firstHash);
+            chunk.clear();
+            chunkRecords = 0;
+        }
+    }
+    if (!chunk.empty()) fn(chunk, chunkRecords, firstHash);
+}
+
+// The live table as a Snapshot, for save() (the slab list is copied, the nodes are not)
+template <class Hasher>
+void BasicHashTable<Hasher>::describe(Snapshot& s) const {
+    s.slabs = nodeSlabs;
+    s.nodeCount = nodeCount;
+    s.count = count;
+    s.capacity = capacity;
+    s.hasher = hasher;
+    s.saveLayout = saveLayout && LAYOUT_SUPPORTED;
+    s.compress = compressSaves;
+    s.done = false;
+    TABLE_STAT(s.saveCounters = &counters.save;)
+}
+
+// Writes s to filename (always chunked and indexed SPASSv02), streaming: records
+// are serialized into a small block, which VaultWriter encrypts, MACs and writes
+// before the next one is filled. Only reads s, so it may run on another thread.
+template <class Hasher>
+bool BasicHashTable<Hasher>::writeSnapshot(const Snapshot& s, const std::string& filename, std::string_view key) {
+    VaultWriter writer(filename, key);
+    TABLE_STAT(writer.timer = PhaseTimer(s.saveCounters);)
+    TABLE_STAT(if (s.saveCounters != nullptr) TableCounters::bump(s.saveCounters->runs);)
+    const std::string dictionary = s.compress ? buildDictionary(s) : std::string();
+    TABLE_STAT(writer.timer.lap(&PhaseCounters::compress);)
+    if (!writer.begin(static_cast<uint64_t>(s.count), static_cast<uint64_t>(s.capacity), s.saveLayout,
+                      s.compress ? &dictionary : nullptr)) {
         return false;
     }
-    return true;
+    std::vector<uint64_t> hashes;
+    forEachChunk(s, key, [&](std::string& chunk, uint64_t records, uint64_t firstHash) {
+        writer.addChunk(chunk, records, firstHash);
+    }, s.saveLayout ? &hashes : nullptr);
+    if (!s.saveLayout) return writer.finish();
+    std::string layout = buildLayout(s, hashes);
+    return writer.finish(&layout);
+}
+
+// DSA7: Save
+// Encrypts and writes the table to file; see writeSnapshot
+template <class Hasher>
+bool BasicHashTable<Hasher>::save(const std::string& filename, std::string_view key) {
+    // A background save or compaction may be writing the same file
+    finishSnapshot();
+    if (journal) journal->finishCompaction();
+
+    Snapshot live(hasher);
+    describe(live);
+    return writeSnapshot(live, filename, key);
+}
+
+// Freezes the table for a background reader: the reader gets the slab list as it
+// is now, and from here on writableNode() copies a frozen slab before changing it.
+// A previous snapshot is waited for first.
+template <class Hasher>
+void BasicHashTable<Hasher>::takeSnapshot() {
+    finishSnapshot();
+    frozen = std::make_shared<Snapshot>(hasher);
+    describe(*frozen);
+    slabCopied.assign(nodeSlabs.size(), false);
+}
+
+// Gives the table its own copy of a frozen slab (once per slab and snapshot). The
+// snapshot keeps the original, whose nodes are destroyed (passwords zeroed) and
+// freed when the snapshot is done. Free nodes are copied without their (cleared)
+// strings; allocNode assigns them anyway.
+template <class Hasher>
+void BasicHashTable<Hasher>::unshareSlab(size_t slab) {
+    if (frozen->done.load(std::memory_order_acquire)) {
+        finishSnapshot(); // The reader is gone; nothing is shared any more
+        return;
+    }
+    if (slab >= slabCopied.size() || slabCopied[slab]) return;
+    HashNode* copy = static_cast<HashNode*>(::operator new(sizeof(HashNode) * NODE_SLAB_SIZE));
+    const Credential::allocator_type alloc(&stringPool);
+    const uint32_t first = static_cast<uint32_t>(slab * NODE_SLAB_SIZE);
+    const uint32_t end = std::min<uint32_t>(nodeCount, first + NODE_SLAB_SIZE);
+    for (uint32_t id = first; id < end; ++id) {
+        const HashNode& from = node(id);
+        HashNode* to = new (&copy[id - first]) HashNode(alloc);
+        if (from.nextFree == NODE_LIVE) {
+            to->credential.site.assign(from.credential.site);
+            to->credential.username.assign(from.credential.username);
+            to->credential.password.assign(from.credential.password);
+        }
+        to->hash = from.hash;
+        to->nextFree = from.nextFree;
+    }
+    retiredSlabs.push_back(RetiredSlab{nodeSlabs[slab], end - first});
+    nodeSlabs[slab] = copy;
+    slabCopied[slab] = true;
+}
+
+// Waits until the background reader of the current snapshot (if any) is done, then
+// frees the frozen slabs the table no longer uses
+template <class Hasher>
+void BasicHashTable<Hasher>::finishSnapshot() {
+    if (!frozen) return;
+    if (frozenResult.valid()) frozenResult.wait();
+    frozenResult = std::shared_future<bool>();
+    for (const RetiredSlab& slab : retiredSlabs) {
+        for (uint32_t i = 0; i < slab.constructed; ++i) {
+            slab.nodes[i].credential.wipePassword();
+            slab.nodes[i].~HashNode();
+        }
+        ::operator delete(slab.nodes);
+    }
+    retiredSlabs.clear();
+    slabCopied.clear();
+    frozen.reset();
+}
+
+// Background save: an O(slabs) snapshot, then writeSnapshot on its own thread.
+// The worker gets a plain pointer: the table keeps the snapshot until the worker
+// is done (finishSnapshot waits for it), and a future the caller holds must not
+// keep the snapshot alive.
+template <class Hasher>
+std::shared_future<bool> BasicHashTable<Hasher>::saveInBackground(const std::string& filename, std::string_view key) {
+    if (journal) journal->finishCompaction();
+    takeSnapshot();
+    Snapshot* snapshot = frozen.get();
+    frozenResult = std::async(std::launch::async, [snapshot, filename, key = std::string(key)]() {
+        bool ok = writeSnapshot(*snapshot, filename, key);
+        snapshot->done.store(true, std::memory_order_release);
+        return ok;
+    }).share();
+    return frozenResult;
+}
+
+// Lays the records out in a fresh slot index of the snapshot's capacity, placing
+// record i (in file order, with cached hash hashes[i]) as node id i, and serializes
+// it in the FLAG_LAYOUT format (VaultWriter::finish encrypts the policy state). The
+// index is rebuilt rather than copied so that node ids become record numbers and an
+// unfinished resize or freed nodes leave no trace. Strings are not hashed again.
+template <class Hasher>
+std::string BasicHashTable<Hasher>::buildLayout(const Snapshot& s, const std::vector<uint64_t>& hashes) {
+    static_assert(std::is_trivially_copyable<Hasher>::value && sizeof(Hasher) <= LAYOUT_POLICY_SIZE,
+                  "a saved layout stores the hash policy's bytes");
+    SlotIndex idx;
+    idx.allocate(s.capacity);
+    for (size_t i = 0; i < hashes.size(); ++i) placeNode(idx, static_cast<uint32_t>(i), hashes[i]);
+
+    const size_t cap = static_cast<size_t>(s.capacity);
+    const size_t groups = cap / GROUP_SIZE;
+    std::string layout(LAYOUT_HEADER_SIZE + cap + groups * 4 + cap * 4 + hashes.size() * 8, '\0');
+    char* p = &layout[0];
+    putLE(p, LAYOUT_VERSION, 4);
+    putLE(p + 4, sizeof(Hasher), 4);
+    std::memcpy(p + 8, &s.hasher, sizeof(Hasher));
+    putLE(p + 8 + LAYOUT_POLICY_SIZE, s.hasher(LAYOUT_CHECK_SITE, LAYOUT_CHECK_USER), 8);
+    putLE(p + 16 + LAYOUT_POLICY_SIZE, cap, 8);
+    p += LAYOUT_HEADER_SIZE;
+    std::memcpy(p, idx.ctrl, cap);
+    p += cap;
+    std::memcpy(p, idx.overflow, groups * 4);
+    p += groups * 4;
+    for (size_t slot = 0; slot < cap; ++slot, p += 4) {
+        if (idx.ctrl[slot] != CTRL_EMPTY) std::memcpy(p, &idx.slots[slot], 4); // Unused slots stay zero
+    }
+    std::memcpy(p, hashes.data(), hashes.size() * 8);
+    idx.release();
+    return layout;
 }
 
 // DSA8: Load
-// Reads from file, Decrypts, and populates table.
-bool HashTable::load(std::string filename, std::string key) {
-    // Replace current data with file contents
+// Compression dictionary for s, from a sample of its records spread over the node
+// ids: the usernames and sites that recur in the sample, each as the length-prefixed
+// field it is saved as and ranked by the bytes it would save, preceded by whole
+// sampled records (site and username) that show the codec the vault's general
+// shape. The most valuable strings go last, nearest to the blocks.
+template <class Hasher>
+std::string BasicHashTable<Hasher>::buildDictionary(const Snapshot& s) {
+    const uint32_t stride = std::max<uint32_t>(1, s.nodeCount / DICTIONARY_SAMPLE);
+    std::vector<const Credential*> sample;
+    std::unordered_map<std::string_view, uint32_t> seen;
+    for (uint32_t id = 0; id < s.nodeCount; id += stride) {
+        const HashNode& n = s.slabs[id / NODE_SLAB_SIZE][id % NODE_SLAB_SIZE];
+        if (n.nextFree != NODE_LIVE) continue;
+        sample.push_back(&n.credential);
+        ++seen[n.credential.site];
+        ++seen[n.credential.username];
+    }
+
+    std::vector<std::pair<size_t, std::string_view>> frequent; // (bytes saved, string)
+    for (const std::pair<const std::string_view, uint32_t>& e : seen) {
+        if (e.second > 1 && e.first.size() >= 4) frequent.emplace_back((e.second - 1) * e.first.size(), e.first);
+    }
+    std::sort(frequent.begin(), frequent.end(),
+              [](const std::pair<size_t, std::string_view>& a, const std::pair<size_t, std::string_view>& b) {
+                  return a.first != b.first ? a.first > b.first : a.second < b.second;
+              });
+    // Up to three quarters of the dictionary for recurring strings (a varint prefix
+    // takes at most 10 bytes), the rest for sampled records
+    const size_t budget = LzEncoder::MAX_DICTIONARY;
+    size_t taken = 0, commonSize = 0;
+    while (taken < frequent.size() && commonSize + frequent[taken].second.size() + 10 <= budget * 3 / 4) {
+        commonSize += frequent[taken++].second.size() + 10;
+    }
+    std::string dictionary;
+    for (const Credential* c : sample) {
+        if (dictionary.size() + commonSize + c->site.size() + c->username.size() + 20 > budget) break;
+        appendField(dictionary, c->site);
+        appendField(dictionary, c->username);
+    }
+    for (size_t i = taken; i-- > 0;) appendField(dictionary, frequent[i].second); // Least valuable first
+    return dictionary;
+}
+
+// Reads from file, Decrypts, and populates table. Dispatches on the magic, so
+// SPASSv01 files written by older versions still load.
+// The file is memory-mapped and the MAC is checked over the mapped bytes; the
+// payload is then decrypted once into an owned buffer and every record is
+// inserted from string_views into that buffer, with no per-record copies.
+template <class Hasher>
+bool BasicHashTable<Hasher>::load(const std::string& filename, std::string_view key, int threads) {
+    // Replace current data with file contents; the journal belongs to the old contents
+    closeJournal();
     clear();
+    layoutLoaded = false;
+    TABLE_STAT(TableCounters::bump(counters.load.runs);)
+    TABLE_STAT(PhaseTimer timer(&counters.load);)
+
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    if (file.size() == 0) return true; // empty file -> nothing to load
+    TABLE_STAT(timer.lap(&PhaseCounters::io);)
+
+    VaultLayout v;
+    PayloadMac mac(key);
+    if (!parseLayout(file.data(), file.size(), v) || !mac.ok() || !verifyLayout(v, mac)) {
+        return false; // Not a vault, or integrity/auth failed: wrong key or file corrupted
+    }
+    TABLE_STAT(timer.lap(&PhaseCounters::mac);)
+
+    // Nodes are built without the secondary indexes, which are rebuilt in one pass at the end
+    std::unique_ptr<SecondaryIndexes> indexes = std::move(secondary);
+    bool ok;
+    if (v.chunkTable != nullptr) {
+        std::string dictionary;
+        readDictionary(v, RepeatingKeyXor(key), dictionary);
+        TABLE_STAT(timer.lap(&PhaseCounters::cipher);)
+        // Times its own phases (per worker)
+        ok = loadChunks(v.payload, v.payloadSize, v.chunkTable, v.chunks, v.entrySize, v.records, v.capacityHint,
+                        key, threads, v.layout, v.layoutSize, dictionary);
+    } else {
+        // Decrypt straight from the mapping into the single working buffer
+        std::unique_ptr<char[]> plain(new char[v.payloadSize]);
+        RepeatingKeyXor(key).apply(v.payload, plain.get(), v.payloadSize, 0);
+        file.close();
+        TABLE_STAT(timer.lap(&PhaseCounters::cipher);)
+        ok = v.version == 2 ? parseRecordsV2(plain.get(), v.payloadSize, v.records, v.capacityHint)
+                            : parseRecordsV1(plain.get(), v.payloadSize);
+        TABLE_STAT(timer.lap(&PhaseCounters::parse);)
+    }
+    if (!ok) {
+        clear(); // Never leave a partial table behind
+    } else if (v.chunkTable != nullptr) {
+        rebuildSiteIndex(); // Chunk workers build nodes without the directory
+    }
+    if (indexes) {
+        secondary = std::move(indexes);
+        rebuildSecondaryIndexes();
+    }
+    return ok;
+}
+
+// v01 payload: one quoted CSV record per line
+template <class Hasher>
+bool BasicHashTable<Hasher>::parseRecordsV1(const char* data, size_t len) {
+    // Presize from the record count so the parse loop never resizes
+    const char* pos = data;
+    const char* end = data + len;
+    reserve(static_cast<int>(std::count(pos, end, '\n')) + 1);
+
+    // A verified snapshot was written by save(), so its keys are already unique
+    while (pos < end) {
+        const char* eol = static_cast<const char*>(std::memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        if (eol == nullptr) eol = end;
+        std::string_view line(pos, static_cast<size_t>(eol - pos));
+        if (line.length() > 5) {
+            std::string_view site, username, password;
+            Credential::parseCSV(line, site, username, password);
+            insertUnique(site, username, password);
+        }
+        pos = eol + 1;
+    }
+    return true;
+}
+
+// Unchunked v02 payload: `records` records of three length-prefixed fields, nothing after them.
+// The header's record count and capacity presize the index before the first insert.
+template <class Hasher>
+bool BasicHashTable<Hasher>::parseRecordsV2(const char* data, size_t len, uint64_t records, uint64_t capacityHint) {
+    // Every record takes at least 3 bytes, which bounds a bogus count before reserving
+    if (records > len / 3 || records > static_cast<uint64_t>(INT32_MAX / 2)) return false;
+    reserve(static_cast<int>(records));
+    // Adopt the saved table's capacity if it is larger, but not absurdly so
+    if (capacityHint > static_cast<uint64_t>(capacity) && capacityHint <= static_cast<uint64_t>(capacity) * 4) {
+        rehash(static_cast<int>(capacityHint));
+    }
+
+    const char* pos = data;
+    const char* end = data + len;
+    for (uint64_t r = 0; r < records; ++r) {
+        std::string_view site, username, password;
+        if (!readField(pos, end, site) || !readField(pos, end, username) || !readField(pos, end, password)) {
+            return false;
+        }
+        insertUnique(site, username, password);
+    }
+    return pos == end;
+}
+
+// Chunked v02 payload, loaded by `threads` workers (0 = one per hardware thread).
+// Node ids are assigned up front from the chunk table's record counts, so in the
+// first phase each worker verifies, decrypts and parses whole chunks and builds
+// their nodes (strings in its own arena) without coordinating with the others.
+// In the second phase the slot index is split into ranges of groups; each worker
+// fills one range at a time, and the few entries whose probe sequence leaves their
+// range are placed serially at the end. No phase takes a lock.
+// With a saved layout that adoptLayout() accepts, the index is already in place:
+// phase 1 takes each node's hash from the layout and phase 2 is skipped.
+// Compressed chunks are expanded by the worker that decrypts them.
+template <class Hasher>
+bool BasicHashTable<Hasher>::loadChunks(const char* payload, size_t payloadSize, const char* chunkTable, uint64_t chunks,
+                                        size_t entrySize, uint64_t records, uint64_t capacityHint, std::string_view key, int threads,
+                                        const char* layout, size_t layoutSize, std::string_view dictionary) {
+    TABLE_STAT(PhaseTimer timer(&counters.load);)
+    // Chunk c starts at the sum of the earlier lengths; its records get consecutive ids
+    std::vector<size_t> offsets(static_cast<size_t>(chunks) + 1, 0);
+    std::vector<uint64_t> firstRecord(static_cast<size_t>(chunks) + 1, 0);
+    std::vector<uint64_t> rawLength(static_cast<size_t>(chunks));
+    for (size_t c = 0; c < chunks; ++c) {
+        const char* entry = chunkTable + c * entrySize;
+        uint64_t len = getLE(entry, 8);
+        uint64_t n = getLE(entry + 8, 8);
+        if (len > payloadSize - offsets[c] || !rawChunkLength(entry, entrySize, len, rawLength[c]) ||
+            n > rawLength[c] / 3) {
+            return false;
+        }
+        offsets[c + 1] = offsets[c] + static_cast<size_t>(len);
+        firstRecord[c + 1] = firstRecord[c] + n;
+    }
+    if (offsets[chunks] != payloadSize || firstRecord[chunks] != records) return false;
+    if (records > static_cast<uint64_t>(INT32_MAX / 2)) return false;
+
+    // The layout's secret part is encrypted at its position after the chunk table
+    const size_t layoutOffset = layout != nullptr ? static_cast<size_t>(layout - payload) : 0;
+    const bool adopted = layout != nullptr && adoptLayout(layout, layoutSize, layoutOffset, records, key);
+    const size_t hashesOffset = layoutSize - static_cast<size_t>(records) * 8;
+    if (!adopted) {
+        reserve(static_cast<int>(records));
+        // Adopt the saved table's capacity if it is larger, but not absurdly so
+        if (capacityHint > static_cast<uint64_t>(capacity) && capacityHint <= static_cast<uint64_t>(capacity) * 4) {
+            rehash(static_cast<int>(capacityHint));
+        }
+    }
+    while (nodeSlabs.size() * NODE_SLAB_SIZE < records) {
+        nodeSlabs.push_back(static_cast<HashNode*>(::operator new(sizeof(HashNode) * NODE_SLAB_SIZE)));
+    }
+    TABLE_STAT(timer.lap(&PhaseCounters::parse);)
+
+    if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (static_cast<uint64_t>(threads) > chunks) threads = static_cast<int>(chunks);
+    if (threads < 1) threads = 1;
+
+    // Worker 0 copies strings into the table's pool, the others into arenas of their own
+    std::vector<std::pmr::memory_resource*> arenas(static_cast<size_t>(threads), &stringPool);
+    for (int w = 1; w < threads; ++w) {
+        loadArenas.push_back(std::make_unique<std::pmr::monotonic_buffer_resource>(64 * 1024));
+        arenas[w] = loadArenas.back().get();
+    }
+
+    const size_t groupMask = index.groupMask();
+    const size_t groups = groupMask + 1;
+    const size_t partitions = threads == 1 ? 1 : std::min(groups, static_cast<size_t>(threads) * 4);
+    const size_t groupsPerPartition = (groups + partitions - 1) / partitions;
+    // buckets[w][p]: ids parsed by worker w whose home group is in partition p
+    std::vector<std::vector<std::vector<uint32_t>>> buckets(static_cast<size_t>(threads),
+                                                           std::vector<std::vector<uint32_t>>(partitions));
+
+    // Phase 1: verify, decrypt and parse chunks, building nodes in place. built[c]
+    // counts the nodes of chunk c built so far, so a failed load can wipe them.
+    const RepeatingKeyXor cipher(key);
+    std::atomic<size_t> nextChunk(0);
+    std::atomic<bool> failed(false);
+    std::vector<uint64_t> built(static_cast<size_t>(chunks), 0);
+    runWorkers(threads, [&](int w) {
+        PayloadMac mac(key);
+        if (!mac.ok()) {
+            failed = true;
+            return;
+        }
+        const Credential::allocator_type alloc(arenas[w]);
+        std::string packed, plain;
+        TABLE_STAT(PhaseTimer timer(&counters.load);)
+        for (size_t c = nextChunk++; c < chunks && !failed; c = nextChunk++) {
+            const char* data = payload + offsets[c];
+            const size_t len = offsets[c + 1] - offsets[c];
+            unsigned char calc[HMAC_SIZE];
+            if (!chunkMac(mac, c, data, len, calc) ||
+                std::memcmp(calc, chunkTable + c * entrySize + 16, HMAC_SIZE) != 0) {
+                failed = true;
+                return;
+            }
+            TABLE_STAT(timer.lap(&PhaseCounters::mac);)
+            if (!openChunk(data, len, offsets[c], rawLength[c], cipher, dictionary, packed, plain
+                           TABLE_STAT(, &timer))) {
+                failed = true;
+                return;
+            }
 
-    std::ifstream inFile(filename, std::ios::binary | std::ios::ate);
-    if (!inFile.is_open()) return false;
+            const char* pos = plain.data();
+            const char* end = pos + plain.size();
+            for (uint64_t id = firstRecord[c]; id < firstRecord[c + 1]; ++id) {
+                std::string_view site, username, password;
+                if (!readField(pos, end, site) || !readField(pos, end, username) || !readField(pos, end, password)) {
+                    failed = true;
+                    return;
+                }
+                HashNode* n = new (&node(static_cast<uint32_t>(id))) HashNode(alloc);
+                n->nextFree = NODE_LIVE;
+                n->credential.site.assign(site);
+                n->credential.username.assign(username);
+                n->credential.password.assign(password);
+                ++built[c];
+                if (adopted) {
+                    n->hash = getLE(layout + hashesOffset + static_cast<size_t>(id) * 8, 8);
+                    continue;
+                }
+                n->hash = hasher(site, username);
+                buckets[w][homeGroup(n->hash, groupMask) / groupsPerPartition].push_back(static_cast<uint32_t>(id));
+            }
+            if (pos != end) {
+                failed = true;
+                return;
+            }
+            TABLE_STAT(timer.lap(&PhaseCounters::parse);)
+        }
+    });
+    if (failed) {
+        // These nodes are not counted in nodeCount, so clear() would not see them
+        for (size_t c = 0; c < chunks; ++c) {
+            for (uint64_t id = firstRecord[c]; id < firstRecord[c] + built[c]; ++id) {
+                node(static_cast<uint32_t>(id)).credential.wipePassword();
+            }
+        }
+        return false;
+    }
+    nodeCount = static_cast<uint32_t>(records);
+    count = static_cast<int>(records);
+    if (adopted) {
+        layoutLoaded = true;
+        return true;
+    }
 
-    std::streamsize size = inFile.tellg();
-    inFile.seekg(0, std::ios::beg);
-    if (size == 0) {
-        inFile.close();
-        return true; // empty file -> nothing to load
+    // Phase 2: fill the slot index partition by partition
+    std::vector<std::vector<uint32_t>> spilled(partitions);
+    std::atomic<size_t> nextPartition(0);
+    runWorkers(threads, [&](int) {
+        TABLE_STAT(PhaseTimer timer(&counters.load);)
+        for (size_t p = nextPartition++; p < partitions; p = nextPartition++) {
+            const size_t firstGroup = p * groupsPerPartition;
+            const size_t endGroup = std::min(groups, firstGroup + groupsPerPartition);
+            for (const std::vector<std::vector<uint32_t>>& workerBuckets : buckets) {
+                for (uint32_t id : workerBuckets[p]) {
+                    if (!placeNodeWithin(index, id, node(id).hash, firstGroup, endGroup)) spilled[p].push_back(id);
+                }
+            }
+        }
+        TABLE_STAT(timer.lap(&PhaseCounters::parse);)
+    });
+    TABLE_STAT(timer = PhaseTimer(&counters.load);)
+    for (const std::vector<uint32_t>& ids : spilled) {
+        for (uint32_t id : ids) placeNode(index, id, node(id).hash);
     }
+    TABLE_STAT(timer.lap(&PhaseCounters::parse);)
+    return true;
+}
 
-    // Always expect new format (MAGIC + HMAC + payload) for integrity/auth
-    if (static_cast<size_t>(size) < FILE_MAGIC_SIZE + HMAC_SIZE) {
-        inFile.close();
-        return false; // File too small to be valid format
+// Installs a saved layout (FLAG_LAYOUT) as the index of the freshly cleared table:
+// the arrays are copied straight into a new slot index and the saved hash policy
+// state is adopted. False, leaving the table as it was, if the layout does not fit
+// this build (another hash policy or layout version) or its arrays do not add up;
+// load() then rebuilds the index from the records.
+template <class Hasher>
+bool BasicHashTable<Hasher>::adoptLayout(const char* layout, size_t layoutSize, size_t keyOffset, uint64_t records,
+                                         std::string_view key) {
+    if (!LAYOUT_SUPPORTED || layoutSize < LAYOUT_HEADER_SIZE || getLE(layout, 4) != LAYOUT_VERSION) return false;
+    char secret[LAYOUT_SECRET_SIZE];
+    RepeatingKeyXor(key).apply(layout + 4, secret, LAYOUT_SECRET_SIZE, keyOffset + 4);
+    if (getLE(secret, 4) != sizeof(Hasher)) return false;
+    Hasher saved = hasher;
+    std::memcpy(static_cast<void*>(&saved), secret + 4, sizeof(Hasher));
+    if (saved(LAYOUT_CHECK_SITE, LAYOUT_CHECK_USER) != getLE(secret + 4 + LAYOUT_POLICY_SIZE, 8)) return false;
+
+    const uint64_t cap = getLE(layout + 4 + LAYOUT_SECRET_SIZE, 8);
+    if (cap < GROUP_SIZE || cap > (1u << 30) || roundCapacity(static_cast<int>(cap)) != static_cast<int>(cap) ||
+        static_cast<double>(records) > static_cast<double>(cap) * loadFactorThreshold) {
+        return false;
     }
+    const size_t slots = static_cast<size_t>(cap);
+    const size_t groups = slots / GROUP_SIZE;
+    if (layoutSize != LAYOUT_HEADER_SIZE + slots + groups * 4 + slots * 4 + static_cast<size_t>(records) * 8) return false;
 
-    // Read magic first
-    std::string magicBuf(FILE_MAGIC_SIZE, '\0');
-    inFile.read(&magicBuf[0], FILE_MAGIC_SIZE);
-    if (inFile.gcount() != static_cast<std::streamsize>(FILE_MAGIC_SIZE)) {
-        inFile.close();
+    SlotIndex idx;
+    idx.allocate(static_cast<int>(cap));
+    const char* p = layout + LAYOUT_HEADER_SIZE;
+    std::memcpy(idx.ctrl, p, slots);
+    std::memcpy(idx.overflow, p + slots, groups * 4);
+    std::memcpy(idx.slots, p + slots + groups * 4, slots * 4);
+
+    // Every full slot must name a record, and there must be one per record
+    uint64_t full = 0;
+    bool inRange = true;
+    for (size_t slot = 0; slot < slots; ++slot) {
+        if (idx.ctrl[slot] == CTRL_EMPTY) continue;
+        ++full;
+        inRange &= idx.slots[slot] < records;
+    }
+    if (!inRange || full != records) {
+        idx.release();
         return false;
     }
+    index.release();
+    index = idx;
+    capacity = static_cast<int>(cap);
+    hasher = saved;
+    return true;
+}
 
-    if (std::memcmp(magicBuf.data(), FILE_MAGIC, FILE_MAGIC_SIZE) != 0) {
-        inFile.close();
-        return false; // Magic header mismatch: file corrupted or wrong format
+// Opens filename in journaled mode. The snapshot must verify with key before either
+// log is read, and a log whose header does not verify fails the open without being
+// modified. A torn tail is cut off so new records follow the last intact one.
+template <class Hasher>
+bool BasicHashTable<Hasher>::openJournal(const std::string& filename, std::string_view key, int threads) {
+    closeJournal();
+    if (fileExists(filename)) {
+        if (!load(filename, key, threads)) return false;
+    } else {
+        clear();
     }
 
-    // Read HMAC
-    std::string fileHmac(HMAC_SIZE, '\0');
-    inFile.read(&fileHmac[0], HMAC_SIZE);
-    if (inFile.gcount() != static_cast<std::streamsize>(HMAC_SIZE)) {
-        inFile.close();
+    std::unique_ptr<VaultJournal> j = std::make_unique<VaultJournal>(filename, key);
+    if (!j->mac.ok()) return false;
+    // ".log.1" is left by a compaction that did not finish; its changes precede ".log"
+    size_t oldIntact = 0, intact = 0;
+    if (!replayJournal(j->oldLogName(), key, oldIntact, j->chain) ||
+        !replayJournal(j->logName(), key, intact, j->chain)) {
+        clear();
+        return false;
+    }
+    bool ok = intact == 0 ? j->create() : j->log.open(j->logName()) && j->log.truncate(intact);
+    if (!ok) {
+        clear();
         return false;
     }
+    journal = std::move(j);
+
+    // Fold a leftover ".log.1" into the snapshot right away
+    if (fileExists(journal->oldLogName())) compact();
+    return true;
+}
 
-    // Read payload
-    std::streamsize payloadSize = size - static_cast<std::streamsize>(FILE_MAGIC_SIZE + HMAC_SIZE);
-    std::string encryptedData(static_cast<size_t>(payloadSize), '\0');
-    if (payloadSize > 0) {
-        inFile.read(&encryptedData[0], payloadSize);
-        if (inFile.gcount() != payloadSize) {
-            inFile.close();
+// Replays one log file over the table (with no journal attached, so nothing is re-logged)
+template <class Hasher>
+bool BasicHashTable<Hasher>::replayJournal(const std::string& logName, std::string_view key, size_t& intact,
+                                           unsigned char* chain) {
+    intact = 0;
+    MappedFile file;
+    if (!file.open(logName)) return !fileExists(logName); // No log: nothing to replay
+    PayloadMac mac(key);
+    if (!mac.ok()) return false;
+    return replayLog(file.data(), file.size(), RepeatingKeyXor(key), mac, intact, chain,
+                     [this](char op, const std::string_view* fields, size_t n) {
+        if (op == JOURNAL_PUT && n == 3) {
+            emplace(fields[0], fields[1], fields[2]);
+        } else if (op == JOURNAL_REMOVE && n == 2) {
+            remove(fields[0], fields[1]);
+        } else if (op == JOURNAL_CLEAR && n == 0) {
+            clear();
+        } else {
             return false;
         }
+        return true;
+    });
+}
+
+// Appends one change to the log, then starts a compaction once the log is large
+template <class Hasher>
+void BasicHashTable<Hasher>::journalRecord(char op, std::string_view site, std::string_view username,
+                                           std::string_view password) {
+    VaultJournal& j = *journal;
+    j.record.assign(LOG_LENGTH_SIZE, '\0');
+    j.record += op;
+    if (op != JOURNAL_CLEAR) {
+        appendField(j.record, site);
+        appendField(j.record, username);
+    }
+    if (op == JOURNAL_PUT) appendField(j.record, password);
+    if (!j.appendRecord()) {
+        j.failed = true;
+        return;
     }
-    inFile.close();
+    if (j.threshold != 0 && j.log.size() >= j.threshold) startCompaction();
+}
 
-    // Verify HMAC (always, regardless of OpenSSL)
-    std::string calcHmac = computeHMAC_SHA256(encryptedData, key);
-    if (calcHmac.size() != fileHmac.size() || calcHmac != fileHmac) {
-        return false; // integrity/auth failed: wrong key or file corrupted
+// Background compaction. The table is frozen in a copy-on-write snapshot (see
+// saveInBackground), the log is rotated to ".log.1" and a fresh log takes new
+// changes while a background thread serializes, encrypts and writes the snapshot.
+// If a previous compaction or background save is still running the log simply
+// keeps growing until the next change.
+template <class Hasher>
+bool BasicHashTable<Hasher>::startCompaction() {
+    VaultJournal& j = *journal;
+    if (j.compaction.valid()) {
+        if (j.compaction.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return true;
+        j.finishCompaction();
     }
+    if (frozen && !frozen->done.load(std::memory_order_acquire)) return true;
+    // A ".log.1" left by a failed compaction holds changes no snapshot has yet
+    if (fileExists(j.oldLogName())) return compact();
+
+    takeSnapshot();
+    Snapshot* snapshot = frozen.get(); // Owned by the table, as in saveInBackground
 
-    // Decrypt and parse
-    std::string decryptedData = xorCipher(encryptedData, key);
-    std::stringstream ss(decryptedData);
-    std::string line;
-    while (std::getline(ss, line)) {
-        if (!line.empty() && line.length() > 5) {
-            insert(Credential::fromCSV(line));
+    {
+        // Commits already requested cover records in the old log, so it is synced first
+        std::lock_guard<std::mutex> guard(j.fileLock);
+        if (!j.log.sync()) j.failed = true;
+        j.log.close();
+        if (std::rename(j.logName().c_str(), j.oldLogName().c_str()) != 0) {
+            j.failed = true;
+            return j.log.open(j.logName());
+        }
+        if (!j.create()) {
+            j.failed = true;
+            return false;
         }
     }
+    j.compaction = std::async(std::launch::async, [vaultName = j.vaultName, key = j.key, oldLog = j.oldLogName(), snapshot]() {
+        bool ok = writeSnapshot(*snapshot, vaultName, key);
+        snapshot->done.store(true, std::memory_order_release);
+        return ok && std::remove(oldLog.c_str()) == 0;
+    }).share();
+    frozenResult = j.compaction;
     return true;
 }
 
-// Clears all entries from the hash table (keeps capacity)
-void HashTable::clear() {
-    for (int i = 0; i < capacity; ++i) {
-        HashNode* node = table[i];
-        while (node != nullptr) {
-            HashNode* next = node->next;
-            delete node;
-            node = next;
-        }
-        table[i] = nullptr;
+// Folds both logs into a fresh snapshot now. ".log.1" goes before ".log" is reset:
+// the remaining log must always be a suffix of the changes since the snapshot.
+// Success also clears journalFailed(), since the snapshot holds every change.
+template <class Hasher>
+bool BasicHashTable<Hasher>::compact() {
+    if (!journal) return false;
+    journal->finishCompaction();
+    if (!save(journal->vaultName, journal->key)) {
+        journal->failed = true;
+        return false;
+    }
+    std::remove(journal->oldLogName().c_str());
+    std::lock_guard<std::mutex> guard(journal->fileLock);
+    if (!journal->create()) {
+        journal->failed = true;
+        return false;
+    }
+    journal->failed = false;
+    return true;
+}
+
+// Waits for a background compaction and detaches the log. The files stay as they
+// are; openJournal() picks up from them.
+template <class Hasher>
+void BasicHashTable<Hasher>::closeJournal() {
+    if (!journal) return;
+    journal->committer.reset(); // Syncs a pending batch first
+    journal->finishCompaction();
+    journal.reset();
+}
+
+// Group commit of the log: one fsync for every commit() made within the window
+template <class Hasher>
+std::shared_future<bool> BasicHashTable<Hasher>::commit() {
+    if (!journal) {
+        std::promise<bool> notJournaled;
+        notJournaled.set_value(false);
+        return notJournaled.get_future().share();
+    }
+    VaultJournal& j = *journal;
+    if (!j.committer) {
+        j.committer = std::make_unique<CommitScheduler>([&j]() {
+            std::lock_guard<std::mutex> guard(j.fileLock);
+            return j.log.sync();
+        }, j.commitWindow);
     }
+    return j.committer->request();
+}
+
+template <class Hasher>
+void BasicHashTable<Hasher>::setCommitWindow(std::chrono::microseconds window) {
+    if (!journal) return;
+    journal->commitWindow = window;
+    if (journal->committer) journal->committer->setWindow(window);
+}
+
+template <class Hasher>
+void BasicHashTable<Hasher>::setCompactionThreshold(size_t bytes) {
+    if (journal) journal->threshold = bytes;
+}
+
+template <class Hasher>
+size_t BasicHashTable<Hasher>::journalSize() const {
+    return journal ? journal->log.size() : 0;
+}
+
+template <class Hasher>
+uint64_t BasicHashTable<Hasher>::journalCommits() const {
+    return journal && journal->committer ? journal->committer->commits() : 0;
+}
+
+template <class Hasher>
+bool BasicHashTable<Hasher>::journalFailed() const {
+    return journal && journal->failed;
+}
+
+// Clears all entries from the hash table (keeps capacity).
+// Waits for a background save still reading a snapshot, since the strings go.
+// Then one pass zeroes the passwords; the rest is O(1) apart from the allocator:
+// the index is swapped for a fresh lazily-zeroed one, the string pool is reset and
+// the node slabs are kept for reuse. Nodes are re-constructed when handed out
+// again, so none of them needs a destructor call.
+template <class Hasher>
+void BasicHashTable<Hasher>::clear() {
+    finishSnapshot();
+    wipePasswords();
+    oldIndex.release();
+    index.release();
+    index.allocate(capacity);
+    oldSiteIndex.release();
+    siteIndex.release();
+    siteIndex.allocate(capacity);
+    stringPool.release();
+    loadArenas.clear();
+    nodeCount = 0;
+    freeList = NO_NODE;
     count = 0;
+    if (secondary) {
+        secondary->sites.clear();
+        secondary->usernames.clear();
+    }
+    if (journal) journalRecord(JOURNAL_CLEAR, std::string_view(), std::string_view(), std::string_view());
 }
 
-// Helpers for Math
-bool HashTable::isPrime(int n) {
-    if (n <= 1) return false;
-    for (int i = 2; i * i <= n; i++) {
-        if (n % i == 0) return false;
+template <class Hasher>
+void BasicHashTable<Hasher>::setSecondaryIndexes(bool enabled) {
+    if (!enabled) {
+        secondary.reset();
+    } else if (!secondary) {
+        secondary.reset(new SecondaryIndexes());
+        rebuildSecondaryIndexes();
     }
-    return true;
 }
 
-int HashTable::nextPrime(int n) {
-    while (!isPrime(n)) {
-        n++;
+// Indexes every live node, in id order
+template <class Hasher>
+void BasicHashTable<Hasher>::rebuildSecondaryIndexes() {
+    for (SecondaryIndex* index : {&secondary->sites, &secondary->usernames}) {
+        index->clear();
+        index->reserve(static_cast<size_t>(count), nodeCount);
     }
-    return n;
+    for (uint32_t id = 0; id < nodeCount; ++id) {
+        const HashNode& n = node(id);
+        if (n.nextFree != NODE_LIVE) continue;
+        secondary->sites.add(n.credential.site, id);
+        secondary->usernames.add(n.credential.username, id);
+    }
+}
+
+template <class Hasher>
+typename BasicHashTable<Hasher>::EntryRange BasicHashTable<Hasher>::entriesForSite(std::string_view site) const {
+    if (!secondary) return EntryRange(this, nullptr, SecondaryIndex::END, 0);
+    size_t n;
+    const uint32_t first = secondary->sites.first(site, &n);
+    return EntryRange(this, &secondary->sites, first, n);
 }
 
-void HashTable::printTable() {
-    for (int i = 0; i < capacity; i++) {
-        if (table[i] != nullptr) {
-            std::cout << "Bucket " << i << ": ";
-            HashNode* temp = table[i];
-            while (temp != nullptr) {
-                std::cout << "[" << temp->credential.site << "] -> ";
-                temp = temp->next;
+template <class Hasher>
+typename BasicHashTable<Hasher>::EntryRange BasicHashTable<Hasher>::entriesForUsername(std::string_view username) const {
+    if (!secondary) return EntryRange(this, nullptr, SecondaryIndex::END, 0);
+    size_t n;
+    const uint32_t first = secondary->usernames.first(username, &n);
+    return EntryRange(this, &secondary->usernames, first, n);
+}
+
+template <class Hasher>
+void BasicHashTable<Hasher>::printTable() {
+    const SlotIndex* indexes[2] = {&oldIndex, &index};
+    for (const SlotIndex* idx : indexes) {
+        if (idx == &oldIndex && !migrating()) continue;
+        if (idx == &oldIndex) std::cout << "(resizing, old index)\n";
+        for (int g = 0; g < idx->capacity / GROUP_SIZE; g++) {
+            uint32_t full = matchFull(&idx->ctrl[g * GROUP_SIZE]);
+            if (full != 0 || idx->overflow[g] != 0) {
+                std::cout << "Group " << g << ": ";
+                while (full != 0) {
+                    int slot = g * GROUP_SIZE + lowestBit(full);
+                    std::cout << "[" << node(idx->slots[slot]).credential.site << "] ";
+                    full &= full - 1;
+                }
+                std::cout << "(overflow " << idx->overflow[g] << ")\n";
             }
-            std::cout << "NULL\n";
         }
     }
 }
+
+// Number of groups between an entry's home group and the group holding it
+template <class Hasher>
+int BasicHashTable<Hasher>::probeLength(const SlotIndex& idx, int slot) const {
+    const size_t groupMask = idx.groupMask();
+    const size_t targetGroup = static_cast<size_t>(slot) / GROUP_SIZE;
+    size_t g = homeGroup(node(idx.slots[slot]).hash, groupMask);
+    int steps = 0;
+    while (g != targetGroup) {
+        ++steps;
+        g = (g + static_cast<size_t>(steps)) & groupMask;
+    }
+    return steps;
+}
+
+template <class Hasher>
+std::vector<int> BasicHashTable<Hasher>::probeLengthHistogram() const {
+    std::vector<int> histogram;
+    const SlotIndex* indexes[2] = {&oldIndex, &index};
+    for (const SlotIndex* idx : indexes) {
+        for (int slot = 0; slot < idx->capacity; slot++) {
+            if (idx->ctrl[slot] == CTRL_EMPTY) continue;
+            size_t length = static_cast<size_t>(probeLength(*idx, slot));
+            if (histogram.size() <= length) histogram.resize(length + 1, 0);
+            histogram[length]++;
+        }
+    }
+    return histogram;
+}
+
+template <class Hasher>
+TableStats BasicHashTable<Hasher>::stats() const {
+    TableStats s;
+    s.size = count;
+    s.capacity = capacity;
+    s.loadFactor = capacity != 0 ? static_cast<double>(count) / capacity : 0;
+    s.resizing = migrating();
+    s.probeLengths = probeLengthHistogram();
+    s.maxProbeLength = s.probeLengths.empty() ? 0 : static_cast<int>(s.probeLengths.size()) - 1;
+#if HASHTABLE_STATS
+    s.hits = counters.hits.load(std::memory_order_relaxed);
+    s.misses = counters.misses.load(std::memory_order_relaxed);
+    s.lookups = s.hits + s.misses;
+    s.groupsProbed = counters.groupsProbed.load(std::memory_order_relaxed);
+    s.rehashes = counters.rehashes.load(std::memory_order_relaxed);
+    s.rehashSeconds = counters.rehashNanos.load(std::memory_order_relaxed) / 1e9;
+    counters.save.read(s.save);
+    counters.load.read(s.load);
+#endif
+    return s;
+}
+
+template <class Hasher>
+void BasicHashTable<Hasher>::resetStats() {
+#if HASHTABLE_STATS
+    for (std::atomic<uint64_t>* c : {&counters.hits, &counters.misses, &counters.groupsProbed, &counters.rehashes,
+                                     &counters.rehashNanos}) {
+        c->store(0);
+    }
+    counters.save.reset();
+    counters.load.reset();
+#endif
+}
+
+// VaultReader
+
+VaultReader::VaultReader()
+    : payload(nullptr), chunkTable(nullptr), entrySize(0), chunks(0), records(0), seed(0), blocksDecrypted(0) {}
+
+VaultReader::~VaultReader() {}
+
+bool VaultReader::open(const std::string& filename, std::string_view vaultKey) {
+    close();
+    VaultLayout v;
+    PayloadMac fileMac(vaultKey);
+    // A lookup touches the chunk table and one block, so readahead would only waste I/O
+    if (!file.open(filename, MappedFile::RANDOM) || !parseLayout(file.data(), file.size(), v) || (v.flags & FLAG_INDEXED) == 0 ||
+        !fileMac.ok() || !verifyLayout(v, fileMac)) {
+        close();
+        return false;
+    }
+
+    // Block offsets come from the (now authenticated) lengths in the chunk table
+    offsets.assign(static_cast<size_t>(v.chunks) + 1, 0);
+    for (size_t c = 0; c < v.chunks; ++c) {
+        uint64_t len = getLE(v.chunkTable + c * v.entrySize, 8);
+        uint64_t raw;
+        if (len > v.payloadSize - offsets[c] || !rawChunkLength(v.chunkTable + c * v.entrySize, v.entrySize, len, raw)) {
+            close();
+            return false;
+        }
+        offsets[c + 1] = offsets[c] + static_cast<size_t>(len);
+    }
+    cipher = std::make_unique<RepeatingKeyXor>(vaultKey);
+    mac = std::make_unique<HmacSha256>(vaultKey);
+    payload = v.payload;
+    chunkTable = v.chunkTable;
+    entrySize = v.entrySize;
+    chunks = v.chunks;
+    records = v.records;
+    seed = indexSeed(vaultKey);
+    readDictionary(v, *cipher, dictionary);
+    return true;
+}
+
+void VaultReader::close() {
+    file.close();
+    cipher.reset();
+    mac.reset();
+    payload = chunkTable = nullptr;
+    chunks = records = 0;
+    offsets.clear();
+    dictionary.clear();
+}
+
+uint64_t VaultReader::firstHash(size_t chunk) const {
+    return getLE(chunkTable + chunk * entrySize + CHUNK_ENTRY_SIZE, 8);
+}
+
+// Verifies block `chunk` against its MAC in the index and decrypts (and expands) it into `plain`
+bool VaultReader::readBlock(size_t chunk) {
+    const char* data = payload + offsets[chunk];
+    const size_t len = offsets[chunk + 1] - offsets[chunk];
+    char position[8];
+    putLE(position, chunk, 8);
+    unsigned char calc[HMAC_SIZE];
+    mac->init();
+    mac->update(position, sizeof(position));
+    mac->update(data, len);
+    mac->final(calc);
+    if (std::memcmp(calc, chunkTable + chunk * entrySize + 16, HMAC_SIZE) != 0) return false;
+    uint64_t raw;
+    rawChunkLength(chunkTable + chunk * entrySize, entrySize, len, raw); // Checked by open()
+    if (!openChunk(data, len, offsets[chunk], raw, *cipher, dictionary, packed, plain)) return false;
+    ++blocksDecrypted;
+    return true;
+}
+
+bool VaultReader::find(std::string_view site, std::string_view username, Credential& out) {
+    if (chunks == 0) return false;
+    // The site's records start in the last block whose first hash is below h (its
+    // tail may hold them) or in block 0, and run on through blocks starting at h
+    const uint64_t h = indexHash(site, seed);
+    size_t lo = 0, hi = static_cast<size_t>(chunks);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (firstHash(mid) < h) lo = mid + 1;
+        else hi = mid;
+    }
+    for (size_t c = lo == 0 ? 0 : lo - 1; c < chunks && (c + 1 == lo || firstHash(c) <= h); ++c) {
+        if (!readBlock(c)) return false;
+        const char* pos = plain.data();
+        const char* end = pos + plain.size();
+        std::string_view s, u, p;
+        while (pos < end) {
+            if (!readField(pos, end, s) || !readField(pos, end, u) || !readField(pos, end, p)) return false;
+            if (s == site && (username.empty() || u == username)) {
+                out.site.assign(s);
+                out.username.assign(u);
+                out.password.assign(p);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// The member definitions above are compiled once per shipped hash policy
+template class BasicHashTable<SeededHash>;
+template class BasicHashTable<PolynomialHash>;
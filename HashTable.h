@@ -3,7 +3,21 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <memory_resource>
+#include <functional>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <atomic>
+#include <iterator>
+#include <cstddef>
 #include "HashNode.h"
+#include "HashPolicy.h"
+#include "VaultIO.h"
+#include "TableStats.h"
+#include "SecondaryIndex.h"
 
 // Detect OpenSSL availability at compile time; expose macro for tests and implementation
 #if defined(__has_include)
@@ -16,42 +30,389 @@
 #  define HASH_HAS_OPENSSL 0
 #endif
 
-class HashTable {
+class VaultJournal; // Write-ahead log of a journaled table (HashTable.cpp)
+class HmacSha256;
+class StreamCipher;
+
+// Open-addressing hash table.
+// Slots are organised in groups of 16. Each slot has one metadata byte in `ctrl`
+// (empty marker or a 7-bit fragment of the hash), so a whole group is checked
+// with a single 16-byte SIMD compare before any credential is touched.
+// Every group also counts how many entries probed past it while being inserted;
+// a lookup stops at the first group whose count is zero, which lets remove()
+// free a slot outright instead of leaving a tombstone.
+//
+// Growing is incremental by default: a new, larger slot index is allocated next
+// to the old one and each insert/remove migrates a couple of old groups, while
+// lookups consult both. No single operation pays for the whole resize.
+//
+// Entries are placed by the hash of site and username together, so a site with many
+// accounts does not make one long probe chain. A search by site alone goes through
+// the site directory instead: a second slot index of the same capacity, keyed by the
+// site's own hash, with one slot per distinct site naming one of its nodes. The
+// other nodes of the site hang off that one in a doubly linked list. The directory
+// grows and migrates in step with the main index.
+//
+// The hash function is a compile-time policy (see HashPolicy.h). Each node caches
+// its full hash, so resizing never rehashes strings and probes compare the cached
+// hash before touching any string. The member functions live in HashTable.cpp and
+// are instantiated there for every shipped policy.
+template <class Hasher = SeededHash>
+class BasicHashTable {
 private:
-    std::vector<HashNode*> table; // The array of buckets
-    int capacity;                 // Total number of buckets
-    int count;                    // Total number of items stored
-    float loadFactorThreshold;    // Limit before we resize (e.g., 0.75)
+    static constexpr int GROUP_SIZE = 16;
+    static constexpr int NODE_SLAB_SIZE = 4096;     // Nodes per storage slab
+
+    // One generation of the probing arrays. ctrl and overflow come from calloc,
+    // so large indexes are zeroed lazily by the OS instead of in one memset.
+    struct SlotIndex {
+        uint8_t* ctrl;      // Metadata byte per slot (0 = empty, else 0x80 | hash fragment)
+        uint32_t* slots;    // Node id stored in each slot
+        uint32_t* overflow; // Per group: entries that probed past it
+        int capacity;       // Total number of slots (multiple of GROUP_SIZE)
+
+        SlotIndex() : ctrl(nullptr), slots(nullptr), overflow(nullptr), capacity(0) {}
+        void allocate(int cap);
+        void release();
+        size_t groupMask() const { return static_cast<size_t>(capacity / GROUP_SIZE) - 1; }
+    };
+
+    SlotIndex index;                // Current slot index (receives all inserts)
+    SlotIndex oldIndex;             // Index being drained during an incremental resize
+    SlotIndex siteIndex;            // Site directory: a node id per distinct site, by site hash
+    SlotIndex oldSiteIndex;         // Directory being drained alongside oldIndex
+    // The other nodes of a site, linked from the one its directory slot names (the head)
+    struct SiteLink {
+        uint32_t next;
+        uint32_t prev;
+    };
+    std::vector<std::unique_ptr<SiteLink[]>> siteLinkSlabs; // NODE_SLAB_SIZE links per slab, by node id
+    int migrateGroup;               // Next group of oldIndex to migrate
+    bool incrementalRehash;         // Grow incrementally (true) or stop-the-world (false)
+    bool saveLayout;                // save() also writes the slot index (see setSaveLayout)
+    bool compressSaves;             // save() compresses the records (see setCompression)
+    bool layoutLoaded;              // The last load() adopted a saved slot index
+    std::pmr::unsynchronized_pool_resource stringPool; // Bytes of every stored site/username/password; freed bytes are reused
+    std::vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>> loadArenas; // Filled by parallel load workers
+    std::vector<HashNode*> nodeSlabs; // Credential storage, NODE_SLAB_SIZE nodes per slab
+    uint32_t nodeCount;             // Node ids constructed since the last clear()
+    uint32_t freeList;              // Head of the recycled node id list
+    int capacity;                   // Slots in the current index
+    int count;                      // Total number of items stored
+    float loadFactorThreshold;      // Limit before we resize (e.g., 0.875)
+    Hasher hasher;                  // Hash policy instance (holds the seed, if any)
+    std::unique_ptr<VaultJournal> journal; // Open write-ahead log (journaled mode only)
+    TABLE_STAT(mutable TableCounters counters;) // Instrumentation (HASHTABLE_STATS builds)
+
+    // Secondary indexes over node ids (see setSecondaryIndexes); null while disabled
+    struct SecondaryIndexes {
+        SecondaryIndex sites;
+        SecondaryIndex usernames;
+    };
+    std::unique_ptr<SecondaryIndexes> secondary;
 
-    // Helper to find the next prime number for resizing
-    int nextPrime(int n);
-    bool isPrime(int n);
+    // The nodes as of some moment: a copy-on-write snapshot read by a background
+    // save (see saveInBackground), or the live table described for save()
+    struct Snapshot {
+        explicit Snapshot(const Hasher& h)
+            : nodeCount(0), count(0), capacity(0), hasher(h), saveLayout(false), compress(false), done(false) {}
+        std::vector<HashNode*> slabs;    // Node slabs as of the snapshot
+        uint32_t nodeCount;
+        int count;
+        int capacity;
+        Hasher hasher;
+        bool saveLayout;
+        bool compress;
+        std::atomic<bool> done;          // Set once the background save stops reading the slabs
+        TABLE_STAT(PhaseCounters* saveCounters = nullptr;) // Where the save's phase times go
+    };
+    std::shared_ptr<Snapshot> frozen;      // Snapshot a background save may still be reading
+    std::shared_future<bool> frozenResult; // Outcome of that save. Kept here, not in the snapshot:
+                                           // the reader's state must not own what owns it.
+    std::vector<bool> slabCopied;        // Per frozen slab: the table has moved on to its own copy
+    struct RetiredSlab {
+        HashNode* nodes;
+        uint32_t constructed; // Nodes built in it, destroyed with it
+    };
+    std::vector<RetiredSlab> retiredSlabs; // Frozen slabs the table replaced; freed with the snapshot
 
-    // Helper for encryption/decryption (XOR Cipher)
-    std::string xorCipher(std::string data, std::string key);
+    // Helpers for the probing engine
+    static int roundCapacity(int n);
+    HashNode& node(uint32_t id) const { return nodeSlabs[id / NODE_SLAB_SIZE][id % NODE_SLAB_SIZE]; }
+    // Every write to a node goes through here, so a frozen slab is copied first
+    HashNode& writableNode(uint32_t id) {
+        if (frozen) unshareSlab(id / NODE_SLAB_SIZE);
+        return node(id);
+    }
+    void unshareSlab(size_t slab);
+    void takeSnapshot();
+    void finishSnapshot();
+    int findSlot(const SlotIndex& idx, std::string_view site, std::string_view username, size_t h) const;
+    int findSiteSlot(const SlotIndex& idx, std::string_view site, size_t h) const;
+    SiteLink& siteLink(uint32_t id) const { return siteLinkSlabs[id / NODE_SLAB_SIZE][id % NODE_SLAB_SIZE]; }
+    uint32_t findSiteNode(std::string_view site) const;
+    void linkSite(uint32_t id);
+    void unlinkSite(uint32_t id);
+    void rebuildSiteIndex();
+    static void placeNode(SlotIndex& idx, uint32_t id, size_t h);
+    bool placeNodeWithin(SlotIndex& idx, uint32_t id, size_t h, size_t firstGroup, size_t endGroup);
+    void removeSlot(SlotIndex& idx, int slot, size_t h);
+    uint32_t allocNode(std::string_view site, std::string_view username, std::string_view password, uint64_t h);
+    void freeNode(uint32_t id);
+    void setPassword(uint32_t id, std::string_view password);
+    void moveToPool(HashNode& n);
+    void wipePasswords();
+    void insertUnique(std::string_view site, std::string_view username, std::string_view password);
+    uint32_t findNode(std::string_view site, std::string_view username, size_t h) const;
+    int probeLength(const SlotIndex& idx, int slot) const;
+    void startResize(int newCapacity);
+    void migrateStep(int groups);
+    bool migrating() const { return oldIndex.ctrl != nullptr; }
+    template <class Fn> void forEachNode(Fn fn) const;
+    void describe(Snapshot& s) const;
+    template <class Fn> static void forEachChunk(const Snapshot& s, std::string_view key, Fn fn, std::vector<uint64_t>* tableHashes);
+    static std::string buildLayout(const Snapshot& s, const std::vector<uint64_t>& hashes);
+    static std::string buildDictionary(const Snapshot& s);
+    static bool writeSnapshot(const Snapshot& s, const std::string& filename, std::string_view key);
+    bool adoptLayout(const char* layout, size_t layoutSize, size_t keyOffset, uint64_t records, std::string_view key);
+    bool parseRecordsV1(const char* data, size_t len);
+    bool parseRecordsV2(const char* data, size_t len, uint64_t records, uint64_t capacityHint);
+    bool loadChunks(const char* payload, size_t payloadSize, const char* chunkTable, uint64_t chunks,
+                    size_t entrySize, uint64_t records, uint64_t capacityHint, std::string_view key, int threads,
+                    const char* layout, size_t layoutSize, std::string_view dictionary);
+    enum JournalOp : char { JOURNAL_PUT = 1, JOURNAL_REMOVE = 2, JOURNAL_CLEAR = 3 };
+    bool replayJournal(const std::string& logName, std::string_view key, size_t& intact, unsigned char* chain);
+    void journalRecord(char op, std::string_view site, std::string_view username, std::string_view password);
+    bool startCompaction();
+    void rebuildSecondaryIndexes();
 
 public:
     // Constructor and Destructor
-    HashTable(int cap = 101);
-    ~HashTable();
+    BasicHashTable(int cap = 101, const Hasher& hashPolicy = Hasher());
+    ~BasicHashTable();
+    BasicHashTable(const BasicHashTable&) = delete;
+    BasicHashTable& operator=(const BasicHashTable&) = delete;
 
     // Core DSA Operations
-    int hash(std::string key);
-    void insert(Credential cred);
-    Credential* search(std::string site, std::string username = "");
-    bool update(std::string site, std::string username, std::string newPassword);
-    bool remove(std::string site, std::string username);
+    // Keys are taken as std::string_view: lookups never build temporary strings,
+    // and inserted fields are copied once, straight into the table's arena.
+    int hash(std::string_view site, std::string_view username = std::string_view());
+    void insert(const Credential& cred);
+    void emplace(std::string_view site, std::string_view username, std::string_view password);
+    Credential* search(std::string_view site, std::string_view username = std::string_view());
+    // Read-only lookup: changes nothing in the table (no slab copy during a background
+    // save; only the relaxed-atomic counters of a HASHTABLE_STATS build move), so
+    // concurrent calls are safe while no writer runs
+    const Credential* search(std::string_view site, std::string_view username = std::string_view()) const;
+    bool update(std::string_view site, std::string_view username, std::string_view newPassword);
+    bool remove(std::string_view site, std::string_view username);
     void rehash(int newCapacity);
 
+    // Bulk loading: presize for n entries, then insert a whole range at once
+    void reserve(int n);
+    void insertBulk(const Credential* first, const Credential* last, bool assumeUnique = false);
+    void insertBulk(const std::vector<Credential>& creds, bool assumeUnique = false);
+
+    // Choose between incremental (default) and stop-the-world growth
+    void setIncrementalRehash(bool enabled);
+
     // File Persistence Operations
-    bool save(std::string filename, std::string key);
-    bool load(std::string filename, std::string key);
-    
+    // save() writes the binary, chunked SPASSv02 format; load() also reads SPASSv01 files.
+    // save() is durable: the file is fsynced before it is renamed into place, and the
+    // directory after.
+    // load() memory-maps the file and verifies the MAC over the mapped bytes. Chunked
+    // files are decrypted and parsed by `threads` workers (0 = one per hardware thread).
+    bool save(const std::string& filename, std::string_view key);
+    bool load(const std::string& filename, std::string_view key, int threads = 1);
+
+    // Background save from a copy-on-write snapshot. The table is frozen as it is, in
+    // time proportional to its node slab count (one pointer per 4096 entries), and a
+    // background thread writes that state exactly as save() would while the table
+    // keeps taking changes. The first change to a node slab while the snapshot is
+    // being read copies that slab, so writers only copy the slabs they touch; the
+    // slot index is never shared, so resizes are unaffected. The future becomes true
+    // once the file is durably in place. Only one snapshot exists at a time: another
+    // background save, save(), clear() and load() first wait for a running one.
+    std::shared_future<bool> saveInBackground(const std::string& filename, std::string_view key);
+
+    // Persisted layout (off by default): save() and compaction snapshots also store the
+    // slot index and every entry's cached hash, plus the hash policy's state. load()
+    // then decrypts the index straight into place, adopting the saved policy state
+    // (e.g. the seed), and neither hashes nor inserts anything. It rebuilds the index
+    // as usual when the layout was written by another hash policy or layout version.
+    void setSaveLayout(bool enabled);
+    bool loadedLayout() const { return layoutLoaded; } // The last load() used a saved layout
+
+    // Compression (off by default): save() and compaction snapshots compress every
+    // block with a built-in LZ codec before encrypting it, against a dictionary of
+    // usernames and sites that recur across the vault, stored once in the file.
+    // Blocks stay independent, so parallel load() and VaultReader work as before.
+    // load() reads compressed and uncompressed files alike.
+    void setCompression(bool enabled);
+
+    // Entries found through a secondary index, viewed in place: iteration yields
+    // const Credential& straight from the table's node storage, nothing is copied.
+    // Like container iterators, a range is invalidated by any change to the table.
+    class EntryRange {
+    public:
+        class iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef Credential value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const Credential* pointer;
+            typedef const Credential& reference;
+
+            iterator(const BasicHashTable* table, const SecondaryIndex* index, uint32_t id)
+                : table(table), index(index), id(id) {}
+            reference operator*() const { return table->node(id).credential; }
+            pointer operator->() const { return &table->node(id).credential; }
+            iterator& operator++() {
+                id = index->next(id);
+                return *this;
+            }
+            iterator operator++(int) {
+                iterator before = *this;
+                ++*this;
+                return before;
+            }
+            bool operator==(const iterator& other) const { return id == other.id; }
+            bool operator!=(const iterator& other) const { return id != other.id; }
+
+        private:
+            const BasicHashTable* table;
+            const SecondaryIndex* index;
+            uint32_t id;
+        };
+
+        EntryRange(const BasicHashTable* table, const SecondaryIndex* index, uint32_t first, size_t count)
+            : table(table), index(index), firstId(first), count(count) {}
+        iterator begin() const { return iterator(table, index, firstId); }
+        iterator end() const { return iterator(table, index, SecondaryIndex::END); }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+    private:
+        const BasicHashTable* table;
+        const SecondaryIndex* index;
+        uint32_t firstId;
+        size_t count;
+    };
+
+    // Secondary indexes (off by default): site -> every entry of that site and
+    // username -> every entry with that username. Enabling builds both from the
+    // current entries; from then on insert, remove, clear and load keep them in
+    // sync (update and rehash leave them untouched: passwords are not indexed and
+    // entries keep their node ids when the slot index grows). Each entry costs 16
+    // bytes of links plus one map entry and key copy per distinct site and username.
+    // The queries return an empty range while the indexes are disabled.
+    void setSecondaryIndexes(bool enabled);
+    bool secondaryIndexes() const { return secondary != nullptr; }
+    EntryRange entriesForSite(std::string_view site) const;
+    EntryRange entriesForUsername(std::string_view username) const;
+
+    // Journaled persistence
+    // openJournal() loads filename (if it exists) and replays its write-ahead log
+    // (filename + ".log"); from then on every insert, update, remove and clear appends
+    // one small authenticated record to the log instead of rewriting the vault. A log
+    // cut short by a crash replays up to its last complete record. When the log grows
+    // past the compaction threshold it is folded into a fresh snapshot on a background
+    // thread; compact() does the same synchronously. load() closes the journal.
+    bool openJournal(const std::string& filename, std::string_view key, int threads = 1);
+    bool compact();
+    void closeJournal();
+    void setCompactionThreshold(size_t bytes);
+    // Group commit: the future becomes true once every change made before the call is
+    // on disk. Calls within the commit window (2 ms by default) share one fsync.
+    std::shared_future<bool> commit();
+    void setCommitWindow(std::chrono::microseconds window);
+    size_t journalSize() const;  // Bytes in the current log (0 when not journaled)
+    bool journaled() const { return journal != nullptr; }
+    uint64_t journalCommits() const; // Log syncs run for commit() so far
+    bool journalFailed() const;  // A log write or background compaction has failed
+
     // Clear all entries from the table
     void clear();
-    
-    // Debug helper (optional)
+
+    // Number of stored credentials
+    int size() const { return count; }
+
+    static constexpr int MIGRATE_GROUPS_PER_OP = 2; // Old groups moved by each insert/remove
+    // Old slot groups an incremental resize has yet to migrate (0 when none is running)
+    int migrationBacklog() const { return migrating() ? oldIndex.capacity / GROUP_SIZE - migrateGroup : 0; }
+
+    // Calls fn for every stored credential (unspecified order)
+    void forEach(const std::function<void(const Credential&)>& fn) const;
+
+    // Probe length histogram: result[k] = entries found in the k-th group of their
+    // probe sequence (k = 0 is the home group). Shows clustering from bad hashes.
+    std::vector<int> probeLengthHistogram() const;
+
+    // Runtime statistics (see TableStats.h): load factor and probe lengths of the
+    // index, measured on each call by walking it, plus the lookup, resize and
+    // save/load phase counters of a HASHTABLE_STATS build. resetStats() zeroes the
+    // counters.
+    TableStats stats() const;
+    void resetStats();
+
+    // Hash policy in use (e.g. to read its seed)
+    const Hasher& hashPolicy() const { return hasher; }
+
+    // Debug helpers (optional)
     void printTable();
+    // The snapshot a background save or compaction is reading, if any; lets tests
+    // check that it is freed once the save is done
+    std::weak_ptr<const void> currentSnapshot() const { return frozen; }
+};
+
+// The table used throughout SecurePass
+typedef BasicHashTable<SeededHash> HashTable;
+
+// Read-only lookups straight from a vault file written by save(), without loading it.
+// Records in the file are ordered by a keyed hash of their site and packed into
+// blocks of about 4 KiB, each with its own MAC; the chunk table keeps every block's
+// first hash and serves as the index. open() maps the file and verifies only the
+// header and that table. find() binary-searches the index, then verifies and
+// decrypts (and, in a compressed vault, expands) just the block or the few blocks
+// that can hold the site.
+class VaultReader {
+public:
+    VaultReader();
+    ~VaultReader();
+    VaultReader(const VaultReader&) = delete;
+    VaultReader& operator=(const VaultReader&) = delete;
+
+    // False if the file cannot be read, fails its MAC or has no index (SPASSv01,
+    // or SPASSv02 written before indexing)
+    bool open(const std::string& filename, std::string_view key);
+    void close();
+
+    // Copies the credential for site and username into out; an empty username
+    // matches any account of the site. False if there is none, or if a block
+    // that could hold it fails its MAC.
+    bool find(std::string_view site, std::string_view username, Credential& out);
+
+    uint64_t size() const { return records; }              // Records in the vault
+    uint64_t blocksRead() const { return blocksDecrypted; } // Blocks verified and decrypted so far
+
+private:
+    MappedFile file;
+    std::unique_ptr<StreamCipher> cipher;
+    std::unique_ptr<HmacSha256> mac;
+    const char* payload;
+    const char* chunkTable;
+    size_t entrySize;
+    uint64_t chunks;
+    uint64_t records;
+    uint64_t seed;               // Lookup hash seed (derived from the key)
+    std::vector<size_t> offsets; // Start of every block in the payload, plus its end
+    std::string dictionary;      // Decrypted compression dictionary (FLAG_COMPRESSED)
+    std::string packed;          // Decrypted, still compressed block
+    std::string plain;           // Decrypted block
+    uint64_t blocksDecrypted;
+
+    uint64_t firstHash(size_t chunk) const;
+    bool readBlock(size_t chunk);
 };
 
-#endif
\ No newline at end of file
+#endif
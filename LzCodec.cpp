@@ -0,0 +1,191 @@
+#include "LzCodec.h"
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    const size_t MIN_MATCH = 4;
+    const int DICT_HASH_BITS = 14;
+    const int BLOCK_HASH_BITS = 12;
+
+    inline uint32_t read32(const char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+    inline uint64_t read64(const char* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+
+    inline uint32_t hash4(const char* p, int bits) { return (read32(p) * 2654435761u) >> (32 - bits); }
+
+    // Copies 16 bytes; callers have checked there is room on both sides
+    inline void copy16(char* out, const void* in) { std::memcpy(out, in, 16); }
+
+    // Number of leading bytes a and b have in common, at most limit
+    inline size_t matchLength(const char* a, const char* b, size_t limit) {
+        size_t n = 0;
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        while (n + 8 <= limit) {
+            uint64_t diff = read64(a + n) ^ read64(b + n);
+            if (diff != 0) return n + (static_cast<size_t>(__builtin_ctzll(diff)) >> 3);
+            n += 8;
+        }
+#endif
+        while (n < limit && a[n] == b[n]) ++n;
+        return n;
+    }
+
+    // The part of a length past its 4-bit token field: 255 per byte until a smaller byte
+    char* writeLength(char* op, size_t n) {
+        while (n >= 255) {
+            *op++ = static_cast<char>(255);
+            n -= 255;
+        }
+        *op++ = static_cast<char>(n);
+        return op;
+    }
+
+    bool readLength(const unsigned char*& ip, const unsigned char* end, size_t limit, size_t& n) {
+        for (;;) {
+            if (ip == end || n > limit) return false;
+            unsigned char b = *ip++;
+            n += b;
+            if (b != 255) return true;
+        }
+    }
+
+    // One sequence: literals, then (if matchLen != 0) a match offset bytes back
+    char* writeSequence(char* op, const char* literals, size_t litLen, size_t offset, size_t matchLen) {
+        const size_t extra = matchLen != 0 ? matchLen - MIN_MATCH : 0;
+        char* token = op++;
+        *token = static_cast<char>((std::min<size_t>(litLen, 15) << 4) | std::min<size_t>(extra, 15));
+        if (litLen >= 15) op = writeLength(op, litLen - 15);
+        std::memcpy(op, literals, litLen);
+        op += litLen;
+        if (matchLen == 0) return op;
+        *op++ = static_cast<char>(offset & 0xff);
+        *op++ = static_cast<char>(offset >> 8);
+        if (extra >= 15) op = writeLength(op, extra - 15);
+        return op;
+    }
+}
+
+LzEncoder::LzEncoder(std::string_view dictionary) : blockBase(1) {
+    // Offsets are relative to the end of the dictionary, so only its tail can be reached
+    if (dictionary.size() > MAX_DICTIONARY) dictionary.remove_prefix(dictionary.size() - MAX_DICTIONARY);
+    dict = dictionary;
+    blockTable.assign(size_t(1) << BLOCK_HASH_BITS, 0);
+    if (dict.size() < MIN_MATCH) return;
+    // Later positions overwrite earlier ones, which keeps the nearest occurrence
+    dictTable.assign(size_t(1) << DICT_HASH_BITS, 0);
+    for (size_t i = 0; i + MIN_MATCH <= dict.size(); ++i) {
+        dictTable[hash4(dict.data() + i, DICT_HASH_BITS)] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+// Greedy parse: at every position the candidates are the last block position and
+// the nearest dictionary position with the same 4-byte hash; the longer match wins.
+// Runs of literals are skipped over faster the longer they get, so incompressible
+// input (random passwords) costs little.
+void LzEncoder::compress(const char* in, size_t len, std::string& out) {
+    const size_t start = out.size();
+    out.resize(start + len + len / 255 + 16); // Bound for a block with no matches
+    char* const base = &out[start];
+    char* op = base;
+    const char* anchor = in;
+    const char* const end = in + len;
+
+    if (len >= MIN_MATCH) {
+        // Entries below blockBase belong to earlier blocks, so the table needs no clearing
+        if (len >= UINT32_MAX - blockBase) {
+            std::fill(blockTable.begin(), blockTable.end(), 0);
+            blockBase = 1;
+        }
+        const uint32_t windowBase = blockBase; // Table value of this block's first byte
+        blockBase += static_cast<uint32_t>(len);
+        const char* const lastMatch = end - MIN_MATCH; // Last position with 4 readable bytes
+        const char* p = in;
+        while (p <= lastMatch) {
+            const size_t pos = static_cast<size_t>(p - in);
+            const uint32_t word = read32(p);
+            const uint32_t h = word * 2654435761u;
+            size_t best = 0, offset = 0;
+            uint32_t& slot = blockTable[h >> (32 - BLOCK_HASH_BITS)];
+            if (slot >= windowBase && pos - (slot - windowBase) <= MAX_OFFSET && read32(in + (slot - windowBase)) == word) {
+                best = matchLength(in + (slot - windowBase), p, static_cast<size_t>(end - p));
+                offset = pos - (slot - windowBase);
+            }
+            slot = windowBase + static_cast<uint32_t>(pos);
+            if (!dictTable.empty()) {
+                const uint32_t d = dictTable[h >> (32 - DICT_HASH_BITS)];
+                const size_t distance = d != 0 ? pos + dict.size() - (d - 1) : MAX_OFFSET + 1;
+                if (distance <= MAX_OFFSET && read32(dict.data() + d - 1) == word) {
+                    const size_t n = matchLength(dict.data() + d - 1, p,
+                                                 std::min(static_cast<size_t>(end - p), dict.size() - (d - 1)));
+                    if (n > best) {
+                        best = n;
+                        offset = distance;
+                    }
+                }
+            }
+            if (best < MIN_MATCH) {
+                p += 1 + (static_cast<size_t>(p - anchor) >> 6);
+                continue;
+            }
+            op = writeSequence(op, anchor, static_cast<size_t>(p - anchor), offset, best);
+            p += best;
+            anchor = p;
+            // Index a position inside the match too, so a repeat right after it is found
+            if (p - 2 <= lastMatch) blockTable[hash4(p - 2, BLOCK_HASH_BITS)] = windowBase + static_cast<uint32_t>(p - 2 - in);
+        }
+    }
+    op = writeSequence(op, anchor, static_cast<size_t>(end - anchor), 0, 0);
+    out.resize(start + static_cast<size_t>(op - base));
+}
+
+bool lzDecompress(const char* in, size_t len, char* out, size_t outLen, std::string_view dictionary) {
+    const unsigned char* ip = reinterpret_cast<const unsigned char*>(in);
+    const unsigned char* const iend = ip + len;
+    char* op = out;
+    char* const oend = out + outLen;
+    for (;;) {
+        if (ip == iend) return false;
+        const unsigned token = *ip++;
+        size_t litLen = token >> 4;
+        if (litLen == 15 && !readLength(ip, iend, outLen, litLen)) return false;
+        if (litLen > static_cast<size_t>(iend - ip) || litLen > static_cast<size_t>(oend - op)) return false;
+        // Short runs (most of them) are copied with one fixed-size move where there is room
+        if (litLen <= 16 && iend - ip >= 16 && oend - op >= 16) copy16(op, ip);
+        else std::memcpy(op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+        if (ip == iend) return op == oend; // Only the last sequence ends after its literals
+
+        if (iend - ip < 2) return false;
+        const size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        size_t matchLen = token & 15;
+        if (matchLen == 15 && !readLength(ip, iend, outLen, matchLen)) return false;
+        matchLen += MIN_MATCH;
+        const size_t produced = static_cast<size_t>(op - out);
+        if (matchLen > static_cast<size_t>(oend - op) || offset == 0 || offset > produced + dictionary.size()) {
+            return false;
+        }
+
+        // A match that starts in the dictionary continues at the start of the block
+        if (offset > produced) {
+            const size_t back = offset - produced;
+            const size_t fromDict = std::min(back, matchLen);
+            std::memcpy(op, dictionary.data() + dictionary.size() - back, fromDict);
+            op += fromDict;
+            matchLen -= fromDict;
+            if (matchLen == 0) continue;
+        }
+        const char* match = op - offset;
+        if (offset >= 16 && matchLen <= 16 && oend - op >= 16) {
+            copy16(op, match);
+            op += matchLen;
+        } else if (offset >= matchLen) {
+            std::memcpy(op, match, matchLen);
+            op += matchLen;
+        } else {
+            // Overlapping copy repeats the last `offset` bytes
+            for (size_t i = 0; i < matchLen; ++i) op[i] = match[i];
+            op += matchLen;
+        }
+    }
+}
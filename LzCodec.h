@@ -0,0 +1,38 @@
+#ifndef LZCODEC_H
+#define LZCODEC_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Small LZ77 block codec for vault blocks, in the LZ4 sequence format: a token
+// byte (literal count, match length - 4), extra length bytes of 255 for long runs,
+// the literals, then a 2-byte little-endian match offset. The last sequence has
+// literals only. Offsets may reach back past the start of a block into a shared
+// dictionary that both sides pass in, so blocks stay independently decodable while
+// still finding strings (site suffixes, usernames) that recur across the vault.
+class LzEncoder {
+public:
+    static const size_t MAX_OFFSET = 65535;
+    static const size_t MAX_DICTIONARY = 32 * 1024;
+
+    // The dictionary is hashed once here and must outlive the encoder
+    explicit LzEncoder(std::string_view dictionary = std::string_view());
+
+    // Appends the compressed form of in[0, len) to out
+    void compress(const char* in, size_t len, std::string& out);
+
+private:
+    std::string_view dict;
+    std::vector<uint32_t> dictTable;  // Hash of 4 bytes -> dictionary position + 1 (0 = none)
+    std::vector<uint32_t> blockTable; // Hash of 4 bytes -> blockBase + position in its block
+    uint32_t blockBase;               // Above every entry of earlier blocks
+};
+
+// Decodes in[0, len) into exactly outLen bytes at out, using the same dictionary as
+// the encoder. False if the input is malformed or does not produce exactly outLen bytes.
+bool lzDecompress(const char* in, size_t len, char* out, size_t outLen, std::string_view dictionary);
+
+#endif
@@ -0,0 +1,57 @@
+#include "SecondaryIndex.h"
+#include <algorithm>
+#include <cstring>
+
+SecondaryIndex::SecondaryIndex() : lists(&keyPool) {}
+
+// New ids go to the front of their key's list
+void SecondaryIndex::add(std::string_view key, uint32_t id) {
+    if (id >= links.size()) links.resize(std::max<size_t>(id + 1, links.size() * 2));
+    auto it = lists.find(key);
+    if (it == lists.end()) {
+        char* copy = static_cast<char*>(keyPool.allocate(key.size() + 1, 1));
+        std::memcpy(copy, key.data(), key.size());
+        it = lists.emplace(std::string_view(copy, key.size()), List{END, 0}).first;
+    }
+    List& list = it->second;
+    links[id] = Link{list.head, END};
+    if (list.head != END) links[list.head].prev = id;
+    list.head = id;
+    list.count++;
+}
+
+// A key whose last id goes is dropped, and its bytes go back to the pool
+void SecondaryIndex::remove(std::string_view key, uint32_t id) {
+    auto it = lists.find(key);
+    if (it == lists.end()) return;
+    List& list = it->second;
+    const Link link = links[id];
+    if (link.prev != END) links[link.prev].next = link.next;
+    else list.head = link.next;
+    if (link.next != END) links[link.next].prev = link.prev;
+    if (--list.count == 0) {
+        const std::string_view stored = it->first;
+        lists.erase(it);
+        keyPool.deallocate(const_cast<char*>(stored.data()), stored.size() + 1, 1);
+    }
+}
+
+uint32_t SecondaryIndex::first(std::string_view key, size_t* count) const {
+    auto it = lists.find(key);
+    if (count != nullptr) *count = it == lists.end() ? 0 : it->second.count;
+    return it == lists.end() ? END : it->second.head;
+}
+
+void SecondaryIndex::reserve(size_t keys, size_t ids) {
+    lists.reserve(keys);
+    if (ids > links.size()) links.resize(ids);
+}
+
+// The pool keeps the memory for the keys that come next
+void SecondaryIndex::clear() {
+    for (const auto& entry : lists) {
+        keyPool.deallocate(const_cast<char*>(entry.first.data()), entry.first.size() + 1, 1);
+    }
+    lists.clear();
+    links.clear();
+}
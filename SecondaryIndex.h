@@ -0,0 +1,53 @@
+#ifndef SECONDARYINDEX_H
+#define SECONDARYINDEX_H
+
+#include <vector>
+#include <string_view>
+#include <memory_resource>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// Maps a key (a site, or a username) to the ids of every table node stored under it.
+// The ids of one key form a doubly linked list threaded through a per-id link
+// array, like the table's node free list: adding and removing an entry are O(1)
+// with no allocation once the key exists, and nothing moves when the table
+// resizes, because node ids stay put. The index keeps its own copy of every key,
+// so it never points into a node that may be freed or copied.
+class SecondaryIndex {
+public:
+    static constexpr uint32_t END = 0xFFFFFFFFu; // No node: end of a list
+
+    SecondaryIndex();
+    SecondaryIndex(const SecondaryIndex&) = delete;
+    SecondaryIndex& operator=(const SecondaryIndex&) = delete;
+
+    void add(std::string_view key, uint32_t id);
+    // id must have been added under key
+    void remove(std::string_view key, uint32_t id);
+    // First id stored under key (END if none); *count receives the number of ids
+    uint32_t first(std::string_view key, size_t* count = nullptr) const;
+    // The id after id in its key's list (END at the end)
+    uint32_t next(uint32_t id) const { return links[id].next; }
+
+    // Presizes for `keys` distinct keys and node ids below `ids`
+    void reserve(size_t keys, size_t ids);
+    void clear();
+    size_t keyCount() const { return lists.size(); }
+
+private:
+    struct List {
+        uint32_t head;
+        uint32_t count;
+    };
+    struct Link {
+        uint32_t next;
+        uint32_t prev;
+    };
+
+    std::pmr::unsynchronized_pool_resource keyPool; // Key bytes and map nodes; reused once a key goes
+    std::pmr::unordered_map<std::string_view, List> lists;
+    std::vector<Link> links; // By node id
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "StreamCipher.h"
+#include <cstring>
+#include <atomic>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define XOR_X86 1
+#include <immintrin.h>
+#else
+#define XOR_X86 0
+#endif
+
+// Every kernel walks the stream with an index k into the repeated key pattern. k
+// stays below the period, which is a multiple of the key size and at least 64, so
+// the window pattern[k, k + 64) always holds the next 64 keystream bytes and k only
+// ever needs one subtraction to wrap. The kernels are compiled with per-function
+// target attributes and selected at run time.
+
+namespace {
+    const size_t MIN_PERIOD = 64;
+    const size_t WINDOW = 64; // Keystream bytes readable past any k < period
+
+    // Tail of fewer than WINDOW bytes, one at a time
+    inline void xorBytes(const char* in, char* out, size_t len, const char* pattern, size_t k) {
+        for (size_t i = 0; i < len; ++i) out[i] = static_cast<char>(in[i] ^ pattern[k + i]);
+    }
+
+    void xorScalar(const char* in, char* out, size_t len, const char* pattern, size_t period, size_t k) {
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t a, b;
+            std::memcpy(&a, in + i, 8);
+            std::memcpy(&b, pattern + k, 8);
+            a ^= b;
+            std::memcpy(out + i, &a, 8);
+            k += 8;
+            if (k >= period) k -= period;
+        }
+        xorBytes(in + i, out + i, len - i, pattern, k);
+    }
+
+#if XOR_X86
+    __attribute__((target("sse2")))
+    void xorSse2(const char* in, char* out, size_t len, const char* pattern, size_t period, size_t k) {
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 16));
+            a = _mm_xor_si128(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + k)));
+            b = _mm_xor_si128(b, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + k + 16)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), a);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 16), b);
+            k += 32;
+            if (k >= period) k -= period;
+        }
+        xorScalar(in + i, out + i, len - i, pattern, period, k);
+    }
+
+    __attribute__((target("avx2")))
+    void xorAvx2(const char* in, char* out, size_t len, const char* pattern, size_t period, size_t k) {
+        size_t i = 0;
+        for (; i + 64 <= len; i += 64) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 32));
+            a = _mm256_xor_si256(a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern + k)));
+            b = _mm256_xor_si256(b, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern + k + 32)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), a);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 32), b);
+            k += 64;
+            if (k >= period) k -= period;
+        }
+        xorScalar(in + i, out + i, len - i, pattern, period, k);
+    }
+#endif
+
+    bool cpuHasSse2() {
+#if XOR_X86
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+#else
+        return false;
+#endif
+    }
+
+    bool cpuHasAvx2() {
+#if XOR_X86
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    // -1 until the first cipher call picks the best kernel this CPU supports
+    std::atomic<int> activeKernel(-1);
+
+    XorKernel currentKernel() {
+        int k = activeKernel.load(std::memory_order_relaxed);
+        if (k < 0) {
+            k = cpuHasAvx2() ? XOR_KERNEL_AVX2 : cpuHasSse2() ? XOR_KERNEL_SSE2 : XOR_KERNEL_SCALAR;
+            activeKernel.store(k, std::memory_order_relaxed);
+        }
+        return static_cast<XorKernel>(k);
+    }
+}
+
+RepeatingKeyXor::RepeatingKeyXor(std::string_view key) : period(0) {
+    if (key.empty()) return;
+    period = (MIN_PERIOD + key.size() - 1) / key.size() * key.size();
+    pattern.reserve(period + WINDOW + key.size());
+    while (pattern.size() < period + WINDOW) pattern.append(key.data(), key.size());
+}
+
+void RepeatingKeyXor::apply(const char* in, char* out, size_t len, uint64_t position) const {
+    if (period == 0) {
+        if (in != out) std::memcpy(out, in, len);
+        return;
+    }
+    const size_t k = static_cast<size_t>(position % period);
+    switch (currentKernel()) {
+#if XOR_X86
+    case XOR_KERNEL_AVX2: xorAvx2(in, out, len, pattern.data(), period, k); return;
+    case XOR_KERNEL_SSE2: xorSse2(in, out, len, pattern.data(), period, k); return;
+#endif
+    default: xorScalar(in, out, len, pattern.data(), period, k); return;
+    }
+}
+
+bool xor_kernel_supported(XorKernel kernel) {
+    switch (kernel) {
+    case XOR_KERNEL_SCALAR: return true;
+    case XOR_KERNEL_SSE2: return cpuHasSse2();
+    case XOR_KERNEL_AVX2: return cpuHasAvx2();
+    }
+    return false;
+}
+
+XorKernel xor_active_kernel() {
+    return currentKernel();
+}
+
+const char* xor_kernel_name(XorKernel kernel) {
+    switch (kernel) {
+    case XOR_KERNEL_SCALAR: return "scalar";
+    case XOR_KERNEL_SSE2: return "sse2";
+    case XOR_KERNEL_AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+bool xor_use_kernel(XorKernel kernel) {
+    if (!xor_kernel_supported(kernel)) return false;
+    activeKernel.store(kernel, std::memory_order_relaxed);
+    return true;
+}
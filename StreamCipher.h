@@ -0,0 +1,54 @@
+#ifndef STREAMCIPHER_H
+#define STREAMCIPHER_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Cipher stage of the vault pipeline. A stream cipher combines data with a keystream
+// addressed by stream position, so chunks can be processed independently, in any
+// order and on any thread, and encrypting and decrypting are the same call. Vault
+// files, chunk tables, layouts and journals only talk to this interface, so a
+// stronger keystream (e.g. a block cipher in counter mode) can replace the XOR one
+// without touching the pipeline.
+class StreamCipher {
+public:
+    virtual ~StreamCipher() {}
+
+    // Writes len bytes of in combined with the keystream from stream position
+    // `position` on to out. out may equal in (in place) but must not otherwise overlap it.
+    virtual void apply(const char* in, char* out, size_t len, uint64_t position) const = 0;
+    void apply(char* data, size_t len, uint64_t position) const { apply(data, data, len, position); }
+};
+
+// The vault format's cipher: the key repeated over the stream (keystream byte i is
+// key[i % key size]). An empty key leaves data unchanged. The key is laid out once,
+// repeated, so the kernels load 8, 16 or 32 keystream bytes at a time with no
+// division per byte.
+class RepeatingKeyXor : public StreamCipher {
+public:
+    explicit RepeatingKeyXor(std::string_view key);
+
+    void apply(const char* in, char* out, size_t len, uint64_t position) const override;
+    using StreamCipher::apply;
+
+private:
+    std::string pattern; // Key repeated over period + 64 bytes
+    size_t period;       // Multiple of the key size, at least 64 (0 for an empty key)
+};
+
+// XOR kernels, picked at first use from CPUID:
+//   XOR_KERNEL_AVX2    32 bytes per step
+//   XOR_KERNEL_SSE2    16 bytes per step
+//   XOR_KERNEL_SCALAR  portable C++, 8 bytes per step
+enum XorKernel { XOR_KERNEL_SCALAR, XOR_KERNEL_SSE2, XOR_KERNEL_AVX2 };
+
+bool xor_kernel_supported(XorKernel kernel);
+XorKernel xor_active_kernel();
+const char* xor_kernel_name(XorKernel kernel);
+// Forces a kernel (for tests and benchmarks); false if this CPU lacks it.
+// Not synchronised with ciphers running on other threads.
+bool xor_use_kernel(XorKernel kernel);
+
+#endif
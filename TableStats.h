@@ -0,0 +1,113 @@
+#ifndef TABLESTATS_H
+#define TABLESTATS_H
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Instrumentation switch. Build with -DHASHTABLE_STATS=1 to make every table count
+// its lookups, probes, resizes and the time save() and load() spend per phase.
+// With the default of 0 the counters, and every statement that updates them, are
+// compiled out: the hot paths are exactly those of an uninstrumented build.
+#ifndef HASHTABLE_STATS
+#define HASHTABLE_STATS 0
+#endif
+
+#if HASHTABLE_STATS
+#define TABLE_STAT(...) __VA_ARGS__
+#else
+#define TABLE_STAT(...)
+#endif
+
+// Seconds one save() or load() spent per phase, summed over runs (and, for a
+// parallel load, over worker threads, so they can add up to more than wall time)
+struct PhaseTimes {
+    uint64_t runs = 0;
+    double serialize = 0; // save: ordering and encoding records, building the layout
+    double compress = 0;  // save: dictionary and LZ compression; load: expansion
+    double cipher = 0;
+    double mac = 0;
+    double io = 0;        // save: writes, fsync and rename; load: opening and mapping the file
+    double parse = 0;     // load: decoding records, building nodes and the index
+};
+
+// What BasicHashTable::stats() reports. The shape of the index is measured on
+// every call; the counters stay zero unless countersEnabled.
+struct TableStats {
+    // Index shape
+    int size = 0;
+    int capacity = 0;
+    double loadFactor = 0;
+    bool resizing = false;             // An incremental resize is in progress
+    std::vector<int> probeLengths;     // [k] = entries stored k groups past their home group
+    int maxProbeLength = 0;            // Longest probe, in groups
+
+    // Counters (HASHTABLE_STATS builds only)
+    bool countersEnabled = HASHTABLE_STATS != 0;
+    uint64_t lookups = 0;              // Key lookups by insert, search, update and remove (hits + misses)
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t groupsProbed = 0;         // Slot groups visited by those lookups
+    uint64_t rehashes = 0;             // Resizes started
+    double rehashSeconds = 0;          // Time spent allocating and migrating indexes
+    PhaseTimes save;
+    PhaseTimes load;
+
+    double probesPerLookup() const { return lookups != 0 ? static_cast<double>(groupsProbed) / lookups : 0; }
+};
+
+#if HASHTABLE_STATS
+// Live counters of one table. Relaxed atomics: lookups under a shared lock
+// (ConcurrentHashTable) and background saves update them from several threads.
+struct PhaseCounters {
+    std::atomic<uint64_t> runs{0}, serialize{0}, compress{0}, cipher{0}, mac{0}, io{0}, parse{0}; // Nanoseconds
+
+    void add(std::atomic<uint64_t>& phase, uint64_t nanos) { phase.fetch_add(nanos, std::memory_order_relaxed); }
+    void read(PhaseTimes& out) const {
+        out.runs = runs.load(std::memory_order_relaxed);
+        out.serialize = serialize.load(std::memory_order_relaxed) / 1e9;
+        out.compress = compress.load(std::memory_order_relaxed) / 1e9;
+        out.cipher = cipher.load(std::memory_order_relaxed) / 1e9;
+        out.mac = mac.load(std::memory_order_relaxed) / 1e9;
+        out.io = io.load(std::memory_order_relaxed) / 1e9;
+        out.parse = parse.load(std::memory_order_relaxed) / 1e9;
+    }
+    void reset() {
+        for (std::atomic<uint64_t>* c : {&runs, &serialize, &compress, &cipher, &mac, &io, &parse}) c->store(0);
+    }
+};
+
+struct TableCounters {
+    std::atomic<uint64_t> hits{0}, misses{0}, groupsProbed{0}, rehashes{0}, rehashNanos{0};
+    PhaseCounters save, load;
+
+    static void bump(std::atomic<uint64_t>& c, uint64_t n = 1) { c.fetch_add(n, std::memory_order_relaxed); }
+    static uint64_t nanosSince(std::chrono::steady_clock::time_point t0) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count());
+    }
+};
+
+// Splits a stretch of work into phases: each lap() charges the time since the
+// previous lap (or construction) to one phase. One clock read per boundary.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(PhaseCounters* counters = nullptr) : counters(counters), last(std::chrono::steady_clock::now()) {}
+
+    void lap(std::atomic<uint64_t> PhaseCounters::*phase) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (counters != nullptr) {
+            counters->add(counters->*phase,
+                          static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count()));
+        }
+        last = now;
+    }
+
+private:
+    PhaseCounters* counters; // Null: time nothing
+    std::chrono::steady_clock::time_point last;
+};
+#endif
+
+#endif
@@ -0,0 +1,190 @@
+#include "VaultIO.h"
+#include <fstream>
+#if defined(__unix__) || defined(__APPLE__)
+#define VAULTIO_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define VAULTIO_MMAP 0
+#endif
+#include <cerrno>
+
+MappedFile::MappedFile() : bytes(nullptr), length(0), mapped(false) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& filename, Access access) {
+    close();
+#if VAULTIO_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length == 0) {
+        ::close(fd); // Nothing to map; data() stays null
+        return true;
+    }
+    void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps its own reference to the file
+    if (p == MAP_FAILED) {
+        length = 0;
+        return false;
+    }
+    ::madvise(p, length, access == RANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+    bytes = static_cast<const char*>(p);
+    mapped = true;
+    return true;
+#else
+    (void)access;
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return false;
+    std::streamsize size = in.tellg();
+    in.seekg(0, std::ios::beg);
+    fallback.resize(static_cast<size_t>(size));
+    if (size > 0 && !in.read(&fallback[0], size)) {
+        fallback.clear();
+        return false;
+    }
+    bytes = fallback.data();
+    length = fallback.size();
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#if VAULTIO_MMAP
+    if (mapped) ::munmap(const_cast<char*>(bytes), length);
+#endif
+    fallback.clear();
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+AppendFile::AppendFile() : length(0), fd(-1), file(nullptr) {}
+
+AppendFile::~AppendFile() {
+    close();
+}
+
+bool AppendFile::open(const std::string& filename, bool truncate) {
+    close();
+    name = filename;
+#if VAULTIO_MMAP
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0600);
+    if (fd < 0) return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(st.st_size);
+    return true;
+#else
+    file = std::fopen(filename.c_str(), truncate ? "wb" : "ab");
+    if (file == nullptr) return false;
+    std::fseek(file, 0, SEEK_END);
+    length = static_cast<size_t>(std::ftell(file));
+    return true;
+#endif
+}
+
+bool AppendFile::append(const char* data, size_t len) {
+#if VAULTIO_MMAP
+    if (fd < 0) return false;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::write(fd, data + done, len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            length += done;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+#else
+    if (file == nullptr) return false;
+    if (std::fwrite(data, 1, len, file) != len || std::fflush(file) != 0) return false;
+#endif
+    length += len;
+    return true;
+}
+
+bool AppendFile::sync() {
+#if VAULTIO_MMAP
+    return fd >= 0 && ::fsync(fd) == 0;
+#else
+    return file != nullptr && std::fflush(file) == 0;
+#endif
+}
+
+bool AppendFile::truncate(size_t len) {
+    if (len > length) return false;
+#if VAULTIO_MMAP
+    if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(len)) != 0) return false;
+#else
+    // No portable truncate: keep the prefix and write it back
+    if (file == nullptr) return false;
+    std::fclose(file);
+    file = nullptr;
+    std::string prefix(len, '\0');
+    std::ifstream in(name, std::ios::binary);
+    if (len > 0 && !in.read(&prefix[0], static_cast<std::streamsize>(len))) return false;
+    in.close();
+    file = std::fopen(name.c_str(), "wb");
+    if (file == nullptr) return false;
+    if (std::fwrite(prefix.data(), 1, len, file) != len || std::fflush(file) != 0) return false;
+#endif
+    length = len;
+    return true;
+}
+
+void AppendFile::close() {
+#if VAULTIO_MMAP
+    if (fd >= 0) ::close(fd);
+#endif
+    if (file != nullptr) std::fclose(file);
+    fd = -1;
+    file = nullptr;
+    length = 0;
+}
+
+bool AppendFile::isOpen() const {
+    return fd >= 0 || file != nullptr;
+}
+
+bool syncFile(const std::string& filename) {
+#if VAULTIO_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    (void)filename;
+    return true;
+#endif
+}
+
+bool syncParentDirectory(const std::string& filename) {
+#if VAULTIO_MMAP
+    size_t slash = filename.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : filename.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    (void)filename;
+    return true;
+#endif
+}
@@ -0,0 +1,71 @@
+#ifndef VAULTIO_H
+#define VAULTIO_H
+
+#include <string>
+#include <cstddef>
+#include <cstdio>
+
+// Read-only view of a whole file. On POSIX systems the file is memory-mapped,
+// so reading it costs no copy; elsewhere it is read into an owned buffer.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // How the caller will read the mapping, passed to the kernel as a readahead hint
+    enum Access {
+        SEQUENTIAL, // Front to back, once (full loads, log replay): aggressive readahead
+        RANDOM      // Scattered small reads (indexed lookups): no readahead
+    };
+
+    // Maps filename; false if it cannot be opened or mapped
+    bool open(const std::string& filename, Access access = SEQUENTIAL);
+    void close();
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes;
+    size_t length;
+    bool mapped;          // bytes came from mmap (else they point into fallback)
+    std::string fallback; // Owned copy when mapping is not available
+};
+
+// Append-only file for write-ahead logs. Each append() hands a whole record to the
+// OS before returning, so a process crash leaves the file holding complete records
+// followed by at most one torn one.
+class AppendFile {
+public:
+    AppendFile();
+    ~AppendFile();
+    AppendFile(const AppendFile&) = delete;
+    AppendFile& operator=(const AppendFile&) = delete;
+
+    // Opens filename for appending, creating it if missing; truncate = start empty
+    bool open(const std::string& filename, bool truncate = false);
+    bool append(const char* data, size_t len);
+    // Flushes everything appended so far to the disk (fsync)
+    bool sync();
+    // Cuts the file back to its first len bytes (e.g. to drop a torn record)
+    bool truncate(size_t len);
+    void close();
+
+    bool isOpen() const;
+    size_t size() const { return length; }
+
+private:
+    std::string name;
+    size_t length;
+    int fd;     // POSIX descriptor
+    FILE* file; // stdio stream where POSIX calls are not available
+};
+
+// Durability: flush a file's data, or the directory entry a rename just changed,
+// to the disk. Without POSIX fsync these do nothing and return true.
+bool syncFile(const std::string& filename);
+bool syncParentDirectory(const std::string& filename);
+
+#endif
@@ -0,0 +1,469 @@
+#include "VaultServer.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define VAULTSERVER_SOCKETS 1
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#else
+#define VAULTSERVER_SOCKETS 0
+#endif
+
+#if defined(__linux__)
+#define VAULTSERVER_EPOLL 1
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#define VAULTSERVER_EPOLL 0
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#include <cstring>
+
+namespace {
+    const size_t MAX_FIELDS = 3;
+    const size_t MAX_FIELD = 0xFFFF;                           // Largest size a u16 field length holds
+    const size_t MAX_FRAME = 1 + MAX_FIELDS * (2 + MAX_FIELD); // Longest valid frame body
+    const size_t READ_SIZE = 64 * 1024;                     // Bytes per read() call
+    const size_t OUTPUT_LIMIT = 1 << 20;                    // Pending answers before reading pauses
+
+    uint32_t getU32(const char* p) {
+        const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+        return b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    }
+
+    uint16_t getU16(const char* p) {
+        const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+        return static_cast<uint16_t>(b[0] | (b[1] << 8));
+    }
+
+    void putU32(char* p, uint32_t v) {
+        for (int i = 0; i < 4; ++i) p[i] = static_cast<char>(v >> (8 * i));
+    }
+
+    // field must fit its u16 size (callers check against MAX_FIELD)
+    void appendField(std::string& out, std::string_view field) {
+        out += static_cast<char>(field.size() & 0xFF);
+        out += static_cast<char>(field.size() >> 8);
+        out.append(field.data(), field.size());
+    }
+
+    // Starts a frame whose length is filled in by endFrame(); returns its offset
+    size_t beginFrame(std::string& out, uint8_t head) {
+        const size_t start = out.size();
+        out.append(4, '\0');
+        out += static_cast<char>(head);
+        return start;
+    }
+
+    void endFrame(std::string& out, size_t start) {
+        putU32(&out[start], static_cast<uint32_t>(out.size() - start - 4));
+    }
+
+    // Splits a frame body after its head byte into fields; false unless the fields
+    // cover it exactly
+    bool parseFields(const char* p, size_t size, std::string_view* fields, size_t& count) {
+        count = 0;
+        size_t pos = 1;
+        while (pos < size) {
+            if (count == MAX_FIELDS || size - pos < 2) return false;
+            const size_t len = getU16(p + pos);
+            pos += 2;
+            if (size - pos < len) return false;
+            fields[count++] = std::string_view(p + pos, len);
+            pos += len;
+        }
+        return true;
+    }
+
+#if VAULTSERVER_SOCKETS
+    bool socketAddress(const std::string& path, sockaddr_un& addr) {
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+#endif
+}
+
+struct VaultServer::Connection {
+    int fd;
+    std::string in;         // Received bytes not yet answered (a partial frame, or frames held back)
+    std::string out;        // Answers not yet written
+    size_t outPos = 0;      // Bytes of out already written
+    uint32_t events = 0;    // Current epoll interest
+    bool eof = false;       // The client closed its side
+    bool closing = false;   // Close once out is written (bad request)
+    bool unsynced = false;  // out answers a change that is not on disk yet: hold it
+
+    explicit Connection(int fd) : fd(fd) {}
+    size_t pending() const { return out.size() - outPos; }
+};
+
+// The eventfd lives as long as the server, so stop() never writes to a descriptor
+// that closeAll() on the run() thread has closed and the process may have reused
+VaultServer::VaultServer(HashTable& table)
+    : table(table), listenFd(-1), epollFd(-1), wakeFd(-1), served(0) {
+#if VAULTSERVER_EPOLL
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+}
+
+VaultServer::~VaultServer() {
+    closeAll();
+#if VAULTSERVER_SOCKETS
+    if (wakeFd >= 0) ::close(wakeFd);
+#endif
+}
+
+#if VAULTSERVER_EPOLL
+bool VaultServer::listen(const std::string& socketPath) {
+    sockaddr_un addr;
+    if (listenFd >= 0 || !socketAddress(socketPath, addr)) return false;
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (epollFd < 0 || wakeFd < 0 || listenFd < 0) {
+        closeAll();
+        return false;
+    }
+    // A socket file left by a server that died is in the way of bind()
+    ::unlink(socketPath.c_str());
+    // Create the file without group or other access: the mode is the access control
+    const mode_t oldMask = ::umask(0177);
+    const bool bound = ::bind(listenFd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    ::umask(oldMask);
+    if (!bound || ::listen(listenFd, SOMAXCONN) != 0) {
+        closeAll();
+        return false;
+    }
+    path = socketPath;
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    readBuffer.resize(READ_SIZE);
+    return true;
+}
+
+// Level-triggered: a connection that still has unread bytes is reported again by
+// the next epoll_wait(), so one read per event keeps every client served fairly
+bool VaultServer::run() {
+    if (listenFd < 0) return false;
+    epoll_event events[64];
+    while (true) {
+        const int n = epoll_wait(epollFd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            closeAll();
+            return false;
+        }
+        bool stopping = false;
+        for (int i = 0; i < n; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                uint64_t count;
+                (void)!::read(wakeFd, &count, sizeof(count)); // Reset, for a later run()
+                stopping = true;
+            } else if (fd == listenFd) {
+                accept();
+            } else if (static_cast<size_t>(fd) < connections.size() && connections[fd]) {
+                Connection& c = *connections[fd];
+                bool ok = true;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ok = readFrom(c);
+                if (ok && (events[i].events & EPOLLOUT)) ok = writeTo(c);
+                if (!ok) closeConnection(fd);
+            }
+        }
+        // Answers after which nothing was read still need their changes synced
+        while (!unsynced.empty()) syncChanges();
+        if (stopping) {
+            closeAll();
+            return true;
+        }
+    }
+}
+
+void VaultServer::stop() {
+    const uint64_t one = 1;
+    if (wakeFd >= 0) (void)!::write(wakeFd, &one, sizeof(one));
+}
+
+void VaultServer::accept() {
+    while (true) {
+        const int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return; // EAGAIN: no more waiting (or an error the next event retries)
+        if (static_cast<size_t>(fd) >= connections.size()) connections.resize(fd + 1);
+        connections[fd].reset(new Connection(fd));
+        watch(*connections[fd]);
+    }
+}
+
+// Reads what the socket holds (one call) and answers every complete frame. The
+// common case of a buffer holding whole frames is answered in place; only a
+// trailing partial frame is copied into the connection.
+bool VaultServer::readFrom(Connection& c) {
+    if (c.pending() >= OUTPUT_LIMIT || c.closing) return true;
+    ssize_t r;
+    do {
+        r = ::read(c.fd, readBuffer.data(), readBuffer.size());
+    } while (r < 0 && errno == EINTR);
+    if (r < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+    if (r == 0) {
+        c.eof = true;
+    } else if (c.in.empty()) {
+        const size_t used = answer(c, readBuffer.data(), static_cast<size_t>(r));
+        c.in.assign(readBuffer.data() + used, static_cast<size_t>(r) - used);
+    } else {
+        c.in.append(readBuffer.data(), static_cast<size_t>(r));
+        c.in.erase(0, answer(c, c.in.data(), c.in.size()));
+    }
+    return c.unsynced || writeTo(c); // Held answers are sent by syncChanges()
+}
+
+// Answers complete frames from data until the output limit; returns the bytes used
+size_t VaultServer::answer(Connection& c, const char* data, size_t size) {
+    size_t pos = 0;
+    while (size - pos >= 4 && c.pending() < OUTPUT_LIMIT && !c.closing) {
+        const uint32_t length = getU32(data + pos);
+        if (length == 0 || length > MAX_FRAME) {
+            endFrame(c.out, beginFrame(c.out, VAULT_BAD_REQUEST));
+            c.closing = true;
+            break;
+        }
+        if (size - pos - 4 < length) break;
+        handle(c, data + pos + 4, length);
+        pos += 4 + length;
+    }
+    return pos;
+}
+
+void VaultServer::handle(Connection& c, const char* frame, size_t size) {
+    std::string_view f[MAX_FIELDS];
+    size_t count;
+    const uint8_t op = static_cast<uint8_t>(frame[0]);
+    const bool wellFormed = parseFields(frame, size, f, count) &&
+                            (((op == VAULT_FIND || op == VAULT_DELETE) && count == 2) ||
+                             ((op == VAULT_ADD || op == VAULT_UPDATE) && count == 3));
+    ++served;
+    if (!wellFormed) {
+        endFrame(c.out, beginFrame(c.out, VAULT_BAD_REQUEST));
+        c.closing = true;
+        return;
+    }
+    if (op == VAULT_FIND) {
+        // Read-only lookup: a find during a background compaction copies no slab
+        const Credential* cred = static_cast<const HashTable&>(table).search(f[0], f[1]);
+        // A credential put in the table by other means may not fit the protocol's fields
+        if (cred != nullptr && (cred->site.size() > MAX_FIELD || cred->username.size() > MAX_FIELD ||
+                                cred->password.size() > MAX_FIELD)) {
+            endFrame(c.out, beginFrame(c.out, VAULT_BAD_REQUEST));
+            return;
+        }
+        const size_t start = beginFrame(c.out, cred != nullptr ? VAULT_OK : VAULT_NOT_FOUND);
+        if (cred != nullptr) {
+            appendField(c.out, cred->site);
+            appendField(c.out, cred->username);
+            appendField(c.out, cred->password);
+        }
+        endFrame(c.out, start);
+        return;
+    }
+    bool ok = true;
+    if (op == VAULT_ADD) {
+        table.emplace(f[0], f[1], f[2]);
+    } else if (op == VAULT_UPDATE) {
+        ok = table.update(f[0], f[1], f[2]);
+    } else {
+        ok = table.remove(f[0], f[1]);
+    }
+    endFrame(c.out, beginFrame(c.out, ok ? VAULT_OK : VAULT_NOT_FOUND));
+    if (ok && table.journaled() && !c.unsynced) {
+        c.unsynced = true;
+        unsynced.push_back(c.fd);
+    }
+}
+
+// One commit covers the changes of every waiting connection; their answers go out
+// once it is on disk. Answering held-back frames may change more, which the
+// caller's next call syncs.
+void VaultServer::syncChanges() {
+    const bool synced = table.commit().get();
+    std::vector<int> waiting;
+    waiting.swap(unsynced);
+    for (int fd : waiting) {
+        if (static_cast<size_t>(fd) >= connections.size() || !connections[fd] || !connections[fd]->unsynced) continue;
+        Connection& c = *connections[fd];
+        c.unsynced = false;
+        if (!synced || !writeTo(c)) closeConnection(fd);
+    }
+}
+
+// Writes pending answers. Once they are all out, frames held back by the output
+// limit are answered and written in turn. False when the connection is done.
+bool VaultServer::writeTo(Connection& c) {
+    while (!c.unsynced) {
+        while (c.pending() > 0) {
+            const ssize_t w = ::send(c.fd, c.out.data() + c.outPos, c.pending(), MSG_NOSIGNAL);
+            if (w > 0) {
+                c.outPos += static_cast<size_t>(w);
+            } else if (w < 0 && errno == EINTR) {
+                continue;
+            } else if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                watch(c);
+                return true;
+            } else {
+                return false;
+            }
+        }
+        c.out.clear();
+        c.outPos = 0;
+        if (c.closing) return false;
+        const size_t used = c.in.empty() ? 0 : answer(c, c.in.data(), c.in.size());
+        if (used == 0 && !c.closing) break;
+        c.in.erase(0, used);
+    }
+    if (c.eof && !c.unsynced) return false; // Everything the client sent is answered
+    watch(c);
+    return true;
+}
+
+// Read while answers can be buffered, write while answers are pending
+void VaultServer::watch(Connection& c) {
+    uint32_t events = 0;
+    if (!c.eof && !c.closing && c.pending() < OUTPUT_LIMIT) events |= EPOLLIN;
+    if (c.pending() > 0 && !c.unsynced) events |= EPOLLOUT;
+    if (events == c.events) return;
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = c.fd;
+    epoll_ctl(epollFd, c.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, c.fd, &ev);
+    c.events = events;
+}
+#else
+bool VaultServer::listen(const std::string&) { return false; }
+bool VaultServer::run() { return false; }
+void VaultServer::stop() {}
+#endif
+
+void VaultServer::closeConnection(int fd) {
+#if VAULTSERVER_SOCKETS
+    ::close(fd);
+#endif
+    connections[fd].reset();
+}
+
+void VaultServer::closeAll() {
+    for (size_t fd = 0; fd < connections.size(); ++fd) {
+        if (connections[fd]) closeConnection(static_cast<int>(fd));
+    }
+    connections.clear();
+#if VAULTSERVER_SOCKETS
+    for (int* fd : {&listenFd, &epollFd}) {
+        if (*fd >= 0) ::close(*fd);
+        *fd = -1;
+    }
+    if (!path.empty()) ::unlink(path.c_str());
+    path.clear();
+#endif
+}
+
+VaultClient::VaultClient() : fd(-1), receivePos(0) {}
+
+VaultClient::~VaultClient() {
+    close();
+}
+
+#if VAULTSERVER_SOCKETS
+bool VaultClient::connect(const std::string& socketPath) {
+    sockaddr_un addr;
+    close();
+    if (!socketAddress(socketPath, addr)) return false;
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void VaultClient::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    sendBuffer.clear();
+    receiveBuffer.clear();
+    receivePos = 0;
+}
+
+bool VaultClient::flush() {
+    size_t sent = 0;
+    while (sent < sendBuffer.size()) {
+        const ssize_t w = ::send(fd, sendBuffer.data() + sent, sendBuffer.size() - sent, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        sent += static_cast<size_t>(w);
+    }
+    sendBuffer.clear();
+    return true;
+}
+
+bool VaultClient::next(Response& out) {
+    if (fd < 0 || (!sendBuffer.empty() && !flush())) return false;
+    // Read until the buffer holds a whole frame
+    while (true) {
+        const size_t available = receiveBuffer.size() - receivePos;
+        if (available >= 4 && available - 4 >= getU32(receiveBuffer.data() + receivePos)) break;
+        if (receivePos > 0) {
+            receiveBuffer.erase(0, receivePos);
+            receivePos = 0;
+        }
+        const size_t have = receiveBuffer.size();
+        receiveBuffer.resize(have + READ_SIZE);
+        ssize_t r;
+        do {
+            r = ::read(fd, &receiveBuffer[have], READ_SIZE);
+        } while (r < 0 && errno == EINTR);
+        receiveBuffer.resize(have + (r > 0 ? static_cast<size_t>(r) : 0));
+        if (r <= 0) return false;
+    }
+    const char* frame = receiveBuffer.data() + receivePos + 4;
+    const uint32_t length = getU32(frame - 4);
+    receivePos += 4 + length;
+    std::string_view f[MAX_FIELDS];
+    size_t count;
+    if (length == 0 || !parseFields(frame, length, f, count) || (count != 0 && count != 3)) return false;
+    out.status = static_cast<VaultStatus>(frame[0]);
+    out.site.assign(f[0].data(), f[0].size());
+    out.username.assign(f[1].data(), f[1].size());
+    out.password.assign(f[2].data(), f[2].size());
+    return true;
+}
+#else
+bool VaultClient::connect(const std::string&) { return false; }
+void VaultClient::close() {}
+bool VaultClient::flush() { return false; }
+bool VaultClient::next(Response&) { return false; }
+#endif
+
+bool VaultClient::queue(VaultOp op, std::string_view site, std::string_view username, std::string_view password) {
+    if (site.size() > MAX_FIELD || username.size() > MAX_FIELD || password.size() > MAX_FIELD) return false;
+    const size_t start = beginFrame(sendBuffer, op);
+    appendField(sendBuffer, site);
+    appendField(sendBuffer, username);
+    if (op == VAULT_ADD || op == VAULT_UPDATE) appendField(sendBuffer, password);
+    endFrame(sendBuffer, start);
+    return true;
+}
+
+bool VaultClient::call(VaultOp op, std::string_view site, std::string_view username, std::string_view password,
+                       Response& out) {
+    return queue(op, site, username, password) && next(out);
+}
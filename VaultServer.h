@@ -0,0 +1,127 @@
+#ifndef VAULTSERVER_H
+#define VAULTSERVER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "HashTable.h"
+
+// Daemon mode: a loaded table served to local clients over a Unix domain socket.
+//
+// Protocol (all integers little-endian). A client sends request frames and may
+// send any number before reading the answers (pipelining); answers come back in
+// request order.
+//   request:  [length u32][op u8][field]...   field = [size u16][bytes]
+//   response: [length u32][status u8][field]...
+// length counts the bytes after itself. Requests and their fields:
+//   VAULT_FIND    site, username (empty = any account of the site)
+//   VAULT_ADD     site, username, password (replaces an existing password)
+//   VAULT_UPDATE  site, username, password
+//   VAULT_DELETE  site, username
+// A found credential comes back as three fields (site, username, password);
+// other answers carry a status only. A frame that cannot be parsed is answered
+// with VAULT_BAD_REQUEST and the connection is closed. A find whose credential has
+// a field over 65535 bytes (stored by other means) is also answered with
+// VAULT_BAD_REQUEST, and the connection stays open.
+enum VaultOp : uint8_t { VAULT_FIND = 1, VAULT_ADD = 2, VAULT_UPDATE = 3, VAULT_DELETE = 4 };
+enum VaultStatus : uint8_t { VAULT_OK = 0, VAULT_NOT_FOUND = 1, VAULT_BAD_REQUEST = 2 };
+
+// Single-threaded epoll event loop over non-blocking sockets (Linux; elsewhere
+// listen() fails). Every readable connection is drained, all complete requests in
+// its buffer are answered into one output buffer and written with one call, so a
+// pipelined batch costs one read and one write. A client that stops reading gets
+// no more requests served until its answers drain.
+//
+// On a journaled table a change is acknowledged only once it is on disk: answers
+// that follow a change are held back, and after each round of events the loop
+// calls commit() once for every connection that changed something (group commit)
+// and waits for it before sending. If the sync fails, those connections are closed
+// unanswered.
+//
+// The table is only touched from the thread in run(), so it needs no locking, but
+// the caller must leave it alone until run() returns. The socket file is created
+// with mode 0600: file permissions are the only access control, and anyone who
+// can connect can read every password.
+class VaultServer {
+public:
+    explicit VaultServer(HashTable& table);
+    ~VaultServer();
+    VaultServer(const VaultServer&) = delete;
+    VaultServer& operator=(const VaultServer&) = delete;
+
+    // Binds and listens on socketPath, replacing a stale socket file there
+    bool listen(const std::string& socketPath);
+    // Serves until stop(); false if the loop failed
+    bool run();
+    // Makes run() return after its current step. Safe from other threads and from
+    // signal handlers (one write to an eventfd).
+    void stop();
+
+    uint64_t requestsServed() const { return served; }
+
+private:
+    struct Connection;
+
+    HashTable& table;
+    std::string path;
+    int listenFd;
+    int epollFd;
+    int wakeFd; // eventfd for stop(); open for the server's whole life
+    uint64_t served;
+    std::vector<std::unique_ptr<Connection>> connections; // By file descriptor
+    std::vector<char> readBuffer;                         // Shared by all connections
+    std::vector<int> unsynced;                            // Connections holding answers to unsynced changes
+
+    void accept();
+    bool readFrom(Connection& c);
+    size_t answer(Connection& c, const char* data, size_t size);
+    void handle(Connection& c, const char* frame, size_t size);
+    bool writeTo(Connection& c);
+    void watch(Connection& c);
+    void syncChanges();
+    void closeConnection(int fd);
+    void closeAll();
+};
+
+// Client side of the protocol over one blocking connection. call() makes one round
+// trip; queue() + flush() + next() pipeline requests. flush() blocks until all is
+// sent, and the server stops reading once about 1 MiB of answers wait for the
+// client, so keep a pipeline to some thousands of requests between next() calls.
+class VaultClient {
+public:
+    struct Response {
+        VaultStatus status;
+        std::string site;
+        std::string username;
+        std::string password;
+    };
+
+    VaultClient();
+    ~VaultClient();
+    VaultClient(const VaultClient&) = delete;
+    VaultClient& operator=(const VaultClient&) = delete;
+
+    bool connect(const std::string& socketPath);
+    void close();
+
+    // Adds a request to the send buffer; false if a field is longer than 65535 bytes
+    bool queue(VaultOp op, std::string_view site, std::string_view username,
+               std::string_view password = std::string_view());
+    // Sends everything queued
+    bool flush();
+    // Reads the answer to the oldest request not yet answered
+    bool next(Response& out);
+
+    bool call(VaultOp op, std::string_view site, std::string_view username, std::string_view password,
+              Response& out);
+
+private:
+    int fd;
+    std::string sendBuffer;
+    std::string receiveBuffer;
+    size_t receivePos;
+};
+
+#endif
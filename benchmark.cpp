@@ -0,0 +1,1648 @@
+// Micro benchmarks for SecurePass.
+// Build: g++ -std=c++17 -O2 -pthread benchmark.cpp HashTable.cpp HashPolicy.cpp ConcurrentHashTable.cpp Credential.cpp sha256.cpp VaultIO.cpp CommitScheduler.cpp LzCodec.cpp StreamCipher.cpp CsvIO.cpp VaultServer.cpp SecondaryIndex.cpp -o bench_runner
+// Usage: ./bench_runner [benchmark name] [entry count] [results file (suite)]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include "HashTable.h"
+#include "ConcurrentHashTable.h"
+#include "Credential.h"
+#include "sha256.h"
+#include "StreamCipher.h"
+#include "CsvIO.h"
+#include "VaultServer.h"
+#if HASH_HAS_OPENSSL
+#include <openssl/evp.h>
+#endif
+
+// Counts every global allocation so benchmarks can report allocator calls
+static std::atomic<size_t> g_allocCalls(0);
+
+// Out of line, so GCC does not pair an inlined malloc with an inlined free and
+// misreport it as a mismatched new/delete
+__attribute__((noinline)) void* operator new(size_t n) {
+    g_allocCalls++;
+    void* p = std::malloc(n != 0 ? n : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// The separate-chaining table SecurePass used before the open-addressing engine.
+// Kept here (minus file I/O) as the baseline for comparisons: one `new` per node and
+// plain std::string fields. Arguments are copied into std::strings like the old
+// by-value API did.
+class LegacyChainedTable {
+    struct Entry {
+        std::string site;
+        std::string username;
+        std::string password;
+    };
+    struct Node {
+        Entry credential;
+        Node* next;
+        Node(const Entry& c) : credential(c), next(nullptr) {}
+    };
+    std::vector<Node*> table;
+    int capacity;
+    int count;
+
+    int hash(std::string key) const {
+        long long hashValue = 0, p = 31, m = 1000000009LL, power = 1;
+        for (char c : key) {
+            hashValue = (hashValue + (c - 'a' + 1) * power) % m;
+            power = (power * p) % m;
+        }
+        return static_cast<int>((hashValue % capacity + capacity) % capacity);
+    }
+    static int nextPrime(int n) {
+        for (;; ++n) {
+            bool prime = n > 1;
+            for (int i = 2; i * i <= n && prime; i++) prime = (n % i != 0);
+            if (prime) return n;
+        }
+    }
+    void rehash(int newCapacity) {
+        std::vector<Node*> old = table;
+        table.assign(newCapacity, nullptr);
+        capacity = newCapacity;
+        count = 0;
+        for (Node* node : old) {
+            while (node != nullptr) {
+                insertEntry(node->credential);
+                Node* temp = node;
+                node = node->next;
+                delete temp;
+            }
+        }
+    }
+    void insertEntry(Entry cred) {
+        int index = hash(cred.site);
+        for (Node* node = table[index]; node != nullptr; node = node->next) {
+            if (node->credential.site == cred.site && node->credential.username == cred.username) {
+                node->credential.password = cred.password;
+                return;
+            }
+        }
+        Node* newNode = new Node(cred);
+        newNode->next = table[index];
+        table[index] = newNode;
+        count++;
+        if (static_cast<float>(count) / capacity > 0.75f) rehash(nextPrime(2 * capacity));
+    }
+
+public:
+    LegacyChainedTable(int cap = 101) : table(cap, nullptr), capacity(cap), count(0) {}
+    ~LegacyChainedTable() {
+        for (Node* node : table) {
+            while (node != nullptr) { Node* next = node->next; delete node; node = next; }
+        }
+    }
+    void insert(const Credential& cred) {
+        insertEntry(Entry{std::string(cred.site), std::string(cred.username), std::string(cred.password)});
+    }
+    const Entry* search(std::string_view siteArg, std::string_view usernameArg) {
+        std::string site(siteArg), username(usernameArg);
+        for (Node* node = table[hash(site)]; node != nullptr; node = node->next) {
+            if (node->credential.site == site && (username.empty() || node->credential.username == username)) {
+                return &node->credential;
+            }
+        }
+        return nullptr;
+    }
+    bool remove(std::string_view siteArg, std::string_view usernameArg) {
+        std::string site(siteArg), username(usernameArg);
+        int index = hash(site);
+        Node* prev = nullptr;
+        for (Node* node = table[index]; node != nullptr; prev = node, node = node->next) {
+            if (node->credential.site == site && node->credential.username == username) {
+                if (prev == nullptr) table[index] = node->next;
+                else prev->next = node->next;
+                delete node;
+                count--;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Synthetic vault: `perSite` accounts per site, realistic string lengths.
+std::vector<Credential> makeCredentials(size_t n, size_t perSite, const std::string& tag = "") {
+    std::vector<Credential> creds;
+    creds.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        creds.emplace_back("site" + std::to_string(i / perSite) + tag + ".example.com",
+                           "user" + std::to_string(i),
+                           "pw-" + std::to_string(i * 2654435761u));
+    }
+    return creds;
+}
+
+// Percentiles of one batch of per-operation latencies, in nanoseconds
+struct LatencySummary {
+    size_t count;
+    uint64_t mean, p50, p99, p999, max;
+};
+
+// Collects per-operation latencies and prints percentiles.
+class LatencyRecorder {
+    std::vector<uint32_t> samples;
+public:
+    explicit LatencyRecorder(size_t n) { samples.reserve(n); }
+    void add(Clock::duration d) {
+        samples.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+    }
+    // Summarizes the samples so far and starts a new batch
+    LatencySummary summarize() {
+        LatencySummary s = {samples.size(), 0, 0, 0, 0, 0};
+        if (samples.empty()) return s;
+        std::sort(samples.begin(), samples.end());
+        uint64_t total = 0;
+        for (uint32_t v : samples) total += v;
+        auto pct = [&](double p) { return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))]; };
+        s.mean = total / samples.size();
+        s.p50 = pct(0.50);
+        s.p99 = pct(0.99);
+        s.p999 = pct(0.999);
+        s.max = samples.back();
+        samples.clear();
+        return s;
+    }
+    void report(const std::string& label) {
+        LatencySummary s = summarize();
+        std::cout << std::left << std::setw(28) << label << std::right
+                  << " mean " << std::setw(7) << s.mean << " ns"
+                  << "  p50 " << std::setw(7) << s.p50 << " ns"
+                  << "  p99 " << std::setw(7) << s.p99 << " ns"
+                  << "  max " << std::setw(9) << s.max << " ns\n";
+    }
+};
+
+// Runs insert / hit / miss / remove passes against one table type.
+template <class Table>
+void runTableLatency(const std::string& name, const std::vector<Credential>& creds,
+                     const std::vector<Credential>& misses, const std::vector<size_t>& order) {
+    Table table(101);
+    LatencyRecorder rec(creds.size());
+
+    for (const Credential& c : creds) {
+        Clock::time_point t0 = Clock::now();
+        table.insert(c);
+        rec.add(Clock::now() - t0);
+    }
+    rec.report(name + " insert");
+
+    size_t found = 0;
+    for (size_t i : order) {
+        Clock::time_point t0 = Clock::now();
+        found += table.search(creds[i].site, creds[i].username) != nullptr;
+        rec.add(Clock::now() - t0);
+    }
+    rec.report(name + " search (hit)");
+
+    for (const Credential& c : misses) {
+        Clock::time_point t0 = Clock::now();
+        found += table.search(c.site, c.username) != nullptr;
+        rec.add(Clock::now() - t0);
+    }
+    rec.report(name + " search (miss)");
+
+    for (size_t i : order) {
+        Clock::time_point t0 = Clock::now();
+        found += table.remove(creds[i].site, creds[i].username);
+        rec.add(Clock::now() - t0);
+    }
+    rec.report(name + " remove");
+
+    if (found != 2 * creds.size()) std::cerr << "  warning: " << name << " lost entries\n";
+}
+
+// Open addressing vs the old separate chaining: per-operation latency percentiles.
+void benchTable(size_t n) {
+    const size_t perSiteCases[] = {1, 4};
+    for (size_t perSite : perSiteCases) {
+        std::vector<Credential> creds = makeCredentials(n, perSite);
+        std::vector<Credential> misses = makeCredentials(n, perSite, "-absent");
+        std::vector<size_t> order(n);
+        for (size_t i = 0; i < n; ++i) order[i] = i;
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+
+        std::cout << "== table latency, " << n << " entries, " << perSite << " account(s) per site ==\n";
+        runTableLatency<LegacyChainedTable>("chained", creds, misses, order);
+        runTableLatency<HashTable>("open-addressing", creds, misses, order);
+    }
+}
+
+double secondsSince(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// Cold-start population: growing insert loop vs reserve + insertBulk vs load()
+void benchBulk(size_t n) {
+    std::vector<Credential> creds = makeCredentials(n, 4);
+    std::cout << "== bulk population, " << n << " entries ==\n";
+    {
+        HashTable table(101);
+        Clock::time_point t0 = Clock::now();
+        for (const Credential& c : creds) table.insert(c);
+        std::cout << "insert loop (growing)        " << secondsSince(t0) * 1000 << " ms\n";
+    }
+    {
+        HashTable table(101);
+        Clock::time_point t0 = Clock::now();
+        table.insertBulk(creds, true);
+        std::cout << "insertBulk (assume unique)   " << secondsSince(t0) * 1000 << " ms\n";
+    }
+    {
+        HashTable table(101);
+        table.insertBulk(creds, true);
+        const std::string file = "bench_vault.bin";
+        Clock::time_point t0 = Clock::now();
+        table.save(file, "bench-key");
+        std::cout << "save                         " << secondsSince(t0) * 1000 << " ms\n";
+        HashTable loaded(101);
+        t0 = Clock::now();
+        loaded.load(file, "bench-key");
+        std::cout << "load                         " << secondsSince(t0) * 1000 << " ms\n";
+        std::remove(file.c_str());
+    }
+}
+
+// Resident set size in bytes (Linux only; 0 elsewhere)
+size_t currentRSS() {
+#if defined(__linux__)
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if (f == nullptr) return 0;
+    unsigned long pages = 0, resident = 0;
+    int read = std::fscanf(f, "%lu %lu", &pages, &resident);
+    std::fclose(f);
+    return read == 2 ? resident * 4096 : 0;
+#else
+    return 0;
+#endif
+}
+
+// Hands freed heap memory back to the OS so RSS deltas start from a clean baseline
+void trimHeap() {
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+}
+
+// Resets the kernel's high-water mark of resident memory (VmHWM); false where unsupported
+bool resetPeakRSS() {
+#if defined(__linux__)
+    FILE* f = std::fopen("/proc/self/clear_refs", "w");
+    if (f == nullptr) return false;
+    bool ok = std::fputs("5", f) >= 0;
+    return std::fclose(f) == 0 && ok;
+#else
+    return false;
+#endif
+}
+
+size_t peakRSS() {
+#if defined(__linux__)
+    FILE* f = std::fopen("/proc/self/status", "r");
+    if (f == nullptr) return 0;
+    char line[256];
+    unsigned long kb = 0;
+    while (std::fgets(line, sizeof(line), f) != nullptr) {
+        if (std::sscanf(line, "VmHWM: %lu kB", &kb) == 1) break;
+    }
+    std::fclose(f);
+    return kb * 1024;
+#else
+    return 0;
+#endif
+}
+
+// Footprint of one table type: RSS and allocator calls per entry, and teardown time.
+template <class Table>
+void runTableMemory(const std::string& name, const std::vector<Credential>& creds) {
+    trimHeap();
+    size_t rss0 = currentRSS();
+    size_t allocs0 = g_allocCalls;
+    Table* table = new Table(101);
+    for (const Credential& c : creds) table->insert(c);
+    size_t rss1 = currentRSS();
+    size_t allocs1 = g_allocCalls;
+
+    Clock::time_point t0 = Clock::now();
+    delete table;
+    double teardown = secondsSince(t0);
+
+    double n = static_cast<double>(creds.size());
+    std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(1)
+              << " bytes/entry " << std::setw(7) << (rss1 - rss0) / n
+              << "  allocs/entry " << std::setw(5) << (allocs1 - allocs0) / n
+              << "  teardown " << std::setw(8) << teardown * 1000 << " ms\n";
+    std::cout.unsetf(std::ios::fixed);
+}
+
+// Memory footprint: node slabs + string arena vs one heap node (and heap strings) per entry
+void benchMemory(size_t n) {
+    // Long sites and passwords, so every field would spill out of the SSO buffer
+    std::vector<Credential> creds;
+    creds.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        creds.emplace_back("login.site" + std::to_string(i / 4) + ".example.com",
+                           "user" + std::to_string(i) + "@example.org",
+                           "pw-" + std::to_string(i * 2654435761u) + "-secret");
+    }
+    std::cout << "== memory footprint, " << n << " entries ==\n";
+    runTableMemory<LegacyChainedTable>("chained", creds);
+    runTableMemory<HashTable>("open-addressing", creds);
+}
+
+// Today's setup: one HashTable behind one global mutex
+class GlobalMutexTable {
+    mutable std::mutex lock;
+    HashTable table;
+public:
+    explicit GlobalMutexTable(int cap) : table(cap) {}
+    void emplace(std::string_view s, std::string_view u, std::string_view p) {
+        std::lock_guard<std::mutex> guard(lock);
+        table.emplace(s, u, p);
+    }
+    bool found(std::string_view s, std::string_view u) const {
+        std::lock_guard<std::mutex> guard(lock);
+        return const_cast<HashTable&>(table).search(s, u) != nullptr;
+    }
+};
+
+struct ShardedTable {
+    ConcurrentHashTable table;
+    explicit ShardedTable(int) : table(64, 101) {}
+    void emplace(std::string_view s, std::string_view u, std::string_view p) { table.emplace(s, u, p); }
+    bool found(std::string_view s, std::string_view u) const {
+        return table.visit(s, u, [](const Credential&) {});
+    }
+};
+
+// Runs `threads` workers for a fixed time; each op is a read with probability readPct%
+template <class Table>
+double runThroughput(Table& table, const std::vector<Credential>& creds, int threads, int readPct) {
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> ops(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::mt19937_64 rng(t + 1);
+            uint64_t local = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                const Credential& c = creds[rng() % creds.size()];
+                if (static_cast<int>(rng() % 100) < readPct) {
+                    table.found(c.site, c.username);
+                } else {
+                    table.emplace(c.site, c.username, c.password);
+                }
+                local++;
+            }
+            ops += local;
+        });
+    }
+    Clock::time_point t0 = Clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    stop = true;
+    for (std::thread& w : workers) w.join();
+    return static_cast<double>(ops.load()) / secondsSince(t0);
+}
+
+// Multi-threaded throughput: one global mutex vs sharded reader-writer locks
+void benchConcurrent(size_t n) {
+    std::vector<Credential> creds = makeCredentials(n, 4);
+    std::cout << "== concurrent throughput, " << n << " entries, hardware threads: "
+              << std::thread::hardware_concurrency() << " ==\n";
+    const int mixes[] = {90, 50};
+    const int threadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+    for (int readPct : mixes) {
+        GlobalMutexTable global(101);
+        ShardedTable sharded(101);
+        for (const Credential& c : creds) {
+            global.emplace(c.site, c.username, c.password);
+            sharded.emplace(c.site, c.username, c.password);
+        }
+        for (int threads : threadCounts) {
+            double g = runThroughput(global, creds, threads, readPct);
+            double s = runThroughput(sharded, creds, threads, readPct);
+            std::cout << "read:write " << readPct << ":" << 100 - readPct << "  threads " << std::setw(2) << threads
+                      << "  global mutex " << std::setw(8) << static_cast<long>(g / 1000) << " kops/s"
+                      << "  sharded " << std::setw(8) << static_cast<long>(s / 1000) << " kops/s\n";
+        }
+    }
+}
+
+// Hashes every key `rounds` times; returns ns per key. The checksum keeps the calls alive.
+template <class Hasher>
+double runHashThroughput(const Hasher& hasher, const std::vector<std::string>& keys, int rounds, uint64_t& checksum) {
+    Clock::time_point t0 = Clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (const std::string& key : keys) checksum += hasher(key, std::string_view());
+    }
+    return secondsSince(t0) * 1e9 / (static_cast<double>(keys.size()) * rounds);
+}
+
+// Hash function cost per key length, and end-to-end table latency per policy
+void benchHash(size_t n) {
+    std::cout << "== hash throughput ==\n";
+    const size_t lengths[] = {8, 16, 32, 64, 256};
+    uint64_t checksum = 0;
+    for (size_t len : lengths) {
+        std::vector<std::string> keys(1024);
+        std::mt19937_64 rng(len);
+        for (std::string& key : keys) {
+            key.resize(len);
+            for (char& c : key) c = static_cast<char>('a' + rng() % 26);
+        }
+        const int rounds = static_cast<int>(std::max<size_t>(1, (64u << 20) / (len * keys.size())));
+        double poly = runHashThroughput(PolynomialHash(), keys, rounds, checksum);
+        double seeded = runHashThroughput(SeededHash(), keys, rounds, checksum);
+        std::cout << "key " << std::setw(3) << len << " B   polynomial " << std::setw(7) << std::fixed << std::setprecision(2)
+                  << poly << " ns/key (" << std::setw(5) << len / poly << " GB/s)   seeded " << std::setw(6) << seeded
+                  << " ns/key (" << std::setw(5) << len / seeded << " GB/s)\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    volatile uint64_t sink = checksum;
+    (void)sink;
+
+    std::vector<Credential> creds = makeCredentials(n, 1);
+    std::vector<Credential> misses = makeCredentials(n, 1, "-absent");
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+    std::cout << "== table latency by hash policy, " << n << " entries ==\n";
+    runTableLatency<BasicHashTable<PolynomialHash>>("polynomial", creds, misses, order);
+    runTableLatency<HashTable>("seeded", creds, misses, order);
+}
+
+// Save cost: wall time and the extra resident memory save() needs on top of the table
+void benchSave(size_t n) {
+    std::vector<Credential> creds = makeCredentials(n, 4);
+    HashTable table(101);
+    table.insertBulk(creds, true);
+    creds.clear();
+    creds.shrink_to_fit();
+    trimHeap();
+
+    const std::string file = "bench_vault.bin";
+    std::cout << "== save, " << n << " entries ==\n";
+    for (int run = 0; run < 3; ++run) {
+        trimHeap();
+        size_t rss0 = currentRSS();
+        bool peakKnown = resetPeakRSS();
+        Clock::time_point t0 = Clock::now();
+        table.save(file, "bench-key");
+        double seconds = secondsSince(t0);
+        size_t peak = peakRSS();
+
+        FILE* f = std::fopen(file.c_str(), "rb");
+        long size = 0;
+        if (f != nullptr) {
+            std::fseek(f, 0, SEEK_END);
+            size = std::ftell(f);
+            std::fclose(f);
+        }
+        std::cout << std::fixed << std::setprecision(1) << "vault " << size / 1e6 << " MB  save " << seconds * 1000 << " ms  ";
+        if (peakKnown) std::cout << "peak extra RSS " << (peak > rss0 ? peak - rss0 : 0) / 1e6 << " MB\n";
+        else std::cout << "peak RSS not available\n";
+        std::cout.unsetf(std::ios::floatfield);
+    }
+    std::remove(file.c_str());
+}
+
+// The load() SecurePass used before the mmap path: read the file into a string,
+// MAC it, decrypt into a second string, split it with a stringstream and parse every
+// line with the old character-by-character CSV reader. Records are inserted the same
+// way load() does (presized, no duplicate probe). The MAC uses the embedded HMAC.
+bool legacyLoad(HashTable& table, const std::string& filename, const std::string& key) {
+    table.clear();
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return false;
+    std::streamsize size = in.tellg();
+    in.seekg(0, std::ios::beg);
+    if (size < 40) return false;
+    std::string header(40, '\0');
+    in.read(&header[0], 40);
+    std::string encrypted(static_cast<size_t>(size - 40), '\0');
+    in.read(&encrypted[0], size - 40);
+
+    HmacSha256 mac(key);
+    mac.update(encrypted);
+    unsigned char digest[Sha256::DIGEST_SIZE];
+    mac.final(digest);
+    if (std::memcmp(digest, header.data() + 8, sizeof(digest)) != 0) return false;
+
+    std::string decrypted = encrypted;
+    for (size_t i = 0; i < decrypted.size(); ++i) decrypted[i] = static_cast<char>(decrypted[i] ^ key[i % key.size()]);
+    table.reserve(static_cast<int>(std::count(decrypted.begin(), decrypted.end(), '\n')) + 1);
+
+    std::stringstream ss(decrypted);
+    std::string line;
+    while (std::getline(ss, line)) {
+        if (line.length() <= 5) continue;
+        std::string fields[3], temp;
+        int state = 0;
+        bool insideQuotes = false;
+        for (char c : line) {
+            if (c == '"') {
+                if (insideQuotes) {
+                    if (state < 3) fields[state] = temp;
+                    temp = "";
+                    state++;
+                }
+                insideQuotes = !insideQuotes;
+            } else if (insideQuotes) {
+                temp += c;
+            }
+        }
+        Credential cred(fields[0], fields[1], fields[2]);
+        table.insertBulk(&cred, &cred + 1, true);
+    }
+    return true;
+}
+
+long fileSize(const std::string& filename) {
+    FILE* f = std::fopen(filename.c_str(), "rb");
+    if (f == nullptr) return 0;
+    std::fseek(f, 0, SEEK_END);
+    long size = std::ftell(f);
+    std::fclose(f);
+    return size;
+}
+
+// Writes the table as a SPASSv01 (CSV payload) vault, the format save() produced before v02
+void writeV1Vault(const HashTable& table, const std::string& filename, const std::string& key) {
+    std::string payload;
+    table.forEach([&payload](const Credential& c) {
+        c.appendCSV(payload);
+        payload += '\n';
+    });
+    for (size_t i = 0; i < payload.size(); ++i) payload[i] = static_cast<char>(payload[i] ^ key[i % key.size()]);
+    HmacSha256 mac(key);
+    mac.update(payload);
+    unsigned char digest[Sha256::DIGEST_SIZE];
+    mac.final(digest);
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write("SPASSv01", 8);
+    out.write(reinterpret_cast<const char*>(digest), sizeof(digest));
+    out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+}
+
+// Load throughput: the old read/stringstream/getline path and the mmap path on a
+// SPASSv01 (CSV) vault, and the mmap path on the binary SPASSv02 vault
+void benchLoad(size_t n) {
+    const std::string v1File = "bench_vault_v1.bin";
+    const std::string v2File = "bench_vault_v2.bin";
+    const std::string key = "bench-key";
+    {
+        std::vector<Credential> creds = makeCredentials(n, 4);
+        HashTable table(101);
+        table.insertBulk(creds, true);
+        writeV1Vault(table, v1File, key);
+        table.save(v2File, key);
+    }
+    const long v1Size = fileSize(v1File);
+    const long v2Size = fileSize(v2File);
+    std::cout << "== load, " << n << " entries; v01 vault " << v1Size / 1000000.0 << " MB, v02 vault "
+              << v2Size / 1000000.0 << " MB ==\n";
+    auto report = [n](const char* name, long size, double seconds) {
+        std::cout << std::fixed << std::setprecision(1) << std::left << std::setw(26) << name << std::right
+                  << std::setw(7) << size / seconds / 1e6 << " MB/s " << std::setw(6) << n / seconds / 1e6 << " M records/s\n";
+        std::cout.unsetf(std::ios::floatfield);
+    };
+    for (int run = 0; run < 3; ++run) {
+        HashTable table(101);
+        Clock::time_point t0 = Clock::now();
+        bool ok = legacyLoad(table, v1File, key);
+        report("v01 stream+getline", v1Size, secondsSince(t0));
+        if (!ok || static_cast<size_t>(table.size()) != n) std::cerr << "  warning: legacy load failed\n";
+
+        t0 = Clock::now();
+        ok = table.load(v1File, key);
+        report("v01 mmap+string_view", v1Size, secondsSince(t0));
+        if (!ok || static_cast<size_t>(table.size()) != n) std::cerr << "  warning: v01 load failed\n";
+
+        t0 = Clock::now();
+        ok = table.load(v2File, key);
+        report("v02 mmap+length prefixes", v2Size, secondsSince(t0));
+        if (!ok || static_cast<size_t>(table.size()) != n) std::cerr << "  warning: v02 load failed\n";
+    }
+    std::remove(v1File.c_str());
+    std::remove(v2File.c_str());
+}
+
+// Parallel load scaling: the same chunked vault loaded with 1..N worker threads
+void benchParallelLoad(size_t n) {
+    const std::string file = "bench_vault.bin";
+    const std::string key = "bench-key";
+    {
+        std::vector<Credential> creds = makeCredentials(n, 4);
+        HashTable table(101);
+        table.insertBulk(creds, true);
+        table.save(file, key);
+    }
+    const long size = fileSize(file);
+    const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "== parallel load, " << n << " entries, " << size / 1000000.0 << " MB vault, hardware threads: " << hw << " ==\n";
+    std::vector<int> threadCounts;
+    for (unsigned t = 1; t < hw; t *= 2) threadCounts.push_back(static_cast<int>(t));
+    threadCounts.push_back(static_cast<int>(hw));
+    if (hw < 4) threadCounts.push_back(4); // Show the overhead of oversubscribing small machines
+    double single = 0;
+    for (int threads : threadCounts) {
+        double best = 1e9;
+        for (int run = 0; run < 3; ++run) {
+            HashTable table(101);
+            Clock::time_point t0 = Clock::now();
+            bool ok = table.load(file, key, threads);
+            best = std::min(best, secondsSince(t0));
+            if (!ok || static_cast<size_t>(table.size()) != n) std::cerr << "  warning: load failed\n";
+        }
+        if (threads == 1) single = best;
+        std::cout << std::fixed << std::setprecision(1) << "threads " << std::setw(3) << threads
+                  << "  " << std::setw(7) << best * 1000 << " ms  " << std::setw(6) << n / best / 1e6 << " M records/s  "
+                  << std::setw(7) << size / best / 1e6 << " MB/s  speedup " << std::setprecision(2) << single / best << "x\n";
+        std::cout.unsetf(std::ios::floatfield);
+    }
+    std::remove(file.c_str());
+}
+
+// Startup time against vault size: load() rebuilding the index from the records vs
+// load() adopting a layout saved with setSaveLayout(true). "mac" is one HMAC pass
+// over the whole file, the floor for any load that verifies everything.
+void benchStartup(size_t n) {
+    const std::string file = "bench_vault.bin";
+    const std::string key = "bench-key";
+    std::cout << "== startup (best of 3 loads, 1 thread) ==\n"
+              << "   records  file MB  rebuild ms  layout ms  file+layout MB  mac ms  speedup\n";
+    for (size_t records = std::max<size_t>(n / 64, 1); records <= n; records *= 4) {
+        std::vector<Credential> creds = makeCredentials(records, 4);
+        HashTable source(101);
+        source.insertBulk(creds, true);
+        double times[2] = {0, 0};
+        long sizes[2] = {0, 0};
+        double mac = 0;
+        for (int withLayout = 0; withLayout < 2; ++withLayout) {
+            source.setSaveLayout(withLayout != 0);
+            source.save(file, key);
+            sizes[withLayout] = fileSize(file);
+            double best = 1e9;
+            for (int run = 0; run < 3; ++run) {
+                HashTable table(101);
+                Clock::time_point t0 = Clock::now();
+                bool ok = table.load(file, key);
+                best = std::min(best, secondsSince(t0));
+                if (!ok || table.loadedLayout() != (withLayout != 0) || static_cast<size_t>(table.size()) != records) {
+                    std::cerr << "  warning: load failed\n";
+                }
+            }
+            times[withLayout] = best;
+        }
+        MappedFile mapped;
+        mapped.open(file);
+        Clock::time_point t0 = Clock::now();
+        HmacSha256 fileMac(key);
+        fileMac.update(mapped.data(), mapped.size());
+        unsigned char digest[Sha256::DIGEST_SIZE];
+        fileMac.final(digest);
+        mac = secondsSince(t0);
+        std::cout << std::fixed << std::setprecision(1) << std::setw(10) << records << std::setw(9) << sizes[0] / 1e6
+                  << std::setw(12) << times[0] * 1000 << std::setw(11) << times[1] * 1000 << std::setw(16)
+                  << sizes[1] / 1e6 << std::setw(8) << mac * 1000 << std::setprecision(2) << std::setw(8)
+                  << times[0] / times[1] << "x\n";
+        std::cout.unsetf(std::ios::floatfield);
+    }
+    std::remove(file.c_str());
+}
+
+// Save and load with and without setCompression(true), on the usual synthetic vault
+// (every username unique, passwords of digits) and on one closer to real use: a few
+// hundred email addresses reused across sites, random 16-character passwords.
+void benchCompression(size_t n) {
+    const std::string file = "bench_vault.bin";
+    const std::string key = "bench-key";
+    std::mt19937_64 rng(42);
+    const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!#$%&*+-=?@^_";
+    std::vector<Credential> reused;
+    reused.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        std::string password(16, ' ');
+        for (char& c : password) c = alphabet[rng() % (sizeof(alphabet) - 1)];
+        reused.emplace_back("site" + std::to_string(i / 4) + ".example.com",
+                            "person" + std::to_string(rng() % 300) + "@mail.example.org", password);
+    }
+    const std::pair<const char*, std::vector<Credential>> sets[] = {
+        {"unique usernames", makeCredentials(n, 4)},
+        {"reused emails", std::move(reused)},
+    };
+    std::cout << "== compression, " << n << " entries (best of 3, load with 1 thread) ==\n"
+              << "dataset           mode        file MB   ratio  save ms  load ms\n";
+    for (const auto& set : sets) {
+        HashTable table(101);
+        table.insertBulk(set.second, true);
+        long plainSize = 0;
+        for (int compress = 0; compress < 2; ++compress) {
+            table.setCompression(compress != 0);
+            double save = 1e9, load = 1e9;
+            for (int run = 0; run < 3; ++run) {
+                Clock::time_point t0 = Clock::now();
+                bool ok = table.save(file, key);
+                save = std::min(save, secondsSince(t0));
+                HashTable loaded(101);
+                t0 = Clock::now();
+                ok = ok && loaded.load(file, key);
+                load = std::min(load, secondsSince(t0));
+                if (!ok || static_cast<size_t>(loaded.size()) != n) std::cerr << "  warning: round trip failed\n";
+            }
+            const long size = fileSize(file);
+            if (compress == 0) plainSize = size;
+            std::cout << std::fixed << std::setprecision(1) << std::left << std::setw(18) << set.first
+                      << std::setw(10) << (compress != 0 ? "compressed" : "plain") << std::right << std::setw(9)
+                      << size / 1e6 << std::setprecision(2) << std::setw(8) << static_cast<double>(plainSize) / size
+                      << std::setprecision(1) << std::setw(9) << save * 1000 << std::setw(9) << load * 1000 << "\n";
+            std::cout.unsetf(std::ios::floatfield);
+        }
+    }
+    std::remove(file.c_str());
+}
+
+// Writer latency while the table is saved. save() stops every edit for its whole
+// duration; saveInBackground() takes a copy-on-write snapshot and edits go on,
+// paying for a slab copy the first time they touch each node slab.
+void benchSnapshot(size_t n) {
+    const std::string file = "bench_vault.bin";
+    const std::string key = "bench-key";
+    std::vector<Credential> creds = makeCredentials(n, 4);
+    HashTable table(101);
+    table.insertBulk(creds, true);
+    std::mt19937_64 rng(3);
+    size_t k = 0;
+    // Mostly password updates; every 8th edit removes and re-inserts an entry
+    auto edit = [&]() {
+        const Credential& c = creds[rng() % n];
+        if (++k % 8 == 0) {
+            table.remove(c.site, c.username);
+            table.emplace(c.site, c.username, c.password);
+        } else {
+            table.update(c.site, c.username, "edited");
+        }
+    };
+    std::cout << "== writer latency during a save, " << n << " entries, hardware threads: "
+              << std::max(1u, std::thread::hardware_concurrency()) << " ==\n";
+
+    const size_t baseline = 200000;
+    LatencyRecorder latency(baseline);
+    for (size_t i = 0; i < baseline; ++i) {
+        Clock::time_point t0 = Clock::now();
+        edit();
+        latency.add(Clock::now() - t0);
+    }
+    latency.report("edits, no save");
+
+    Clock::time_point t0 = Clock::now();
+    table.save(file, key);
+    std::cout << std::fixed << std::setprecision(1) << "save()                       every writer stalls "
+              << secondsSince(t0) * 1000 << " ms\n";
+
+    t0 = Clock::now();
+    std::shared_future<bool> saved = table.saveInBackground(file, key);
+    const double snapshot = secondsSince(t0);
+    size_t edits = 0;
+    while (saved.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        Clock::time_point e0 = Clock::now();
+        edit();
+        latency.add(Clock::now() - e0);
+        ++edits;
+    }
+    const double duration = secondsSince(t0);
+    if (!saved.get()) std::cerr << "  warning: background save failed\n";
+    std::cout << "saveInBackground()           snapshot " << snapshot * 1e6 << " us, file written after "
+              << duration * 1000 << " ms, " << edits << " edits meanwhile\n";
+    std::cout.unsetf(std::ios::floatfield);
+    if (edits != 0) latency.report("edits during background save");
+    std::remove(file.c_str());
+}
+
+// Cost of persisting one changed password: full save() vs one journal record.
+// Journaled updates include the background compactions they trigger.
+void benchJournal(size_t n) {
+    const std::string file = "bench_vault.bin";
+    const std::string key = "bench-key";
+    std::vector<Credential> creds = makeCredentials(n, 4);
+    HashTable table(101);
+    table.insertBulk(creds, true);
+    std::cout << "== journal, " << n << " entries ==\n";
+
+    const int saves = 5;
+    Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < saves; ++i) {
+        table.update(creds[i].site, creds[i].username, "changed-" + std::to_string(i));
+        table.save(file, key);
+    }
+    double perSave = secondsSince(t0) / saves;
+    std::cout << std::fixed << std::setprecision(3) << "update + save()        " << perSave * 1000 << " ms/change  "
+              << fileSize(file) / 1e6 << " MB written/change\n";
+
+    HashTable journaled(101);
+    journaled.openJournal(file, key);
+    const size_t updates = std::min<size_t>(n, 200000);
+    size_t logged = 0;
+    size_t lastSize = journaled.journalSize();
+    t0 = Clock::now();
+    for (size_t i = 0; i < updates; ++i) {
+        journaled.update(creds[i].site, creds[i].username, "journaled-" + std::to_string(i));
+        size_t now = journaled.journalSize();
+        if (now > lastSize) logged += now - lastSize;
+        lastSize = now;
+    }
+    journaled.closeJournal(); // Waits for a compaction still in flight
+    double perUpdate = secondsSince(t0) / static_cast<double>(updates);
+    std::cout << "update (journaled)     " << perUpdate * 1e6 << " us/change  " << logged / static_cast<double>(updates)
+              << " bytes logged/change (" << std::setprecision(0) << perSave / perUpdate << "x faster)\n";
+
+    HashTable reopened(101);
+    t0 = Clock::now();
+    reopened.openJournal(file, key);
+    double reopen = secondsSince(t0);
+    t0 = Clock::now();
+    reopened.compact();
+    std::cout << std::setprecision(1) << "open (snapshot + replay " << lastSize / 1e6 << " MB log) " << reopen * 1000
+              << " ms  compact " << secondsSince(t0) * 1000 << " ms\n";
+    std::cout.unsetf(std::ios::floatfield);
+    reopened.closeJournal();
+    std::remove(file.c_str());
+    std::remove((file + ".log").c_str());
+}
+
+// Durable commits under a stream of edits. Editor threads change a password and
+// wait until it is on disk. Baseline: every edit runs its own durable save()
+// (serialized, since they share a file). Group commit: edits that wait at the same
+// time share one save. Journal: one fsync of the log per commit window.
+void benchCommit(size_t n) {
+    const std::string file = "bench_vault.bin";
+    const std::string key = "bench-key";
+    const int editors = 8;
+    const double seconds = 1.0;
+    std::vector<Credential> creds = makeCredentials(n, 4);
+    std::cout << "== durable commits, " << n << " entries, " << editors << " editor threads ==\n";
+
+    // Runs editors until `seconds` pass; edit(thread, i) returns once its change is durable
+    auto runEditors = [&](auto edit, size_t& edits, double& meanLatency) {
+        std::atomic<bool> stop(false);
+        std::atomic<size_t> total(0);
+        std::atomic<long long> latencyNs(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < editors; ++t) {
+            threads.emplace_back([&, t]() {
+                std::mt19937 rng(static_cast<unsigned>(t));
+                while (!stop) {
+                    Clock::time_point t0 = Clock::now();
+                    edit(rng() % creds.size());
+                    latencyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+                    total++;
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop = true;
+        for (std::thread& t : threads) t.join();
+        edits = total;
+        meanLatency = edits == 0 ? 0 : static_cast<double>(latencyNs.load()) / 1e6 / static_cast<double>(edits);
+    };
+    // writes < 0: the number of disk commits is not tracked
+    auto report = [&](const std::string& name, size_t edits, long writes, double meanLatency) {
+        std::cout << std::fixed << std::setprecision(1) << std::left << std::setw(28) << name << std::right
+                  << std::setw(8) << edits / seconds << " durable edits/s  ";
+        if (writes >= 0) std::cout << std::setw(7) << writes / seconds << " disk commits/s  ";
+        std::cout << "mean wait " << std::setprecision(2) << meanLatency << " ms\n";
+        std::cout.unsetf(std::ios::floatfield);
+    };
+
+    {
+        ConcurrentHashTable table(16, 101);
+        for (const Credential& c : creds) table.emplace(c.site, c.username, c.password);
+        std::mutex saveLock;
+        size_t edits = 0;
+        double latency = 0;
+        runEditors([&](size_t i) {
+            table.update(creds[i].site, creds[i].username, "changed");
+            std::lock_guard<std::mutex> guard(saveLock);
+            table.save(file, key);
+        }, edits, latency);
+        report("save() per edit", edits, static_cast<long>(edits), latency);
+
+        const int windowsUs[] = {0, 1000, 5000};
+        for (int windowUs : windowsUs) {
+            table.enableGroupCommit(file, key, std::chrono::microseconds(windowUs));
+            runEditors([&](size_t i) {
+                table.update(creds[i].site, creds[i].username, "changed");
+                table.commit().get();
+            }, edits, latency);
+            long writes = static_cast<long>(table.commits());
+            table.disableGroupCommit();
+            report("group commit, window " + std::to_string(windowUs / 1000.0).substr(0, 3) + " ms", edits, writes, latency);
+        }
+    }
+
+    // The journal takes one writer; its edits wait for log fsyncs instead of saves
+    {
+        HashTable journaled(101);
+        journaled.insertBulk(creds, true);
+        journaled.save(file, key);
+        journaled.openJournal(file, key);
+        const int windowsUs[] = {0, 1000};
+        for (int windowUs : windowsUs) {
+            journaled.setCommitWindow(std::chrono::microseconds(windowUs));
+            std::mutex tableLock;
+            size_t edits = 0;
+            double latency = 0;
+            runEditors([&](size_t i) {
+                std::shared_future<bool> done;
+                {
+                    std::lock_guard<std::mutex> guard(tableLock);
+                    journaled.update(creds[i].site, creds[i].username, "journaled");
+                    done = journaled.commit();
+                }
+                done.get();
+            }, edits, latency);
+            report("journal, window " + std::to_string(windowUs / 1000.0).substr(0, 3) + " ms", edits, -1, latency);
+        }
+        journaled.closeJournal();
+    }
+    std::remove(file.c_str());
+    std::remove((file + ".log").c_str());
+    std::remove((file + ".log.1").c_str());
+}
+
+// Single lookups against a vault file: load it and search, versus answering from
+// the file's index with VaultReader, which verifies and decrypts only one block
+void benchLookup(size_t n) {
+    const std::string file = "bench_vault.bin";
+    const std::string key = "bench-key";
+    std::vector<Credential> creds = makeCredentials(n, 4);
+    {
+        HashTable table(101);
+        table.insertBulk(creds, true);
+        table.save(file, key);
+    }
+    std::cout << "== lookup, " << n << " entries, " << fileSize(file) / 1e6 << " MB vault ==\n";
+
+    const int loads = 3;
+    Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < loads; ++i) {
+        HashTable table(101);
+        table.load(file, key);
+        if (table.search(creds[i].site, creds[i].username) == nullptr) std::cerr << "lookup: load missed a key\n";
+    }
+    double perLoad = secondsSince(t0) / loads;
+    std::cout << std::fixed << std::setprecision(1) << "load() + search()      " << perLoad * 1e6 << " us/lookup\n";
+
+    VaultReader reader;
+    t0 = Clock::now();
+    reader.open(file, key);
+    double open = secondsSince(t0);
+    const size_t lookups = std::min<size_t>(n, 100000);
+    std::mt19937_64 rng(11);
+    Credential found;
+    size_t hits = 0;
+    t0 = Clock::now();
+    for (size_t i = 0; i < lookups; ++i) {
+        const Credential& c = creds[rng() % n];
+        hits += reader.find(c.site, c.username, found);
+    }
+    double perFind = secondsSince(t0) / static_cast<double>(lookups);
+    std::cout << "VaultReader open()     " << open * 1e6 << " us\n"
+              << "VaultReader find()     " << perFind * 1e6 << " us/lookup  " << std::setprecision(2)
+              << reader.blocksRead() / static_cast<double>(lookups) << " blocks/lookup  " << hits << "/" << lookups
+              << " found (" << std::setprecision(0) << perLoad / (open + perFind) << "x faster for one lookup)\n";
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    std::remove(file.c_str());
+}
+
+// Runs fn(repeat) until about 0.3 s have passed; returns GB/s for `bytes` per call
+template <class Fn>
+double measureGBps(size_t bytes, Fn fn) {
+    size_t calls = 0;
+    Clock::time_point t0 = Clock::now();
+    double elapsed = 0;
+    do {
+        fn();
+        ++calls;
+        elapsed = secondsSince(t0);
+    } while (elapsed < 0.3);
+    return static_cast<double>(bytes) * static_cast<double>(calls) / elapsed / 1e9;
+}
+
+// SHA-256 throughput per kernel: one long message, and many short records
+void benchSha(size_t n) {
+    std::vector<unsigned char> big(n);
+    std::mt19937_64 rng(7);
+    for (unsigned char& c : big) c = static_cast<unsigned char>(rng());
+    const size_t recordSizes[] = {64, 256, 1024};
+    const size_t recordCount = 4096;
+    unsigned char digest[Sha256::DIGEST_SIZE];
+    std::vector<unsigned char> digests(recordCount * Sha256::DIGEST_SIZE);
+
+    std::cout << "== sha256 throughput (GB/s), " << n << "-byte message, " << recordCount
+              << " records; default kernel: " << sha256_kernel_name(sha256_active_kernel()) << " ==\n";
+    const Sha256Kernel original = sha256_active_kernel();
+    const Sha256Kernel kernels[] = {SHA256_KERNEL_SCALAR, SHA256_KERNEL_SHANI};
+    std::cout << std::fixed << std::setprecision(2);
+    for (Sha256Kernel kernel : kernels) {
+        if (!sha256_use_kernel(kernel)) {
+            std::cout << std::setw(8) << sha256_kernel_name(kernel) << "  not supported on this CPU\n";
+            continue;
+        }
+        std::cout << std::setw(8) << sha256_kernel_name(kernel) << "  single "
+                  << std::setw(5) << measureGBps(big.size(), [&] {
+                         Sha256 ctx;
+                         ctx.update(big.data(), big.size());
+                         ctx.final(digest);
+                     });
+        for (size_t size : recordSizes) {
+            std::vector<std::string_view> records(recordCount);
+            for (size_t i = 0; i < recordCount; ++i) {
+                records[i] = std::string_view(reinterpret_cast<const char*>(big.data()) + (i * size) % (n - size), size);
+            }
+            std::cout << "  records " << std::setw(4) << size << " B " << std::setw(5)
+                      << measureGBps(size * recordCount, [&] {
+                             for (size_t i = 0; i < recordCount; ++i) {
+                                 Sha256 ctx;
+                                 ctx.update(records[i]);
+                                 ctx.final(&digests[i * Sha256::DIGEST_SIZE]);
+                             }
+                         });
+        }
+        std::cout << "\n";
+    }
+#if HASH_HAS_OPENSSL
+    std::cout << std::setw(8) << "openssl" << "  single " << std::setw(5) << measureGBps(big.size(), [&] {
+        unsigned int len = 0;
+        EVP_Digest(big.data(), big.size(), digest, &len, EVP_sha256(), nullptr);
+    }) << "\n";
+#endif
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    sha256_use_kernel(original);
+}
+
+// The cipher SecurePass used before StreamCipher: both arguments by value, a new
+// string for the result and a division per byte
+std::string legacyXorCipher(std::string data, std::string key) {
+    std::string result = data;
+    for (size_t i = 0; i < data.size(); ++i) result[i] = static_cast<char>(data[i] ^ key[i % key.size()]);
+    return result;
+}
+
+// Cipher throughput: the legacy by-value cipher and a plain byte loop, then every XOR kernel on one long
+// buffer in place and on 4 KiB chunks at their stream positions (as save() and
+// load() call it), for the benchmark key and a key longer than a vector
+void benchCipher(size_t n) {
+    std::string big(n, '\0');
+    std::mt19937_64 rng(8);
+    for (char& c : big) c = static_cast<char>(rng());
+    const std::string keys[] = {"bench-key", std::string(100, 'k')};
+    const size_t chunk = 4096;
+    const XorKernel original = xor_active_kernel();
+
+    std::cout << "== cipher throughput (GB/s), " << n << " bytes ==\n" << std::fixed << std::setprecision(2);
+    std::string sink;
+    std::cout << std::setw(8) << "legacy" << "  by value " << std::setw(6)
+              << measureGBps(big.size(), [&] { sink = legacyXorCipher(big, keys[0]); }) << "\n";
+    // The in-place byte loop that replaced it (no division, one byte per step)
+    std::cout << std::setw(8) << "bytes" << "  in place " << std::setw(6) << measureGBps(big.size(), [&] {
+        size_t k = 0;
+        for (char& c : big) {
+            c = static_cast<char>(c ^ keys[0][k]);
+            if (++k == keys[0].size()) k = 0;
+        }
+    }) << "\n";
+    const XorKernel kernels[] = {XOR_KERNEL_SCALAR, XOR_KERNEL_SSE2, XOR_KERNEL_AVX2};
+    for (XorKernel kernel : kernels) {
+        if (!xor_use_kernel(kernel)) {
+            std::cout << std::setw(8) << xor_kernel_name(kernel) << "  (not supported)\n";
+            continue;
+        }
+        std::cout << std::setw(8) << xor_kernel_name(kernel);
+        for (const std::string& key : keys) {
+            const RepeatingKeyXor cipher(key);
+            std::cout << "  key " << std::setw(3) << key.size() << ": whole " << std::setw(6)
+                      << measureGBps(big.size(), [&] { cipher.apply(&big[0], big.size(), 0); }) << "  4 KiB chunks "
+                      << std::setw(6) << measureGBps(big.size(), [&] {
+                             for (size_t pos = 0; pos < big.size(); pos += chunk) {
+                                 cipher.apply(&big[pos], std::min(chunk, big.size() - pos), pos);
+                             }
+                         });
+        }
+        std::cout << "\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    xor_use_kernel(original);
+}
+
+// Scripted import of n records: the interactive menu loop fed "add" and three
+// fields per record (menu and prompts written to /dev/null), a getline + fromCSV
+// loop, and importCsv's block reader; then exportCsv
+void benchImport(size_t n) {
+    const std::string csvFile = "bench_import.csv";
+    {
+        std::vector<Credential> creds = makeCredentials(n, 4);
+        HashTable table(101);
+        table.insertBulk(creds, true);
+        std::ofstream out(csvFile, std::ios::binary | std::ios::trunc);
+        exportCsv(table, out);
+    }
+    const long size = fileSize(csvFile);
+    std::cout << "== CSV import, " << n << " records, " << size / 1e6 << " MB ==\n";
+    auto report = [&](const char* name, size_t records, double seconds) {
+        std::cout << std::fixed << std::setprecision(2) << std::left << std::setw(30) << name << std::right
+                  << std::setw(8) << records / seconds / 1e6 << " M records/s " << std::setw(8) << size / seconds / 1e6
+                  << " MB/s\n";
+        std::cout.unsetf(std::ios::floatfield);
+    };
+
+    {
+        std::string script;
+        std::ifstream in(csvFile, std::ios::binary);
+        for (std::string line; std::getline(in, line);) {
+            Credential c = Credential::fromCSV(line);
+            script += "add\n" + std::string(c.site) + "\n" + std::string(c.username) + "\n" + std::string(c.password) + "\n";
+        }
+        std::istringstream commands(script);
+        std::ofstream devNull("/dev/null");
+        HashTable table(101);
+        size_t records = 0;
+        Clock::time_point t0 = Clock::now();
+        std::string command, site, user, pass;
+        while (true) {
+            devNull << "\n=== SecurePass Manager ===\nCommands:\n  add     - Add new credential\n  find    - Find a password\n"
+                       "  update  - Update a password\n  delete  - Delete a credential\n  save    - Save to encrypted file\n"
+                       "  load    - Load from encrypted file\n  open    - Open a vault in journaled mode\n"
+                       "  exit    - Exit program\n--------------------------\nEnter command: ";
+            if (!std::getline(commands, command)) break;
+            devNull << "Site: ";
+            std::getline(commands, site);
+            devNull << "Username: ";
+            std::getline(commands, user);
+            devNull << "Password: ";
+            std::getline(commands, pass);
+            table.insert(Credential(site, user, pass));
+            devNull << "Credential added!\n";
+            ++records;
+        }
+        report("interactive menu loop", records, secondsSince(t0));
+    }
+    for (int run = 0; run < 3; ++run) {
+        {
+            HashTable table(101);
+            Clock::time_point t0 = Clock::now();
+            std::ifstream in(csvFile, std::ios::binary);
+            size_t records = 0;
+            for (std::string line; std::getline(in, line); ++records) table.insert(Credential::fromCSV(line));
+            report("getline + fromCSV + insert", records, secondsSince(t0));
+        }
+        HashTable table(101);
+        Clock::time_point t0 = Clock::now();
+        std::ifstream in(csvFile, std::ios::binary);
+        size_t records = 0;
+        bool ok = importCsv(table, in, &records);
+        report("importCsv (blocks, reserve)", records, secondsSince(t0));
+        if (!ok || static_cast<size_t>(table.size()) != n) std::cerr << "  warning: import lost records\n";
+
+        t0 = Clock::now();
+        std::ofstream out(csvFile + ".out", std::ios::binary | std::ios::trunc);
+        exportCsv(table, out, &records);
+        out.close();
+        report("exportCsv", records, secondsSince(t0));
+    }
+    std::remove(csvFile.c_str());
+    std::remove((csvFile + ".out").c_str());
+}
+
+// Synthetic vault for the suite: a few sites hold most accounts (Zipf, s = 1), the
+// long tail holds one or two each. Records are generated on demand from their number,
+// so 10M-entry runs do not hold a second copy of the vault.
+class SyntheticVault {
+    std::vector<uint32_t> siteOf; // Site rank of every record
+    size_t siteCount;
+public:
+    explicit SyntheticVault(size_t n) : siteOf(n), siteCount(std::max<size_t>(1, n / 8)) {
+        std::vector<double> cdf(siteCount);
+        double total = 0;
+        for (size_t r = 0; r < siteCount; ++r) cdf[r] = total += 1.0 / static_cast<double>(r + 1);
+        std::mt19937_64 rng(n);
+        std::uniform_real_distribution<double> uniform(0, total);
+        for (uint32_t& s : siteOf) {
+            s = static_cast<uint32_t>(std::upper_bound(cdf.begin(), cdf.end() - 1, uniform(rng)) - cdf.begin());
+        }
+    }
+    size_t size() const { return siteOf.size(); }
+    size_t sites() const { return siteCount; }
+
+    void site(size_t i, std::string& out) const { siteName(siteOf[i], out); }
+    static void siteName(size_t rank, std::string& out) {
+        static const char* const words[] = {"mail", "shop", "bank", "news", "cloud", "social", "games", "travel"};
+        static const char* const tlds[] = {".com", ".org", ".net", ".io", ".co.uk", ".de"};
+        out = words[rank % 8];
+        out += std::to_string(rank);
+        out += tlds[(rank / 8) % 6];
+    }
+    static void username(size_t i, std::string& out) {
+        static const char* const domains[] = {"@gmail.com", "@outlook.com", "@yahoo.com", "@proton.me"};
+        out = "user.";
+        out += std::to_string(i);
+        out += domains[i % 4];
+    }
+    // 12 to 27 printable characters
+    static void password(size_t i, std::string& out) {
+        uint64_t x = (i + 1) * 0x9E3779B97F4A7C15ull;
+        out.assign(12 + (x >> 60), ' ');
+        for (char& c : out) {
+            x ^= x >> 29;
+            x *= 0xBF58476D1CE4E5B9ull;
+            c = static_cast<char>(33 + (x >> 32) % 94);
+        }
+    }
+};
+
+// JSON object for one operation: count, throughput and latency percentiles
+std::string jsonOperation(const LatencySummary& s, double seconds) {
+    std::ostringstream out;
+    out << "{\"count\": " << s.count << ", \"ops_per_sec\": "
+        << static_cast<uint64_t>(seconds > 0 ? static_cast<double>(s.count) / seconds : 0) << ", \"mean_ns\": " << s.mean
+        << ", \"p50_ns\": " << s.p50 << ", \"p99_ns\": " << s.p99 << ", \"p999_ns\": " << s.p999
+        << ", \"max_ns\": " << s.max << "}";
+    return out.str();
+}
+
+// Results file of the suite benchmark (third command line argument)
+std::string g_resultsFile = "bench_results.json";
+
+// One suite run at one vault size; returns its JSON object
+std::string runSuite(size_t n) {
+    const std::string file = "bench_suite.bin";
+    const std::string key = "bench-key";
+    const SyntheticVault vault(n);
+    std::vector<size_t> sequential(n), shuffled(n);
+    for (size_t i = 0; i < n; ++i) sequential[i] = shuffled[i] = i;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(42));
+    std::string site, user, pw;
+    LatencyRecorder rec(n);
+    std::ostringstream json;
+    json << std::fixed << "{\"entries\": " << n << ", \"sites\": " << vault.sites() << ", \"operations\": {";
+
+    std::cout << "== suite, " << n << " entries, " << vault.sites() << " sites ==\n" << std::fixed;
+    // For every record number in `indexes`: prepare(i) builds the fields, untimed,
+    // then op(i) is timed. Throughput counts the timed calls only.
+    const char* separator = "";
+    auto measure = [&](const char* name, const std::vector<size_t>& indexes, auto prepare, auto op) {
+        Clock::duration total = Clock::duration::zero();
+        for (size_t i : indexes) {
+            prepare(i);
+            Clock::time_point t0 = Clock::now();
+            op(i);
+            Clock::duration d = Clock::now() - t0;
+            rec.add(d);
+            total += d;
+        }
+        const double seconds = std::chrono::duration<double>(total).count();
+        const LatencySummary s = rec.summarize();
+        const double perSecond = seconds > 0 ? static_cast<double>(s.count) / seconds : 0;
+        json << separator << "\"" << name << "\": " << jsonOperation(s, seconds);
+        separator = ", ";
+        std::cout << std::left << std::setw(12) << name << std::right << std::setprecision(2) << std::setw(8)
+                  << perSecond / 1e6 << " Mops/s  p50 " << std::setw(6) << s.p50 << " ns  p99 " << std::setw(7)
+                  << s.p99 << " ns  p999 " << std::setw(8) << s.p999 << " ns\n";
+    };
+    auto fields = [&](size_t i) {
+        vault.site(i, site);
+        SyntheticVault::username(i, user);
+        SyntheticVault::password(i, pw);
+    };
+
+    size_t found = 0;
+    HashTable* table = new HashTable(101);
+    measure("insert", sequential, fields, [&](size_t) { table->emplace(site, user, pw); });
+    measure("search_hit", shuffled, fields, [&](size_t) { found += table->search(site, user) != nullptr; });
+    // Half the misses are unknown accounts on known sites, half unknown sites
+    measure("search_miss", shuffled, [&](size_t i) {
+        if (i % 2 == 0) vault.site(i, site);
+        else SyntheticVault::siteName(vault.sites() + i, site);
+        SyntheticVault::username(n + i, user);
+    }, [&](size_t) { found += table->search(site, user) != nullptr; });
+    measure("update", shuffled, [&](size_t i) {
+        fields(i);
+        pw += "!";
+    }, [&](size_t) { found += table->update(site, user, pw); });
+    // The digest of every record, as the vault MACs and journal records hash small inputs
+    std::string record;
+    measure("sha256_raw", shuffled, [&](size_t i) {
+        fields(i);
+        record = site + user + pw;
+    }, [&](size_t) { found += sha256_raw(record).size() == 32; });
+    json << "}";
+
+    Clock::time_point t0 = Clock::now();
+    table->rehash(table->size() * 2);
+    const double rehash = secondsSince(t0);
+    json << ", \"rehash_ms\": " << std::setprecision(3) << rehash * 1000;
+    std::cout << "rehash      " << std::setprecision(1) << rehash * 1000 << " ms\n";
+
+    // Save and load: wall time, and the process's peak resident memory while each ran
+    const bool peakKnown = resetPeakRSS();
+    auto persistence = [&](const char* name, double seconds, size_t rss0) {
+        const size_t peak = peakKnown ? peakRSS() : 0;
+        json << ", \"" << name << "\": {\"ms\": " << std::setprecision(3) << seconds * 1000
+             << ", \"file_bytes\": " << fileSize(file) << ", \"peak_rss_bytes\": " << peak
+             << ", \"peak_extra_rss_bytes\": " << (peak > rss0 ? peak - rss0 : 0) << "}";
+        std::cout << std::left << std::setw(12) << name << std::right << std::setprecision(1) << std::setw(8)
+                  << seconds * 1000 << " ms  file " << fileSize(file) / 1e6 << " MB  peak RSS ";
+        if (peakKnown) std::cout << peak / 1e6 << " MB (+" << (peak > rss0 ? peak - rss0 : 0) / 1e6 << " MB)\n";
+        else std::cout << "not available\n";
+    };
+    trimHeap();
+    size_t rss0 = currentRSS();
+    resetPeakRSS();
+    t0 = Clock::now();
+    bool ok = table->save(file, key);
+    persistence("save", secondsSince(t0), rss0);
+    delete table;
+
+    trimHeap();
+    rss0 = currentRSS();
+    resetPeakRSS();
+    HashTable loaded(101);
+    t0 = Clock::now();
+    ok = loaded.load(file, key) && ok;
+    persistence("load", secondsSince(t0), rss0);
+    std::remove(file.c_str());
+
+    // Removes run last, against the loaded table
+    json << ", \"operations_after_load\": {";
+    separator = "";
+    measure("remove", shuffled, fields, [&](size_t) { found += loaded.remove(site, user); });
+    json << "}}";
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+
+    if (!ok || found != 4 * n || loaded.size() != 0) std::cerr << "  warning: suite lost entries at " << n << "\n";
+    return json.str();
+}
+
+// The suite: table, crypto and persistence paths on synthetic vaults of 1K entries up
+// to n by factors of 10, written to g_resultsFile as JSON for diffing between builds.
+void benchSuite(size_t n) {
+    std::vector<size_t> sizes;
+    for (size_t s = 1000; s < n; s *= 10) sizes.push_back(s);
+    sizes.push_back(std::max<size_t>(n, 1));
+
+    std::ostringstream json;
+    json << "{\n  \"benchmark\": \"suite\",\n  \"build\": {\"compiler\": \""
+#if defined(__VERSION__)
+         << __VERSION__
+#endif
+         << "\", \"sha256_kernel\": \"" << sha256_kernel_name(sha256_active_kernel())
+         << "\", \"xor_kernel\": \"" << xor_kernel_name(xor_active_kernel())
+         << "\", \"hardware_threads\": " << std::thread::hardware_concurrency() << "},\n  \"runs\": [";
+    for (size_t i = 0; i < sizes.size(); ++i) json << (i == 0 ? "\n    " : ",\n    ") << runSuite(sizes[i]);
+    json << "\n  ]\n}\n";
+
+    std::ofstream out(g_resultsFile);
+    out << json.str();
+    if (out.flush()) std::cout << "results written to " << g_resultsFile << "\n";
+    else std::cerr << "could not write " << g_resultsFile << "\n";
+}
+
+// Daemon load generator: a VaultServer on its own thread, C client threads each
+// keeping `depth` requests in flight (90% find, 10% update of random existing keys).
+// A request's latency runs from the flush that sent it to its answer.
+void benchDaemon(size_t n) {
+    const std::string socketPath = "bench_vault.sock";
+    std::vector<Credential> creds = makeCredentials(n, 4);
+    HashTable table(101);
+    table.insertBulk(creds);
+    VaultServer server(table);
+    if (!server.listen(socketPath)) {
+        std::cout << "== daemon: cannot listen on " << socketPath << " (Linux only) ==\n";
+        return;
+    }
+    std::thread loop([&] { server.run(); });
+    std::cout << "== daemon over a Unix socket, " << n << " entries, 90:10 find:update, hardware threads: "
+              << std::thread::hardware_concurrency() << " ==\n";
+
+    const size_t totalRequests = 200000;
+    const int clientCounts[] = {1, 8, 64};
+    const int depths[] = {1, 16};
+    for (int depth : depths) {
+        for (int clients : clientCounts) {
+            const size_t rounds = std::max<size_t>(1, totalRequests / (static_cast<size_t>(clients) * depth));
+            std::vector<std::vector<Clock::duration>> latencies(clients);
+            std::atomic<size_t> failures(0);
+            std::vector<std::thread> threads;
+            Clock::time_point t0 = Clock::now();
+            for (int t = 0; t < clients; ++t) {
+                threads.emplace_back([&, t] {
+                    VaultClient client;
+                    VaultClient::Response response;
+                    std::mt19937_64 rng(static_cast<uint64_t>(t) + 1);
+                    latencies[t].reserve(rounds * depth);
+                    if (!client.connect(socketPath)) {
+                        failures++;
+                        return;
+                    }
+                    for (size_t r = 0; r < rounds; ++r) {
+                        for (int d = 0; d < depth; ++d) {
+                            const Credential& c = creds[rng() % creds.size()];
+                            if (rng() % 10 == 0) client.queue(VAULT_UPDATE, c.site, c.username, c.password);
+                            else client.queue(VAULT_FIND, c.site, c.username);
+                        }
+                        const Clock::time_point sent = Clock::now();
+                        if (!client.flush()) {
+                            failures++;
+                            return;
+                        }
+                        for (int d = 0; d < depth; ++d) {
+                            if (!client.next(response) || response.status != VAULT_OK) failures++;
+                            latencies[t].push_back(Clock::now() - sent);
+                        }
+                    }
+                });
+            }
+            for (std::thread& t : threads) t.join();
+            const double seconds = secondsSince(t0);
+
+            LatencyRecorder rec(rounds * depth * clients);
+            for (const std::vector<Clock::duration>& l : latencies) {
+                for (Clock::duration d : l) rec.add(d);
+            }
+            const LatencySummary s = rec.summarize();
+            std::cout << std::fixed << std::setprecision(1) << "depth " << std::setw(2) << depth << "  clients " << std::setw(2) << clients
+                      << "  " << std::setw(8) << static_cast<long>(s.count / seconds) << " req/s"
+                      << "  p50 " << std::setw(7) << s.p50 / 1000.0 << " us"
+                      << "  p99 " << std::setw(7) << s.p99 / 1000.0 << " us"
+                      << "  p999 " << std::setw(8) << s.p999 / 1000.0 << " us\n" << std::defaultfloat;
+            if (failures != 0) std::cerr << "  warning: " << failures << " failed requests\n";
+        }
+    }
+    server.stop();
+    loop.join();
+}
+
+// Secondary indexes: every account of a site and every site of a username, through
+// the indexes vs a full scan of the table, plus what keeping the indexes costs.
+// Sites hold 4 accounts; each username is reused on 8 sites, like one email address.
+void benchIndexes(size_t n) {
+    std::vector<Credential> creds = makeCredentials(n, 4);
+    const size_t usernames = std::max<size_t>(n / 8, 4);
+    for (size_t i = 0; i < n; ++i) creds[i].username = "user" + std::to_string(i % usernames) + "@example.org";
+    std::cout << "== secondary indexes, " << n << " entries, " << (n + 3) / 4 << " sites, " << usernames
+              << " usernames ==\n" << std::fixed << std::setprecision(1);
+
+    double insertSeconds[2];
+    size_t rss[2];
+    for (int indexed = 0; indexed < 2; ++indexed) {
+        trimHeap();
+        const size_t before = currentRSS();
+        HashTable table(101);
+        table.setSecondaryIndexes(indexed != 0);
+        Clock::time_point t0 = Clock::now();
+        for (const Credential& c : creds) table.emplace(c.site, c.username, c.password);
+        insertSeconds[indexed] = secondsSince(t0);
+        rss[indexed] = currentRSS() - before;
+    }
+    std::cout << "insert                 " << insertSeconds[0] * 1e9 / n << " ns/entry plain, "
+              << insertSeconds[1] * 1e9 / n << " ns/entry indexed\n"
+              << "memory                 " << rss[0] / static_cast<double>(n) << " B/entry plain, "
+              << rss[1] / static_cast<double>(n) << " B/entry indexed\n";
+
+    HashTable table(101);
+    table.insertBulk(creds, true);
+    Clock::time_point t0 = Clock::now();
+    table.setSecondaryIndexes(true);
+    std::cout << "setSecondaryIndexes    " << secondsSince(t0) * 1e3 << " ms to index the table\n";
+
+    std::mt19937_64 rng(25);
+    size_t checksum = 0;
+    auto compare = [&](const char* what, size_t expected, auto keyOf, auto scanMatch, auto indexed) {
+        const size_t scans = 5;
+        t0 = Clock::now();
+        for (size_t q = 0; q < scans; ++q) {
+            const std::string key = keyOf(creds[rng() % n]);
+            size_t found = 0;
+            table.forEach([&](const Credential& c) { found += scanMatch(c, key); });
+            checksum += found;
+        }
+        const double scan = secondsSince(t0) / scans;
+        const size_t queries = 100000;
+        size_t results = 0;
+        t0 = Clock::now();
+        for (size_t q = 0; q < queries; ++q) {
+            const std::string key = keyOf(creds[rng() % n]);
+            for (const Credential& c : indexed(key)) results += c.password.size() != 0;
+        }
+        const double index = secondsSince(t0) / queries;
+        if (results != queries * expected) std::cerr << "  warning: " << what << " index missed entries\n";
+        std::cout << std::left << std::setw(22) << what << std::right << " scan " << std::setw(9) << scan * 1e6
+                  << " us  index " << std::setprecision(3) << std::setw(7) << index * 1e6 << " us  ("
+                  << std::setprecision(0) << scan / index << "x)\n" << std::setprecision(1);
+    };
+    compare("accounts of a site", 4, [](const Credential& c) { return std::string(c.site); },
+            [](const Credential& c, const std::string& key) { return std::string_view(c.site) == key; },
+            [&](const std::string& key) { return table.entriesForSite(key); });
+    compare("sites of a username", n / usernames, [](const Credential& c) { return std::string(c.username); },
+            [](const Credential& c, const std::string& key) { return std::string_view(c.username) == key; },
+            [&](const std::string& key) { return table.entriesForUsername(key); });
+
+    const std::string file = "bench_vault.bin";
+    const std::string key = "bench-key";
+    table.save(file, key);
+    for (int indexed = 0; indexed < 2; ++indexed) {
+        HashTable loaded(101);
+        loaded.setSecondaryIndexes(indexed != 0);
+        t0 = Clock::now();
+        loaded.load(file, key);
+        std::cout << "load()                 " << secondsSince(t0) * 1e3 << " ms " << (indexed ? "indexed" : "plain") << "\n";
+    }
+    std::remove(file.c_str());
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    if (checksum == 0) std::cerr << "  warning: scans found nothing\n";
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)(size_t n);
+    size_t defaultN;
+};
+
+const Benchmark BENCHMARKS[] = {
+    {"table", benchTable, 1000000},
+    {"bulk", benchBulk, 1000000},
+    {"memory", benchMemory, 1000000},
+    {"concurrent", benchConcurrent, 200000},
+    {"hash", benchHash, 1000000},
+    {"sha", benchSha, 16 << 20},
+    {"cipher", benchCipher, 16 << 20},
+    {"import", benchImport, 1000000},
+    {"save", benchSave, 1000000},
+    {"load", benchLoad, 1000000},
+    {"parallel-load", benchParallelLoad, 4000000},
+    {"startup", benchStartup, 1000000},
+    {"compression", benchCompression, 1000000},
+    {"journal", benchJournal, 1000000},
+    {"snapshot", benchSnapshot, 1000000},
+    {"commit", benchCommit, 100000},
+    {"lookup", benchLookup, 1000000},
+    {"daemon", benchDaemon, 1000000},
+    {"indexes", benchIndexes, 1000000},
+    {"suite", benchSuite, 1000000},
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string which = argc > 1 ? argv[1] : "all";
+    size_t n = argc > 2 ? static_cast<size_t>(std::stoull(argv[2])) : 0;
+    if (argc > 3) g_resultsFile = argv[3];
+
+    bool ran = false;
+    for (const Benchmark& b : BENCHMARKS) {
+        if (which == "all" || which == b.name) {
+            b.run(n != 0 ? n : b.defaultN);
+            ran = true;
+        }
+    }
+    if (!ran) {
+        std::cerr << "Unknown benchmark '" << which << "'. Available:";
+        for (const Benchmark& b : BENCHMARKS) std::cerr << " " << b.name;
+        std::cerr << "\n";
+        return 1;
+    }
+    return 0;
+}
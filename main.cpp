@@ -1,7 +1,13 @@
 #include <iostream>
+#include <fstream>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <csignal>
 #include "HashTable.h"
 #include "Credential.h"
+#include "CsvIO.h"
+#include "VaultServer.h"
 
 // Helper to get input cleanly
 std::string getInput(std::string prompt) {
@@ -20,11 +26,283 @@ void printMenu() {
     std::cout << "  delete  - Delete a credential\n";
     std::cout << "  save    - Save to encrypted file\n";
     std::cout << "  load    - Load from encrypted file\n";
+    std::cout << "  open    - Open a vault in journaled mode (every change is saved)\n";
     std::cout << "  exit    - Exit program\n";
     std::cout << "--------------------------\n";
 }
 
-int main() {
+void printUsage() {
+    std::cerr << "Usage:\n"
+              << "  app                               interactive menu\n"
+              << "  app batch [script]                run commands from script (default: stdin), no prompts\n"
+              << "  app import <csv> <vault> <key>    add CSV records to vault (created if missing)\n"
+              << "  app export <vault> <key> <csv>    write every record of vault as CSV\n"
+              << "  app serve <vault> <key> <socket>  serve the vault (journaled) on a Unix socket\n"
+              << "  app client <socket> find <site> [user] | add|update <site> <user> <pass> | delete <site> <user>\n"
+              << "  A csv of - means stdin (import) or stdout (export).\n";
+}
+
+// Splits a batch line into words at spaces and tabs. A word in double quotes may
+// contain spaces; words cannot contain quotes.
+std::vector<std::string_view> splitWords(std::string_view line) {
+    std::vector<std::string_view> words;
+    size_t pos = 0;
+    while (true) {
+        pos = line.find_first_not_of(" \t\r", pos);
+        if (pos == std::string_view::npos) break;
+        size_t end;
+        if (line[pos] == '"') {
+            end = line.find('"', pos + 1);
+            if (end == std::string_view::npos) end = line.size();
+            words.push_back(line.substr(pos + 1, end - pos - 1));
+            ++end;
+        } else {
+            end = std::min(line.find_first_of(" \t\r", pos), line.size());
+            words.push_back(line.substr(pos, end - pos));
+        }
+        pos = end;
+    }
+    return words;
+}
+
+// Batch mode: one command per line, with its arguments on the same line:
+//   add <site> <user> <pass>   find <site> [user]   update <site> <user> <pass>
+//   delete <site> <user>       save|load|open <file> <key>
+//   import <csv>               export <csv|->       exit
+// Blank lines and lines starting with # are skipped. find prints the credential
+// as a CSV line; errors go to stderr with their line number. Output is buffered,
+// never flushed per line. Returns the exit status: 0 if every command succeeded.
+int runBatch(std::istream& in) {
+    HashTable ht(101);
+    bool journaled = false;
+    int failures = 0;
+    size_t lineNumber = 0;
+    std::string line;
+    std::string out;
+    auto fail = [&](const std::string& message) {
+        std::cerr << "line " << lineNumber << ": " << message << '\n';
+        ++failures;
+    };
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        const std::vector<std::string_view> words = splitWords(line);
+        if (words.empty() || words[0][0] == '#') continue;
+        const std::string_view command = words[0];
+        const size_t args = words.size() - 1;
+        auto usage = [&](size_t min, size_t max, const char* form) {
+            if (args >= min && args <= max) return true;
+            fail("usage: " + std::string(form));
+            return false;
+        };
+
+        if (command == "exit" || command == "quit") {
+            break;
+        } else if (command == "add") {
+            if (usage(3, 3, "add <site> <user> <pass>")) ht.emplace(words[1], words[2], words[3]);
+        } else if (command == "find") {
+            if (!usage(1, 2, "find <site> [user]")) continue;
+            Credential* result = ht.search(words[1], args == 2 ? words[2] : std::string_view());
+            if (result == nullptr) {
+                fail("not found");
+                continue;
+            }
+            out.clear();
+            result->appendCSV(out);
+            out += '\n';
+            std::cout << out;
+        } else if (command == "update") {
+            if (usage(3, 3, "update <site> <user> <pass>") && !ht.update(words[1], words[2], words[3])) {
+                fail("not found");
+            }
+        } else if (command == "delete") {
+            if (usage(2, 2, "delete <site> <user>") && !ht.remove(words[1], words[2])) fail("not found");
+        } else if (command == "save" || command == "load" || command == "open") {
+            if (!usage(2, 2, "save|load|open <file> <key>")) continue;
+            const std::string file(words[1]);
+            bool ok;
+            if (command == "save") {
+                ok = ht.save(file, words[2]);
+            } else if (command == "load") {
+                ok = ht.load(file, words[2]);
+                if (ok) journaled = false;
+            } else {
+                ok = ht.openJournal(file, words[2]);
+                journaled = journaled || ok;
+            }
+            if (!ok) fail("cannot " + std::string(command) + " " + file);
+        } else if (command == "import") {
+            if (!usage(1, 1, "import <csv>")) continue;
+            std::ifstream csv(std::string(words[1]), std::ios::binary);
+            size_t badLine = 0;
+            if (!csv.is_open()) {
+                fail("cannot open " + std::string(words[1]));
+            } else if (!importCsv(ht, csv, nullptr, &badLine)) {
+                fail("import failed at " + std::string(words[1]) + " line " + std::to_string(badLine));
+            }
+        } else if (command == "export") {
+            if (!usage(1, 1, "export <csv|->")) continue;
+            bool ok;
+            if (words[1] == "-") {
+                ok = exportCsv(ht, std::cout);
+            } else {
+                std::ofstream csv(std::string(words[1]), std::ios::binary | std::ios::trunc);
+                ok = csv.is_open() && exportCsv(ht, csv);
+            }
+            if (!ok) fail("cannot export to " + std::string(words[1]));
+        } else {
+            fail("unknown command '" + std::string(command) + "'");
+        }
+    }
+    // Journaled changes are on disk once their log is synced
+    if (journaled && !ht.commit().get()) fail("cannot sync the journal");
+    std::cout.flush();
+    return failures == 0 ? 0 : 1;
+}
+
+// app import <csv> <vault> <key>: loads the vault if it exists, streams the CSV
+// into it through importCsv and saves it
+int runImport(const std::string& csvName, const std::string& vault, const std::string& key) {
+    HashTable ht(101);
+    if (std::ifstream(vault).good() && !ht.load(vault, key)) {
+        std::cerr << "Error loading " << vault << " (File invalid or wrong key).\n";
+        return 1;
+    }
+    std::ifstream file;
+    if (csvName != "-") {
+        file.open(csvName, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Cannot open " << csvName << "\n";
+            return 1;
+        }
+    }
+    size_t records = 0, badLine = 0;
+    if (!importCsv(ht, csvName == "-" ? std::cin : file, &records, &badLine)) {
+        std::cerr << "Import failed at line " << badLine << " of " << csvName << "; vault not changed.\n";
+        return 1;
+    }
+    if (!ht.save(vault, key)) {
+        std::cerr << "Error saving " << vault << "\n";
+        return 1;
+    }
+    std::cout << "Imported " << records << " records; " << vault << " holds " << ht.size() << ".\n";
+    return 0;
+}
+
+// app export <vault> <key> <csv>
+int runExport(const std::string& vault, const std::string& key, const std::string& csvName) {
+    HashTable ht(101);
+    if (!ht.load(vault, key)) {
+        std::cerr << "Error loading " << vault << " (File invalid or wrong key).\n";
+        return 1;
+    }
+    bool ok;
+    if (csvName == "-") {
+        ok = exportCsv(ht, std::cout);
+    } else {
+        std::ofstream file(csvName, std::ios::binary | std::ios::trunc);
+        ok = file.is_open() && exportCsv(ht, file);
+    }
+    if (!ok) {
+        std::cerr << "Error writing " << csvName << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+VaultServer* activeServer = nullptr;
+
+void stopServer(int) {
+    if (activeServer != nullptr) activeServer->stop();
+}
+
+// app serve <vault> <key> <socket>: opens the vault in journaled mode, so every
+// change a client makes is logged, and serves it until SIGINT or SIGTERM
+int runServe(const std::string& vault, const std::string& key, const std::string& socketPath) {
+    HashTable ht(101);
+    if (!ht.openJournal(vault, key)) {
+        std::cerr << "Error opening " << vault << " (File invalid or wrong key).\n";
+        return 1;
+    }
+    // Site and username queries become index lookups. The server commits once per
+    // round of events, which already batches the changes, so commits need no window.
+    ht.setSecondaryIndexes(true);
+    ht.setCommitWindow(std::chrono::microseconds(0));
+    VaultServer server(ht);
+    if (!server.listen(socketPath)) {
+        std::cerr << "Cannot listen on " << socketPath << "\n";
+        return 1;
+    }
+    activeServer = &server;
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+    std::cerr << "Serving " << ht.size() << " records on " << socketPath << "\n";
+    const bool ok = server.run();
+    activeServer = nullptr;
+    std::cerr << "Served " << server.requestsServed() << " requests\n";
+    if (!ht.commit().get()) {
+        std::cerr << "Error syncing the journal of " << vault << "\n";
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
+
+// app client <socket> <command> <args>: one request, with the batch mode's commands
+int runClient(int argc, char** argv) {
+    const std::string command = argv[3];
+    const int args = argc - 4;
+    VaultOp op;
+    if (command == "find" && (args == 1 || args == 2)) {
+        op = VAULT_FIND;
+    } else if ((command == "add" || command == "update") && args == 3) {
+        op = command == "add" ? VAULT_ADD : VAULT_UPDATE;
+    } else if (command == "delete" && args == 2) {
+        op = VAULT_DELETE;
+    } else {
+        printUsage();
+        return 1;
+    }
+    VaultClient client;
+    if (!client.connect(argv[2])) {
+        std::cerr << "Cannot connect to " << argv[2] << "\n";
+        return 1;
+    }
+    VaultClient::Response response;
+    if (!client.call(op, argv[4], args >= 2 ? argv[5] : "", args == 3 ? argv[6] : "", response)) {
+        std::cerr << "Request failed\n";
+        return 1;
+    }
+    if (response.status != VAULT_OK) {
+        std::cerr << (response.status == VAULT_NOT_FOUND ? "not found" : "bad request") << "\n";
+        return 1;
+    }
+    if (op == VAULT_FIND) {
+        std::cout << Credential(response.site, response.username, response.password).toCSV() << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        // Scripted use: stdio is not shared with C code, so iostreams buffer freely
+        std::ios::sync_with_stdio(false);
+        const std::string mode = argv[1];
+        if (mode == "batch" && argc <= 3) {
+            if (argc == 2 || std::string(argv[2]) == "-") return runBatch(std::cin);
+            std::ifstream script(argv[2]);
+            if (!script.is_open()) {
+                std::cerr << "Cannot open " << argv[2] << "\n";
+                return 1;
+            }
+            return runBatch(script);
+        }
+        if (mode == "import" && argc == 5) return runImport(argv[2], argv[3], argv[4]);
+        if (mode == "export" && argc == 5) return runExport(argv[2], argv[3], argv[4]);
+        if (mode == "serve" && argc == 5) return runServe(argv[2], argv[3], argv[4]);
+        if (mode == "client" && argc >= 5) return runClient(argc, argv);
+        printUsage();
+        return 1;
+    }
+
     HashTable ht(101); // Initial capacity
     std::string command;
     std::string fileKey = "default"; // Key used for encryption
@@ -99,6 +377,15 @@ int main() {
                 std::cout << "Error loading file (File invalid or wrong key).\n";
             }
         }
+        else if (command == "open") {
+            std::string fname = getInput("Enter vault filename (created if missing): ");
+            std::string key = getInput("Enter secure key: ");
+            if (ht.openJournal(fname, key)) {
+                std::cout << "Vault open. Changes are logged to " << fname << ".log as you make them.\n";
+            } else {
+                std::cout << "Error opening vault (File invalid or wrong key).\n";
+            }
+        }
         else {
             std::cout << "Unknown command. Try again.\n";
         }
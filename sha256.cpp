@@ -1,11 +1,21 @@
 #include "sha256.h"
-#include <vector>
+#include <algorithm>
 #include <cstring>
 #include <sstream>
 #include <iomanip>
+#include <atomic>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define SHA256_X86 0
+#endif
 
 // Small, public-domain style SHA-256 implementation adapted for embedding.
-// Produces raw 32-byte binary digest.
+// Produces raw 32-byte binary digest, either one-shot or through the Sha256 context.
+// The compression function has a SHA-NI version, compiled with a per-function
+// target attribute and selected at run time.
 
 namespace {
     inline uint32_t rotr(uint32_t x, uint32_t n) { return (x >> n) | (x << (32 - n)); }
@@ -69,51 +79,243 @@ namespace {
         H[6] += g;
         H[7] += h;
     }
-}
 
-std::string sha256_raw(const std::string &data) {
-    uint64_t bitlen = static_cast<uint64_t>(data.size()) * 8ULL;
-    // Initial hash values
-    uint32_t H[8] = {
-        0x6a09e667,
-        0xbb67ae85,
-        0x3c6ef372,
-        0xa54ff53a,
-        0x510e527f,
-        0x9b05688c,
-        0x1f83d9ab,
-        0x5be0cd19
+    void blocks_scalar(uint32_t H[8], const unsigned char* data, size_t blocks) {
+        for (; blocks > 0; --blocks, data += 64) process_block(data, H);
+    }
+
+    const uint32_t INITIAL[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
     };
 
-    // Prepare the message: pad
-    std::vector<unsigned char> msg(data.begin(), data.end());
-    // append 0x80
-    msg.push_back(0x80);
-    // append zeros until message length in bits ≡ 448 mod 512 => bytes ≡ 56 mod 64
-    while ((msg.size() % 64) != 56) msg.push_back(0x00);
-    // append big-endian 64-bit length
-    for (int i = 7; i >= 0; --i) {
-        msg.push_back(static_cast<unsigned char>((bitlen >> (i*8)) & 0xff));
+    inline uint32_t load_be32(const unsigned char* p) {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
     }
 
-    // process blocks
-    for (size_t offset = 0; offset < msg.size(); offset += 64) {
-        process_block(&msg[offset], H);
+    inline void store_be32(unsigned char* p, uint32_t v) {
+        p[0] = static_cast<unsigned char>(v >> 24);
+        p[1] = static_cast<unsigned char>(v >> 16);
+        p[2] = static_cast<unsigned char>(v >> 8);
+        p[3] = static_cast<unsigned char>(v);
     }
 
-    // produce digest
-    std::string digest;
-    digest.resize(32);
-    for (int i = 0; i < 8; ++i) {
-        digest[i*4]     = static_cast<char>((H[i] >> 24) & 0xff);
-        digest[i*4 + 1] = static_cast<char>((H[i] >> 16) & 0xff);
-        digest[i*4 + 2] = static_cast<char>((H[i] >> 8) & 0xff);
-        digest[i*4 + 3] = static_cast<char>((H[i]) & 0xff);
+    // Last one or two blocks of a message: the leftover bytes, 0x80, zeros and the
+    // big-endian bit length. Returns the number of blocks written to tail (1 or 2).
+    size_t pad_tail(const unsigned char* rest, size_t restLen, uint64_t totalLen, unsigned char tail[128]) {
+        size_t blocks = restLen + 9 > 64 ? 2 : 1;
+        std::memset(tail, 0, blocks * 64);
+        std::memcpy(tail, rest, restLen);
+        tail[restLen] = 0x80;
+        const uint64_t bitlen = totalLen * 8ULL;
+        for (int i = 0; i < 8; ++i) {
+            tail[blocks * 64 - 1 - i] = static_cast<unsigned char>((bitlen >> (i * 8)) & 0xff);
+        }
+        return blocks;
     }
+
+#if SHA256_X86
+    // SHA-NI: sha256rnds2 does two rounds on state kept as (ABEF, CDGH);
+    // sha256msg1/msg2 compute the message schedule four words at a time.
+#define SHANI_ROUNDS(w, i)                                                                    \
+    MSG = _mm_add_epi32(w, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&K[4 * (i)]))); \
+    STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);                                     \
+    MSG = _mm_shuffle_epi32(MSG, 0x0E);                                                      \
+    STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG)
+#define SHANI_NEXT(cur, prev, next) \
+    next = _mm_sha256msg2_epu32(_mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4)), cur)
+
+    __attribute__((target("sha,sse4.1,ssse3")))
+    void blocks_shani(uint32_t H[8], const unsigned char* data, size_t blocks) {
+        const __m128i BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        __m128i TMP = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&H[0]));
+        __m128i STATE1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&H[4]));
+        TMP = _mm_shuffle_epi32(TMP, 0xB1);          // CDAB
+        STATE1 = _mm_shuffle_epi32(STATE1, 0x1B);    // EFGH
+        __m128i STATE0 = _mm_alignr_epi8(TMP, STATE1, 8); // ABEF
+        STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0); // CDGH
+
+        for (; blocks > 0; --blocks, data += 64) {
+            const __m128i ABEF_SAVE = STATE0;
+            const __m128i CDGH_SAVE = STATE1;
+            __m128i MSG;
+            __m128i MSG0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), BSWAP);
+            __m128i MSG1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), BSWAP);
+            __m128i MSG2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), BSWAP);
+            __m128i MSG3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), BSWAP);
+
+            SHANI_ROUNDS(MSG0, 0);
+            SHANI_ROUNDS(MSG1, 1);  MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+            SHANI_ROUNDS(MSG2, 2);  MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+            SHANI_ROUNDS(MSG3, 3);  SHANI_NEXT(MSG3, MSG2, MSG0); MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+            SHANI_ROUNDS(MSG0, 4);  SHANI_NEXT(MSG0, MSG3, MSG1); MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+            SHANI_ROUNDS(MSG1, 5);  SHANI_NEXT(MSG1, MSG0, MSG2); MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+            SHANI_ROUNDS(MSG2, 6);  SHANI_NEXT(MSG2, MSG1, MSG3); MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+            SHANI_ROUNDS(MSG3, 7);  SHANI_NEXT(MSG3, MSG2, MSG0); MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+            SHANI_ROUNDS(MSG0, 8);  SHANI_NEXT(MSG0, MSG3, MSG1); MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+            SHANI_ROUNDS(MSG1, 9);  SHANI_NEXT(MSG1, MSG0, MSG2); MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+            SHANI_ROUNDS(MSG2, 10); SHANI_NEXT(MSG2, MSG1, MSG3); MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+            SHANI_ROUNDS(MSG3, 11); SHANI_NEXT(MSG3, MSG2, MSG0); MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+            SHANI_ROUNDS(MSG0, 12); SHANI_NEXT(MSG0, MSG3, MSG1); MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+            SHANI_ROUNDS(MSG1, 13); SHANI_NEXT(MSG1, MSG0, MSG2);
+            SHANI_ROUNDS(MSG2, 14); SHANI_NEXT(MSG2, MSG1, MSG3);
+            SHANI_ROUNDS(MSG3, 15);
+
+            STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+            STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+        }
+
+        TMP = _mm_shuffle_epi32(STATE0, 0x1B);       // FEBA
+        STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);    // DCHG
+        STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0); // DCBA
+        STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);    // HGFE
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&H[0]), STATE0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&H[4]), STATE1);
+    }
+#undef SHANI_ROUNDS
+#undef SHANI_NEXT
+#endif
+
+    bool cpuHasShaNi() {
+#if SHA256_X86
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+        const bool ssse3 = (ecx & (1u << 9)) != 0;
+        const bool sse41 = (ecx & (1u << 19)) != 0;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+        return ssse3 && sse41 && (ebx & (1u << 29)) != 0;
+#else
+        return false;
+#endif
+    }
+
+    // -1 until the first hash picks the best kernel this CPU supports
+    std::atomic<int> activeKernel(-1);
+
+    Sha256Kernel currentKernel() {
+        int k = activeKernel.load(std::memory_order_relaxed);
+        if (k < 0) {
+            k = cpuHasShaNi() ? SHA256_KERNEL_SHANI : SHA256_KERNEL_SCALAR;
+            activeKernel.store(k, std::memory_order_relaxed);
+        }
+        return static_cast<Sha256Kernel>(k);
+    }
+
+    // Runs the compression function over whole blocks with the active single-message kernel
+    inline void process_blocks(uint32_t H[8], const unsigned char* data, size_t blocks) {
+#if SHA256_X86
+        if (currentKernel() == SHA256_KERNEL_SHANI) {
+            blocks_shani(H, data, blocks);
+            return;
+        }
+#endif
+        blocks_scalar(H, data, blocks);
+    }
+}
+
+bool sha256_kernel_supported(Sha256Kernel kernel) {
+    switch (kernel) {
+    case SHA256_KERNEL_SCALAR: return true;
+    case SHA256_KERNEL_SHANI: return cpuHasShaNi();
+    }
+    return false;
+}
+
+Sha256Kernel sha256_active_kernel() {
+    return currentKernel();
+}
+
+const char* sha256_kernel_name(Sha256Kernel kernel) {
+    switch (kernel) {
+    case SHA256_KERNEL_SCALAR: return "scalar";
+    case SHA256_KERNEL_SHANI: return "sha-ni";
+    }
+    return "unknown";
+}
+
+bool sha256_use_kernel(Sha256Kernel kernel) {
+    if (!sha256_kernel_supported(kernel)) return false;
+    activeKernel.store(kernel, std::memory_order_relaxed);
+    return true;
+}
+
+void Sha256::init() {
+    std::memcpy(state, INITIAL, sizeof(state));
+    bufferLen = 0;
+    totalLen = 0;
+}
+
+void Sha256::update(const void* data, size_t len) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    totalLen += len;
+
+    // Top up a pending partial block first
+    if (bufferLen > 0) {
+        size_t take = std::min(len, BLOCK_SIZE - bufferLen);
+        std::memcpy(buffer + bufferLen, p, take);
+        bufferLen += take;
+        p += take;
+        len -= take;
+        if (bufferLen < BLOCK_SIZE) return;
+        process_blocks(state, buffer, 1);
+        bufferLen = 0;
+    }
+    // Whole blocks are hashed in place, in one kernel call
+    size_t blocks = len / BLOCK_SIZE;
+    if (blocks > 0) {
+        process_blocks(state, p, blocks);
+        p += blocks * BLOCK_SIZE;
+        len -= blocks * BLOCK_SIZE;
+    }
+    std::memcpy(buffer, p, len);
+    bufferLen = len;
+}
+
+void Sha256::final(unsigned char out[DIGEST_SIZE]) {
+    // append 0x80, zeros and the big-endian 64-bit bit length
+    unsigned char tail[128];
+    size_t blocks = pad_tail(buffer, bufferLen, totalLen, tail);
+    process_blocks(state, tail, blocks);
+
+    for (int i = 0; i < 8; ++i) store_be32(out + i * 4, state[i]);
+}
+
+HmacSha256::HmacSha256(std::string_view key) {
+    // Keys longer than a block are replaced by their digest; shorter ones are zero padded
+    unsigned char k[Sha256::BLOCK_SIZE] = {0};
+    if (key.size() > Sha256::BLOCK_SIZE) {
+        Sha256 keyHash;
+        keyHash.update(key);
+        keyHash.final(k);
+    } else {
+        std::memcpy(k, key.data(), key.size());
+    }
+
+    unsigned char pad[Sha256::BLOCK_SIZE];
+    for (size_t i = 0; i < Sha256::BLOCK_SIZE; ++i) pad[i] = static_cast<unsigned char>(k[i] ^ 0x36);
+    innerStart.update(pad, sizeof(pad));
+    for (size_t i = 0; i < Sha256::BLOCK_SIZE; ++i) pad[i] = static_cast<unsigned char>(k[i] ^ 0x5c);
+    outerStart.update(pad, sizeof(pad));
+    inner = innerStart;
+}
+
+void HmacSha256::final(unsigned char out[Sha256::DIGEST_SIZE]) {
+    unsigned char innerDigest[Sha256::DIGEST_SIZE];
+    inner.final(innerDigest);
+    Sha256 outer = outerStart;
+    outer.update(innerDigest, sizeof(innerDigest));
+    outer.final(out);
+}
+
+std::string sha256_raw(std::string_view data) {
+    Sha256 ctx;
+    ctx.update(data);
+    std::string digest(Sha256::DIGEST_SIZE, '\0');
+    ctx.final(reinterpret_cast<unsigned char*>(&digest[0]));
     return digest;
 }
 
-std::string sha256_hex(const std::string &data) {
+std::string sha256_hex(std::string_view data) {
     std::string raw = sha256_raw(data);
     std::ostringstream oss;
     for (unsigned char c : raw) {
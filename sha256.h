@@ -2,11 +2,67 @@
 #define SHA256_H
 
 #include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Streaming SHA-256 context: init(), any number of update() calls, then final().
+// Input is hashed straight from the caller's buffer; only a partial block
+// (at most 63 bytes) is ever kept, so memory use does not depend on input size.
+class Sha256 {
+public:
+    static const size_t DIGEST_SIZE = 32;
+    static const size_t BLOCK_SIZE = 64;
+
+    Sha256() { init(); }
+
+    void init();
+    void update(const void* data, size_t len);
+    void update(std::string_view data) { update(data.data(), data.size()); }
+    // Writes the 32-byte digest to out. The context must be init()ed before reuse.
+    void final(unsigned char out[DIGEST_SIZE]);
+
+private:
+    uint32_t state[8];
+    unsigned char buffer[BLOCK_SIZE]; // Pending bytes of an incomplete block
+    size_t bufferLen;
+    uint64_t totalLen;                // Bytes hashed so far
+};
+
+// Streaming HMAC-SHA256. The key is absorbed once: the contexts after hashing
+// the inner and outer pad blocks are kept, so every MAC starts from a copy of
+// them instead of rehashing the key.
+class HmacSha256 {
+public:
+    explicit HmacSha256(std::string_view key);
+
+    void init() { inner = innerStart; } // Start a new MAC with the same key
+    void update(const void* data, size_t len) { inner.update(data, len); }
+    void update(std::string_view data) { inner.update(data); }
+    void final(unsigned char out[Sha256::DIGEST_SIZE]);
+
+private:
+    Sha256 innerStart; // State after key ^ ipad
+    Sha256 outerStart; // State after key ^ opad
+    Sha256 inner;
+};
+
+// Block kernels, picked at first use from CPUID:
+//   SHA256_KERNEL_SHANI   x86 SHA extensions
+//   SHA256_KERNEL_SCALAR  portable C++, used everywhere else
+enum Sha256Kernel { SHA256_KERNEL_SCALAR, SHA256_KERNEL_SHANI };
+
+bool sha256_kernel_supported(Sha256Kernel kernel);
+Sha256Kernel sha256_active_kernel();
+const char* sha256_kernel_name(Sha256Kernel kernel);
+// Forces a kernel (for tests and benchmarks); false if this CPU lacks it.
+// Not synchronised with hashing running on other threads.
+bool sha256_use_kernel(Sha256Kernel kernel);
 
 // Returns the raw 32-byte binary SHA-256 digest of input data.
-std::string sha256_raw(const std::string &data);
+std::string sha256_raw(std::string_view data);
 
 // Convenience: return hex string (not used by HMAC, but available)
-std::string sha256_hex(const std::string &data);
+std::string sha256_hex(std::string_view data);
 
 #endif
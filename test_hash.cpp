@@ -1,10 +1,65 @@
 #include <iostream>
 #include <cstdio>
 #include <string>
+#include <map>
+#include <set>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <memory_resource>
 #include "HashTable.h"
+#include "ConcurrentHashTable.h"
 #include "HashNode.h"
 #include "sha256.h"
 #include "Credential.h"
+#include "CommitScheduler.h"
+#include "LzCodec.h"
+#include "StreamCipher.h"
+#include "CsvIO.h"
+#include "VaultServer.h"
+
+// Counts global allocations so the lookup path can be checked for heap traffic
+static std::atomic<size_t> g_allocations(0); // Atomic: worker threads allocate too
+
+void* operator new(size_t n) {
+    g_allocations++;
+    void* p = std::malloc(n != 0 ? n : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// Counts the bytes a memory resource holds from the heap, and the blocks handed
+// back that still hold `secret`
+class CountingResource : public std::pmr::memory_resource {
+public:
+    size_t outstanding = 0;
+    std::string_view secret;
+    size_t secretsFreed = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override {
+        outstanding += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+        outstanding -= bytes;
+        if (!secret.empty() && std::string_view(static_cast<const char*>(p), bytes).find(secret) != std::string_view::npos) {
+            ++secretsFreed;
+        }
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
 
 int main() {
     const std::string fname = "test_data.bin";
@@ -24,6 +79,47 @@ int main() {
     if (!ht.remove("b.com", "bob")) { std::cerr << "FAIL: remove bob\n"; return 1; }
     if (ht.search("b.com", "bob")) { std::cerr << "FAIL: bob still present after remove\n"; return 1; }
 
+    // Long-running churn: replaced passwords, removed entries and the string copies
+    // made for background saves give their bytes back, so once warm, rounds of
+    // updates, remove+insert and saves take no more memory from upstream
+    {
+        CountingResource upstream;
+        std::pmr::memory_resource* previous = std::pmr::set_default_resource(&upstream);
+        HashTable churn(4096); // Its string pool draws from the default resource
+        std::pmr::set_default_resource(previous);
+        const std::string longer(200, 'p'), shorter(40, 'q');
+        const std::string churnFile = "test_churn.bin";
+        for (int i = 0; i < 1000; ++i) churn.emplace("c" + std::to_string(i) + ".com", "user", longer);
+        size_t warm = 0;
+        for (int round = 0; round < 50; ++round) {
+            if (round == 2) warm = upstream.outstanding;
+            std::shared_future<bool> saved = churn.saveInBackground(churnFile, key);
+            for (int i = 0; i < 1000; ++i) {
+                const std::string site = "c" + std::to_string(i) + ".com";
+                churn.update(site, "user", round % 2 ? longer : shorter);
+                if (i % 4 == 0) {
+                    churn.remove(site, "user");
+                    churn.emplace(site, "user", std::string(40 + (round * 7 + i) % 300, 'r'));
+                }
+            }
+            saved.get();
+        }
+        std::remove(churnFile.c_str());
+        if (upstream.outstanding > warm * 2) {
+            std::cerr << "FAIL: churn grew the string storage from " << warm << " to " << upstream.outstanding << " bytes\n";
+            return 1;
+        }
+
+        // A shorter password overwrites the old one in its buffer, and the old tail is zeroed
+        Credential* churned = churn.search("c7.com", "user");
+        const char* buffer = churned->password.data();
+        churn.update("c7.com", "user", longer);
+        churn.update("c7.com", "user", "x");
+        bool zeroed = churned->password == "x" && churned->password.data() == buffer;
+        for (size_t i = 1; i < longer.size() && zeroed; ++i) zeroed = buffer[i] == '\0';
+        if (!zeroed) { std::cerr << "FAIL: old password bytes not zeroed\n"; return 1; }
+    }
+
     // Save to file
     if (!ht.save(fname, key)) { std::cerr << "FAIL: save failed\n"; return 1; }
 
@@ -44,6 +140,1456 @@ int main() {
     std::cout << "Note: OpenSSL not available; skipping wrong-key integrity test.\n";
 #endif
 
+    // Randomised insert/remove/search against std::map (exercises overflow counts and slot reuse)
+    {
+        HashTable big(11);
+        std::map<std::pair<std::string, std::string>, std::string> model;
+        std::mt19937 rng(1234);
+        for (int step = 0; step < 20000; ++step) {
+            std::string site = "s" + std::to_string(rng() % 300) + ".com";
+            std::string user = "u" + std::to_string(rng() % 8);
+            int op = static_cast<int>(rng() % 3);
+            if (op == 0) {
+                std::string pass = "p" + std::to_string(step);
+                big.insert(Credential(site, user, pass));
+                model[std::make_pair(site, user)] = pass;
+            } else if (op == 1) {
+                bool removed = big.remove(site, user);
+                if (removed != (model.erase(std::make_pair(site, user)) == 1)) { std::cerr << "FAIL: remove mismatch\n"; return 1; }
+            } else {
+                Credential* found = big.search(site, user);
+                auto it = model.find(std::make_pair(site, user));
+                if ((found != nullptr) != (it != model.end()) || (found && found->password != it->second)) {
+                    std::cerr << "FAIL: search mismatch for " << site << "/" << user << "\n"; return 1;
+                }
+            }
+        }
+        for (const auto& entry : model) {
+            Credential* found = big.search(entry.first.first, entry.first.second);
+            if (!found || found->password != entry.second) { std::cerr << "FAIL: entry lost after churn\n"; return 1; }
+        }
+    }
+
+    // Bulk insert: presized, duplicates within the range update instead of repeating
+    {
+        std::vector<Credential> batch;
+        for (int i = 0; i < 5000; ++i) batch.push_back(Credential("bulk" + std::to_string(i) + ".com", "u", "p" + std::to_string(i)));
+        HashTable bulk(11);
+        bulk.reserve(5000);
+        bulk.insertBulk(batch, true);
+        batch.push_back(Credential("bulk7.com", "u", "changed"));
+        HashTable checked(11);
+        checked.insertBulk(batch);
+        for (int i = 0; i < 5000; i += 499) {
+            std::string site = "bulk" + std::to_string(i) + ".com";
+            Credential* a = bulk.search(site, "u");
+            Credential* b = checked.search(site, "u");
+            if (!a || !b || a->password != "p" + std::to_string(i)) { std::cerr << "FAIL: bulk insert lost " << site << "\n"; return 1; }
+        }
+        Credential* dup = checked.search("bulk7.com", "u");
+        if (!dup || dup->password != "changed") { std::cerr << "FAIL: bulk insert did not update duplicate\n"; return 1; }
+    }
+
+    // parseCSV (used by load) must split lines exactly like fromCSV
+    {
+        const std::string lines[] = {"\"a.com\",\"bob\",\"pw\"", "\"a.com\",\"bob\"", "junk \"x\" , \"y\",\"z\" tail", "\"only", "", "\"\",\"\",\"\""};
+        for (const std::string& line : lines) {
+            Credential parsed = Credential::fromCSV(line);
+            std::string_view s, u, p;
+            Credential::parseCSV(line, s, u, p);
+            if (s != std::string_view(parsed.site) || u != std::string_view(parsed.username) || p != std::string_view(parsed.password)) {
+                std::cerr << "FAIL: parseCSV differs from fromCSV on: " << line << "\n"; return 1;
+            }
+        }
+        std::string_view s, u, p;
+        Credential::parseCSV("\"a.com\",\"bob\",\"pw\"", s, u, p);
+        if (s != "a.com" || u != "bob" || p != "pw") { std::cerr << "FAIL: parseCSV fields\n"; return 1; }
+    }
+
+    // SPASSv02 round-trip fuzz: fields of arbitrary bytes (quotes, newlines, NULs,
+    // empty, long enough for multi-byte length prefixes) come back exactly
+    {
+        std::mt19937 rng(12);
+        auto randomBytes = [&rng](size_t maxLen) {
+            std::string out(rng() % (maxLen + 1), '\0');
+            const char special[] = {'"', '\n', '\0', ',', '\r', '\\'};
+            for (char& c : out) c = (rng() % 4 == 0) ? special[rng() % sizeof(special)] : static_cast<char>(rng());
+            return out;
+        };
+        for (int round = 0; round < 5; ++round) {
+            std::map<std::pair<std::string, std::string>, std::string> expected;
+            HashTable original(11);
+            for (int i = 0; i < 3000; ++i) {
+                std::string site = randomBytes(40) + std::to_string(i);
+                std::string user = randomBytes(20);
+                std::string pass = randomBytes(i % 50 == 0 ? 400 : 60);
+                original.emplace(site, user, pass);
+                expected[std::make_pair(site, user)] = pass;
+            }
+            std::string fileKey = randomBytes(40) + "k";
+            if (!original.save(fname, fileKey)) { std::cerr << "FAIL: v02 save\n"; return 1; }
+            HashTable loaded(11);
+            if (!loaded.load(fname, fileKey) || loaded.size() != static_cast<int>(expected.size())) {
+                std::cerr << "FAIL: v02 round-trip size\n"; return 1;
+            }
+            size_t mismatches = 0;
+            loaded.forEach([&](const Credential& c) {
+                auto it = expected.find(std::make_pair(std::string(c.site), std::string(c.username)));
+                if (it == expected.end() || it->second != std::string_view(c.password)) mismatches++;
+            });
+            if (mismatches != 0) { std::cerr << "FAIL: v02 round-trip altered " << mismatches << " records\n"; return 1; }
+
+            // Any flipped byte or truncation must be rejected, leaving the table empty
+            std::ifstream in(fname, std::ios::binary);
+            std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            in.close();
+            for (int flip = 0; flip < 20; ++flip) {
+                std::string damaged = bytes;
+                if (flip % 4 == 3) damaged.resize(rng() % damaged.size());
+                else damaged[rng() % damaged.size()] ^= static_cast<char>(1 + rng() % 255);
+                std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+                out.write(damaged.data(), static_cast<std::streamsize>(damaged.size()));
+                out.close();
+                if (damaged.empty()) continue; // An empty file is a valid empty vault
+                if (loaded.load(fname, fileKey) || loaded.size() != 0) { std::cerr << "FAIL: damaged v02 file accepted\n"; return 1; }
+            }
+        }
+    }
+
+    // Parallel load: any thread count rebuilds the same table, and the result stays a
+    // valid index (every entry reachable, removable, and new inserts still work)
+    {
+        HashTable source(11);
+        for (int i = 0; i < 60000; ++i) {
+            source.emplace("par" + std::to_string(i) + ".example.com", "user" + std::to_string(i % 3), "secret-" + std::to_string(i));
+        }
+        if (!source.save(fname, key)) { std::cerr << "FAIL: save for parallel load\n"; return 1; }
+        const int threadCounts[] = {1, 2, 3, 8, 0};
+        for (int threads : threadCounts) {
+            HashTable loaded(11);
+            if (!loaded.load(fname, key, threads) || loaded.size() != 60000) { std::cerr << "FAIL: parallel load (" << threads << " threads)\n"; return 1; }
+            int histogramTotal = 0;
+            for (int n : loaded.probeLengthHistogram()) histogramTotal += n;
+            if (histogramTotal != 60000) { std::cerr << "FAIL: parallel load index holds " << histogramTotal << " entries\n"; return 1; }
+            for (int i = 0; i < 60000; ++i) {
+                Credential* c = loaded.search("par" + std::to_string(i) + ".example.com", "user" + std::to_string(i % 3));
+                if (!c || std::string(c->password) != "secret-" + std::to_string(i)) { std::cerr << "FAIL: parallel load lost entry " << i << "\n"; return 1; }
+            }
+            if (loaded.search("par1.example.com", "user0")) { std::cerr << "FAIL: parallel load invented an entry\n"; return 1; }
+            for (int i = 0; i < 60000; i += 2) {
+                if (!loaded.remove("par" + std::to_string(i) + ".example.com", "user" + std::to_string(i % 3))) { std::cerr << "FAIL: remove after parallel load\n"; return 1; }
+            }
+            for (int i = 0; i < 20000; ++i) loaded.emplace("new" + std::to_string(i), "u", "p");
+            for (int i = 1; i < 60000; i += 2) {
+                if (!loaded.search("par" + std::to_string(i) + ".example.com", "user" + std::to_string(i % 3))) { std::cerr << "FAIL: entry lost after churn on loaded table\n"; return 1; }
+            }
+            if (loaded.size() != 50000) { std::cerr << "FAIL: size after churn on loaded table\n"; return 1; }
+        }
+    }
+
+    // Saved layout: load() adopts the saved index and seed instead of rebuilding, and
+    // falls back to a rebuild for a table whose hash policy cannot use it
+    {
+        HashTable source(11);
+        source.setSaveLayout(true);
+        for (int i = 0; i < 30000; ++i) {
+            source.emplace("lay" + std::to_string(i) + ".example.com", "user" + std::to_string(i % 4), "pw-" + std::to_string(i));
+        }
+        for (int i = 0; i < 30000; i += 3) source.remove("lay" + std::to_string(i) + ".example.com", "user" + std::to_string(i % 4));
+        if (!source.save(fname, key)) { std::cerr << "FAIL: save with layout\n"; return 1; }
+
+        auto checkLoaded = [&](auto& loaded, const char* what) {
+            if (loaded.size() != 20000) { std::cerr << "FAIL: " << what << " size " << loaded.size() << "\n"; return false; }
+            for (int i = 0; i < 30000; ++i) {
+                Credential* c = loaded.search("lay" + std::to_string(i) + ".example.com", "user" + std::to_string(i % 4));
+                if ((i % 3 == 0) != (c == nullptr) || (c && std::string(c->password) != "pw-" + std::to_string(i))) {
+                    std::cerr << "FAIL: " << what << " entry " << i << "\n"; return false;
+                }
+            }
+            return true;
+        };
+        const int threadCounts[] = {1, 4};
+        for (int threads : threadCounts) {
+            HashTable loaded(11);
+            if (!loaded.load(fname, key, threads) || !loaded.loadedLayout()) { std::cerr << "FAIL: load with layout\n"; return 1; }
+            if (loaded.hashPolicy().seed() != source.hashPolicy().seed()) { std::cerr << "FAIL: layout load kept its own seed\n"; return 1; }
+            if (!checkLoaded(loaded, "layout load")) return 1;
+            // The adopted index keeps working through removals and growth
+            for (int i = 1; i < 30000; i += 3) loaded.remove("lay" + std::to_string(i) + ".example.com", "user" + std::to_string(i % 4));
+            for (int i = 0; i < 40000; ++i) loaded.emplace("grown" + std::to_string(i), "u", "p");
+            if (loaded.size() != 50000 || !loaded.search("lay2.example.com", "user2") || !loaded.search("grown39999", "u")) {
+                std::cerr << "FAIL: churn on a table loaded from its layout\n"; return 1;
+            }
+        }
+        BasicHashTable<PolynomialHash> otherPolicy(11);
+        if (!otherPolicy.load(fname, key) || otherPolicy.loadedLayout() || !checkLoaded(otherPolicy, "layout fallback")) {
+            std::cerr << "FAIL: load of a layout saved by another hash policy\n"; return 1;
+        }
+        VaultReader reader;
+        Credential found;
+        if (!reader.open(fname, key) || !reader.find("lay2.example.com", "user2", found)) { std::cerr << "FAIL: VaultReader on a file with layout\n"; return 1; }
+
+        // The layout is covered by the file HMAC
+        std::string bytes;
+        {
+            std::ifstream in(fname, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        bytes[bytes.size() - 20] = static_cast<char>(bytes[bytes.size() - 20] ^ 1);
+        {
+            std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        HashTable damaged(11);
+        if (damaged.load(fname, key)) { std::cerr << "FAIL: load accepted a damaged layout\n"; return 1; }
+
+        // Without setSaveLayout the index is rebuilt as before
+        HashTable plain(11);
+        source.setSaveLayout(false);
+        if (!source.save(fname, key) || !plain.load(fname, key) || plain.loadedLayout() || !checkLoaded(plain, "plain load")) {
+            std::cerr << "FAIL: load without layout\n"; return 1;
+        }
+
+        // Journaled tables write the layout into their compacted snapshots
+        std::remove((fname + ".log").c_str());
+        {
+            HashTable journaled(11);
+            journaled.setSaveLayout(true);
+            if (!journaled.openJournal(fname, key)) { std::cerr << "FAIL: openJournal for layout\n"; return 1; }
+            journaled.emplace("journaled.com", "me", "pw");
+            if (!journaled.compact()) { std::cerr << "FAIL: compact with layout\n"; return 1; }
+        }
+        HashTable reopened(11);
+        if (!reopened.openJournal(fname, key) || !reopened.loadedLayout() || reopened.size() != 20001 ||
+            !reopened.search("journaled.com", "me")) {
+            std::cerr << "FAIL: reopen a journal whose snapshot has a layout\n"; return 1;
+        }
+        reopened.closeJournal();
+        std::remove((fname + ".log").c_str());
+    }
+
+    // Background save: the file holds the table exactly as of saveInBackground(), while
+    // edits keep coming for as long as the save runs (updates, removals, inserts that
+    // grow the index, writes through search()); nothing made after the snapshot leaks in
+    {
+        HashTable live(11);
+        for (int i = 0; i < 40000; ++i) live.emplace("cow" + std::to_string(i) + ".com", "u" + std::to_string(i % 3), "pw" + std::to_string(i));
+        std::mt19937 cowRng(5);
+        for (int round = 0; round < 3; ++round) {
+            std::map<std::pair<std::string, std::string>, std::string> frozen;
+            live.forEach([&](const Credential& c) { frozen[std::make_pair(std::string(c.site), std::string(c.username))] = std::string(c.password); });
+
+            std::shared_future<bool> saved = live.saveInBackground(fname, key);
+            for (int k = 0; k < 20000 || saved.wait_for(std::chrono::seconds(0)) != std::future_status::ready; ++k) {
+                const int i = static_cast<int>(cowRng() % 40000);
+                const std::string site = "cow" + std::to_string(i) + ".com", user = "u" + std::to_string(i % 3);
+                switch (k % 4) {
+                case 0: live.update(site, user, "edited-" + std::to_string(k)); break;
+                case 1: live.remove(site, user); break;
+                case 2: live.emplace("after" + std::to_string(round) + "-" + std::to_string(k), "u", "p"); break;
+                default:
+                    if (Credential* c = live.search(site, user)) c->password.assign("through-pointer");
+                }
+            }
+            if (!saved.get()) { std::cerr << "FAIL: background save\n"; return 1; }
+
+            HashTable check(11);
+            if (!check.load(fname, key) || check.size() != static_cast<int>(frozen.size())) { std::cerr << "FAIL: background save size (round " << round << ")\n"; return 1; }
+            size_t wrong = 0;
+            check.forEach([&](const Credential& c) {
+                auto it = frozen.find(std::make_pair(std::string(c.site), std::string(c.username)));
+                if (it == frozen.end() || it->second != std::string_view(c.password)) wrong++;
+            });
+            if (wrong != 0) { std::cerr << "FAIL: background save wrote " << wrong << " records that changed after the snapshot\n"; return 1; }
+        }
+
+        // clear() waits for the save still reading the snapshot, and a second background
+        // save waits for the first
+        const int before = live.size();
+        std::shared_future<bool> first = live.saveInBackground(fname + ".a", key);
+        std::shared_future<bool> second = live.saveInBackground(fname, key);
+        live.clear();
+        live.emplace("fresh.com", "u", "p");
+        HashTable check(11);
+        if (!first.get() || !second.get() || !check.load(fname, key) || check.size() != before || check.search("fresh.com", "u")) {
+            std::cerr << "FAIL: clear() during a background save\n"; return 1;
+        }
+        std::remove((fname + ".a").c_str());
+
+        // The const search() reads a frozen slab in place instead of copying it, so
+        // readers sharing a lock never write to the table
+        const HashTable& reader = live;
+        const Credential* inPlace = reader.search("fresh.com", "u");
+        std::shared_future<bool> reading = live.saveInBackground(fname, key);
+        if (reader.search("fresh.com", "u") != inPlace || reader.search("fresh.com") != inPlace || !reading.get()) {
+            std::cerr << "FAIL: const search during a background save\n"; return 1;
+        }
+
+        // A finished save's snapshot is freed with the table's reference, even while
+        // the caller still holds the future
+        std::shared_future<bool> held = live.saveInBackground(fname, key);
+        std::weak_ptr<const void> snapshot = live.currentSnapshot();
+        if (snapshot.expired() || !held.get()) { std::cerr << "FAIL: background save snapshot\n"; return 1; }
+        live.clear();
+        if (!snapshot.expired()) { std::cerr << "FAIL: background save leaks its snapshot\n"; return 1; }
+    }
+
+    // SPASSv01 files (CSV payload) still load
+    {
+        std::string payload = "\"old.com\",\"alice\",\"pw1\"\n\"old.com\",\"bob\",\"pw2\"\n\"other.org\",\"carol\",\"pw3\"\n";
+        for (size_t i = 0; i < payload.size(); ++i) payload[i] = static_cast<char>(payload[i] ^ key[i % key.size()]);
+        HmacSha256 mac(key);
+        mac.update(payload);
+        unsigned char digest[Sha256::DIGEST_SIZE];
+        mac.final(digest);
+        std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+        out.write("SPASSv01", 8);
+        out.write(reinterpret_cast<const char*>(digest), sizeof(digest));
+        out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        out.close();
+        HashTable v1(11);
+        Credential* bob = nullptr;
+        if (!v1.load(fname, key) || v1.size() != 3 || !(bob = v1.search("old.com", "bob")) || bob->password != "pw2") {
+            std::cerr << "FAIL: SPASSv01 file did not load\n"; return 1;
+        }
+    }
+
+    // Streaming save: a payload spanning many blocks (with a key length that
+    // does not divide the chunk size) must round-trip through load()
+    {
+        HashTable big(11);
+        for (int i = 0; i < 20000; ++i) {
+            big.emplace("stream" + std::to_string(i) + ".example.com", "user" + std::to_string(i % 7), "password-" + std::to_string(i * 31));
+        }
+        if (!big.save(fname, "k3y!x")) { std::cerr << "FAIL: streaming save\n"; return 1; }
+        HashTable back(11);
+        if (!back.load(fname, "k3y!x") || back.size() != big.size()) { std::cerr << "FAIL: streaming save round-trip size\n"; return 1; }
+        for (int i = 0; i < 20000; i += 97) {
+            Credential* c = back.search("stream" + std::to_string(i) + ".example.com", "user" + std::to_string(i % 7));
+            if (!c || std::string(c->password) != "password-" + std::to_string(i * 31)) { std::cerr << "FAIL: streaming save round-trip entry\n"; return 1; }
+        }
+    }
+
+    // Lookups by string_view (and literals) perform no heap allocations
+    {
+        HashTable lookups(11);
+        std::vector<std::string> sites;
+        for (int i = 0; i < 2000; ++i) {
+            sites.push_back("allocation-free-site-" + std::to_string(i) + ".example.com");
+            lookups.emplace(sites.back(), "a-rather-long-username@example.com", "a-rather-long-password-value");
+        }
+        size_t before = g_allocations;
+        size_t hits = 0;
+        for (const std::string& site : sites) {
+            hits += lookups.search(site, "a-rather-long-username@example.com") != nullptr;
+            hits += lookups.search(std::string_view(site)) != nullptr;
+            hits += lookups.search(site, "missing-user") == nullptr;
+            lookups.hash(site);
+        }
+        hits += lookups.search("not-there.example.com") == nullptr;
+        hits += !lookups.remove("not-there.example.com", "nobody");
+        size_t allocations = g_allocations - before;
+        if (hits != 3 * sites.size() + 2) { std::cerr << "FAIL: string_view lookups returned wrong results\n"; return 1; }
+        if (allocations != 0) { std::cerr << "FAIL: lookups performed " << allocations << " heap allocations\n"; return 1; }
+    }
+
+    // Sharded table: concurrent writers on disjoint keys while readers copy results out
+    {
+        ConcurrentHashTable shared(8, 11);
+        const int writers = 4, perWriter = 5000;
+        std::atomic<bool> done(false);
+        std::atomic<int> badReads(0);
+        std::vector<std::thread> threads;
+        for (int w = 0; w < writers; ++w) {
+            threads.emplace_back([&shared, w, perWriter]() {
+                for (int i = 0; i < perWriter; ++i) {
+                    std::string site = "w" + std::to_string(w) + "-" + std::to_string(i) + ".com";
+                    shared.emplace(site, "user", "v1");
+                    shared.update(site, "user", "v2");
+                    if (i % 3 == 0) shared.remove(site, "user");
+                }
+            });
+        }
+        for (int r = 0; r < 2; ++r) {
+            threads.emplace_back([&shared, &done, &badReads]() {
+                while (!done.load()) {
+                    std::optional<Credential> c = shared.search("w0-10.com", "user");
+                    if (c && c->password != "v1" && c->password != "v2") badReads++;
+                }
+            });
+        }
+        for (int w = 0; w < writers; ++w) threads[w].join();
+        done = true;
+        for (size_t i = writers; i < threads.size(); ++i) threads[i].join();
+
+        int expected = writers * (perWriter - (perWriter + 2) / 3);
+        if (shared.size() != expected) { std::cerr << "FAIL: sharded table size " << shared.size() << " != " << expected << "\n"; return 1; }
+        if (badReads != 0) { std::cerr << "FAIL: torn reads from sharded table\n"; return 1; }
+        std::optional<Credential> kept = shared.search("w3-4.com", "user");
+        if (!kept || kept->password != "v2" || shared.search("w3-3.com", "user")) { std::cerr << "FAIL: sharded table contents\n"; return 1; }
+
+        if (!shared.save(fname, key)) { std::cerr << "FAIL: sharded save\n"; return 1; }
+        ConcurrentHashTable reloaded(4, 11);
+        if (!reloaded.load(fname, key) || reloaded.size() != expected) { std::cerr << "FAIL: sharded load\n"; return 1; }
+    }
+
+    // Insert cost across several growth cycles. The bound is on work, not time: with
+    // incremental rehash no insert migrates more than MIGRATE_GROUPS_PER_OP old
+    // groups (a resize starts with the previous one already drained). Wall-clock
+    // worst cases are printed for information only.
+    {
+        const int n = 400000; // grows 128 -> 524288 slots: 12 resizes
+        auto worstInsert = [n](bool incremental, int& lookupFailures, int& maxMigrated, int& resizes) {
+            HashTable grow(101);
+            grow.setIncrementalRehash(incremental);
+            long long worst = 0;
+            for (int i = 0; i < n; ++i) {
+                Credential cred("site" + std::to_string(i) + ".com", "user", "pw");
+                const int backlog = grow.migrationBacklog();
+                auto t0 = std::chrono::steady_clock::now();
+                grow.insert(cred);
+                long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+                if (ns > worst) worst = ns;
+                // A resize started by this insert: the previous backlog was finished first
+                const int after = grow.migrationBacklog();
+                if (after > backlog) resizes++;
+                maxMigrated = std::max(maxMigrated, after > backlog ? backlog : backlog - after);
+                // Entries must stay visible while the old index is being drained
+                if (i % 997 == 0 && !grow.search("site" + std::to_string(i / 2) + ".com", "user")) lookupFailures++;
+            }
+            return worst;
+        };
+        int lookupFailures = 0, maxMigrated = 0, resizes = 0, unusedMigrated = 0, unusedResizes = 0;
+        const long long stopTheWorld = worstInsert(false, lookupFailures, unusedMigrated, unusedResizes);
+        const long long incremental = worstInsert(true, lookupFailures, maxMigrated, resizes);
+        std::cout << "Worst insert latency over " << n << " inserts: stop-the-world " << stopTheWorld / 1000
+                  << " us, incremental " << incremental / 1000 << " us\n";
+        if (lookupFailures != 0) { std::cerr << "FAIL: lookups missed entries during incremental resize\n"; return 1; }
+        if (resizes != 12 || maxMigrated > HashTable::MIGRATE_GROUPS_PER_OP) {
+            std::cerr << "FAIL: incremental resize migrated " << maxMigrated << " groups in one insert over "
+                      << resizes << " resizes\n";
+            return 1;
+        }
+    }
+
+    // SHA-256 against the NIST FIPS 180-2 examples, one-shot and fed in uneven pieces
+    {
+        auto hex = [](const unsigned char* d, size_t n) {
+            static const char digits[] = "0123456789abcdef";
+            std::string out;
+            for (size_t i = 0; i < n; ++i) { out += digits[d[i] >> 4]; out += digits[d[i] & 15]; }
+            return out;
+        };
+        const std::string millionA(1000000, 'a');
+        const struct { std::string message; const char* digest; } vectors[] = {
+            {"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+            {"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+            {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+            {millionA, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+        };
+        for (const auto& v : vectors) {
+            if (sha256_hex(v.message) != v.digest) { std::cerr << "FAIL: SHA-256 test vector (" << v.message.size() << " bytes)\n"; return 1; }
+            const size_t chunkSizes[] = {1, 3, 63, 64, 65, 1000};
+            for (size_t chunk : chunkSizes) {
+                Sha256 ctx;
+                for (size_t off = 0; off < v.message.size(); off += chunk) {
+                    ctx.update(v.message.data() + off, std::min(chunk, v.message.size() - off));
+                }
+                unsigned char digest[Sha256::DIGEST_SIZE];
+                ctx.final(digest);
+                if (hex(digest, sizeof(digest)) != v.digest) { std::cerr << "FAIL: streaming SHA-256, chunk " << chunk << "\n"; return 1; }
+            }
+        }
+
+        // HMAC-SHA256 against RFC 4231 test cases 1, 2 and 6 (key longer than a block)
+        const struct { std::string key; std::string message; const char* mac; } hmacVectors[] = {
+            {std::string(20, '\x0b'), "Hi There", "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7"},
+            {"Jefe", "what do ya want for nothing?", "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"},
+            {std::string(131, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First", "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"},
+        };
+        for (const auto& v : hmacVectors) {
+            HmacSha256 mac(v.key);
+            // Twice with the same context: init() must restore the precomputed key state
+            for (int round = 0; round < 2; ++round) {
+                mac.init();
+                mac.update(v.message.substr(0, 5));
+                mac.update(v.message.substr(5));
+                unsigned char digest[Sha256::DIGEST_SIZE];
+                mac.final(digest);
+                if (hex(digest, sizeof(digest)) != v.mac) { std::cerr << "FAIL: HMAC-SHA256 test vector\n"; return 1; }
+            }
+        }
+    }
+
+    // Every SHA-256 kernel this CPU supports must match the scalar code, for messages
+    // of many lengths
+    {
+        std::mt19937 rng(9);
+        std::vector<std::string> messages;
+        for (int i = 0; i < 75; ++i) {
+            size_t len = i < 70 ? static_cast<size_t>(i) * 7 % 200 : 5000 + static_cast<size_t>(i);
+            std::string m(len, '\0');
+            for (char& c : m) c = static_cast<char>(rng());
+            messages.push_back(m);
+        }
+        const Sha256Kernel original = sha256_active_kernel();
+
+        sha256_use_kernel(SHA256_KERNEL_SCALAR);
+        std::vector<std::string> expected;
+        for (const std::string& m : messages) expected.push_back(sha256_raw(m));
+
+        const Sha256Kernel kernels[] = {SHA256_KERNEL_SCALAR, SHA256_KERNEL_SHANI};
+        for (Sha256Kernel kernel : kernels) {
+            if (!sha256_use_kernel(kernel)) {
+                std::cout << "Note: SHA-256 kernel " << sha256_kernel_name(kernel) << " not supported here; skipped.\n";
+                continue;
+            }
+            for (size_t i = 0; i < messages.size(); ++i) {
+                if (sha256_raw(messages[i]) != expected[i]) {
+                    std::cerr << "FAIL: SHA-256 kernel " << sha256_kernel_name(kernel) << " differs from scalar ("
+                              << messages[i].size() << " bytes)\n";
+                    return 1;
+                }
+            }
+        }
+        sha256_use_kernel(original);
+    }
+
+    // Every XOR kernel this CPU supports must match the byte-at-a-time reference, for
+    // any key length, stream position, length and alignment, in place or not, and
+    // ciphering a stream in pieces must equal ciphering it whole
+    {
+        std::mt19937 rng(20);
+        std::string data(3000, '\0');
+        for (char& c : data) c = static_cast<char>(rng());
+        const XorKernel original = xor_active_kernel();
+        const XorKernel kernels[] = {XOR_KERNEL_SCALAR, XOR_KERNEL_SSE2, XOR_KERNEL_AVX2};
+        const size_t keyLengths[] = {0, 1, 3, 7, 31, 32, 33, 63, 64, 65, 100, 129};
+        for (XorKernel kernel : kernels) {
+            if (!xor_use_kernel(kernel)) {
+                std::cout << "Note: XOR kernel " << xor_kernel_name(kernel) << " not supported here; skipped.\n";
+                continue;
+            }
+            for (size_t keyLen : keyLengths) {
+                std::string cipherKey(keyLen, '\0');
+                for (char& c : cipherKey) c = static_cast<char>(rng());
+                const RepeatingKeyXor cipher(cipherKey);
+                for (int trial = 0; trial < 40; ++trial) {
+                    const size_t start = rng() % 64;
+                    const size_t len = trial < 20 ? static_cast<size_t>(trial) * 13 % 200 : rng() % (data.size() - start);
+                    const uint64_t position = trial % 3 == 0 ? rng() : rng() % 1000;
+                    std::string expected = data.substr(start, len);
+                    for (size_t i = 0; i < len && keyLen != 0; ++i) {
+                        expected[i] = static_cast<char>(expected[i] ^ cipherKey[(position + i) % keyLen]);
+                    }
+                    std::string out(len + 1, '\0');
+                    cipher.apply(data.data() + start, &out[1], len, position); // Misaligned output
+                    std::string inPlace = data.substr(start, len);
+                    const size_t split = len != 0 ? rng() % len : 0;
+                    cipher.apply(&inPlace[0], split, position);
+                    cipher.apply(&inPlace[split], len - split, position + split);
+                    if (out.substr(1) != expected || inPlace != expected) {
+                        std::cerr << "FAIL: XOR kernel " << xor_kernel_name(kernel) << " differs from the reference (key "
+                                  << keyLen << " bytes, " << len << " bytes at position " << position << ")\n";
+                        return 1;
+                    }
+                }
+            }
+        }
+        xor_use_kernel(original);
+    }
+
+    // Adversarial keys: "Ac" and "`b" have the same base-31 value, so every site built
+    // from 10 such blocks collides under the polynomial hash but not under the seeded one
+    {
+        std::vector<std::string> sites;
+        for (int mask = 0; mask < 1024; ++mask) {
+            std::string site;
+            for (int b = 0; b < 10; ++b) site += (mask >> b & 1) ? "Ac" : "`b";
+            sites.push_back(site);
+        }
+        BasicHashTable<PolynomialHash> weak(101);
+        HashTable seeded(101);
+        for (const std::string& site : sites) {
+            weak.emplace(site, "user", "pw");
+            seeded.emplace(site, "user", "pw");
+        }
+        size_t weakMax = weak.probeLengthHistogram().size() - 1;
+        size_t seededMax = seeded.probeLengthHistogram().size() - 1;
+        std::cout << "Max probe length (groups) for 1024 colliding sites: polynomial " << weakMax
+                  << ", seeded " << seededMax << "\n";
+        if (weakMax < 32) { std::cerr << "FAIL: colliding keys did not cluster under the polynomial hash\n"; return 1; }
+        if (seededMax > 4) { std::cerr << "FAIL: seeded hash clustered on adversarial keys\n"; return 1; }
+        for (const std::string& site : sites) {
+            if (!weak.search(site, "user") || !seeded.search(site, "user") || !seeded.search(site)) {
+                std::cerr << "FAIL: lookup of adversarial key\n"; return 1;
+            }
+        }
+        // Two tables get different seeds, and the username takes part in the hash
+        HashTable other(101);
+        if (seeded.hashPolicy().seed() == other.hashPolicy().seed()) { std::cerr << "FAIL: hash seed repeated\n"; return 1; }
+        if (seeded.hashPolicy()("a.com", "alice") == seeded.hashPolicy()("a.com", "bob")) { std::cerr << "FAIL: username ignored by hash\n"; return 1; }
+    }
+
+    // Accounts are placed by site and username, so 10^5 accounts of one site do not
+    // share a probe sequence; search(site) without a username goes through the site
+    // directory, which stays right across resizes and removals, and (in a
+    // HASHTABLE_STATS build) visits a few groups rather than the site's accounts
+    {
+        HashTable table(11);
+        for (int i = 0; i < 100000; i++) {
+            table.emplace("big.com", "user" + std::to_string(i), "pw");
+            if (i % 4 == 0) table.emplace("site" + std::to_string(i / 4) + ".com", "u", "pw");
+            // Site-only lookups also run while the index is being migrated
+            if (i % 1000 == 0 && (!table.search("big.com") || !table.search("site0.com"))) {
+                std::cerr << "FAIL: site-only search during a resize\n"; return 1;
+            }
+        }
+        const size_t maxProbe = table.probeLengthHistogram().size() - 1;
+        std::cout << "Max probe length (groups) with 100000 accounts of one site: " << maxProbe << "\n";
+        if (maxProbe > 8) { std::cerr << "FAIL: accounts of one site cluster\n"; return 1; }
+        if (!table.search("big.com", "user99999") || table.search("big.com", "user100000")) {
+            std::cerr << "FAIL: lookup among accounts of one site\n"; return 1;
+        }
+        for (int i = 0; i < 1000; i++) {
+            const std::string site = "site" + std::to_string(i) + ".com";
+            Credential* c = table.search(site);
+            if (c == nullptr || c->site != site || table.search("absent" + std::to_string(i) + ".com")) {
+                std::cerr << "FAIL: site-only search\n"; return 1;
+            }
+        }
+#if HASHTABLE_STATS
+        table.resetStats();
+        for (int i = 0; i < 1000; i++) table.search("site" + std::to_string(i) + ".com");
+        table.search("big.com");
+        const TableStats s = table.stats();
+        if (s.hits != 1001 || s.groupsProbed > 1001 * 4) { std::cerr << "FAIL: site-only search scans the index\n"; return 1; }
+#endif
+        // The site stays findable until its last account is removed, whichever goes first
+        for (int i = 0; i < 100000; i++) {
+            Credential* c = table.search("big.com");
+            if (c == nullptr) { std::cerr << "FAIL: site lost while accounts remain\n"; return 1; }
+            const std::string user = i % 2 ? std::string(c->username) : "user" + std::to_string(i);
+            if (!table.remove("big.com", user) && !table.remove("big.com", c->username)) {
+                std::cerr << "FAIL: remove account of one site\n"; return 1;
+            }
+        }
+        if (table.search("big.com") || !table.search("site0.com")) { std::cerr << "FAIL: site-only search after removals\n"; return 1; }
+    }
+
+    // Journaled mode: a log cut at any byte (a crash mid-write) recovers the state
+    // after its last complete record, and the torn tail is cut off
+    {
+        typedef std::map<std::pair<std::string, std::string>, std::string> State;
+        auto stateOf = [](const HashTable& t) {
+            State s;
+            t.forEach([&s](const Credential& c) { s[{std::string(c.site), std::string(c.username)}] = std::string(c.password); });
+            return s;
+        };
+        auto readFile = [](const std::string& name) {
+            std::ifstream in(name, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        };
+        auto writeFile = [](const std::string& name, const std::string& bytes) {
+            std::ofstream out(name, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        };
+        const std::string vault = "test_journal.bin";
+        const std::string logName = vault + ".log", oldLog = vault + ".log.1";
+        std::remove(vault.c_str());
+        std::remove(logName.c_str());
+        std::remove(oldLog.c_str());
+
+        HashTable j(11);
+        if (!j.openJournal(vault, key) || j.size() != 0) { std::cerr << "FAIL: open new journaled vault\n"; return 1; }
+        j.emplace("base.com", "u", "b0");
+        j.emplace("keep.com", "u", "k0");
+        if (!j.compact()) { std::cerr << "FAIL: journal compact\n"; return 1; }
+
+        // states[k] is the table after the k-th logged change, which ends at ends[k]
+        std::vector<State> states{stateOf(j)};
+        std::vector<size_t> ends{j.journalSize()};
+        std::mt19937 rng(7);
+        for (int op = 0; op < 40; ++op) {
+            std::string site = "s" + std::to_string(rng() % 6) + ".com";
+            switch (op == 25 ? 4 : rng() % 4) {
+            case 0: case 1: j.emplace(site, "u", "p" + std::to_string(op)); break;
+            case 2: j.remove(site, "u"); break;
+            case 3: j.update(site, "u", std::string(op, 'x')); break;
+            default: j.clear(); break;
+            }
+            if (j.journalSize() != ends.back()) {
+                states.push_back(stateOf(j));
+                ends.push_back(j.journalSize());
+            }
+        }
+        if (states.size() < 20 || j.journalFailed()) { std::cerr << "FAIL: journal did not log changes\n"; return 1; }
+        j.closeJournal();
+
+        const std::string logBytes = readFile(logName);
+        for (size_t cut = 0; cut <= logBytes.size(); ++cut) {
+            writeFile(logName, logBytes.substr(0, cut));
+            HashTable r(11);
+            if (!r.openJournal(vault, key)) { std::cerr << "FAIL: journal recovery at byte " << cut << "\n"; return 1; }
+            size_t k = static_cast<size_t>(std::upper_bound(ends.begin(), ends.end(), cut) - ends.begin());
+            k = k == 0 ? 0 : k - 1;
+            if (stateOf(r) != states[k]) { std::cerr << "FAIL: journal replay state at byte " << cut << "\n"; return 1; }
+            if (r.journalSize() != ends[k]) { std::cerr << "FAIL: torn journal tail not cut at byte " << cut << "\n"; return 1; }
+        }
+
+        // Recovery keeps logging where the intact prefix ends
+        writeFile(logName, logBytes.substr(0, ends[5] + 3));
+        {
+            HashTable r(11);
+            r.openJournal(vault, key);
+            r.emplace("after.com", "u", "crash");
+        }
+        {
+            HashTable r(11);
+            State expect = states[5];
+            expect[{"after.com", "u"}] = "crash";
+            if (!r.openJournal(vault, key) || stateOf(r) != expect) { std::cerr << "FAIL: journal append after recovery\n"; return 1; }
+        }
+
+        // A wrong key fails the open and leaves the log untouched, with or without a snapshot
+        size_t logSize = readFile(logName).size();
+        HashTable wrong(11);
+        if (wrong.openJournal(vault, "wrongkey") || readFile(logName).size() != logSize) { std::cerr << "FAIL: journal opened with wrong key\n"; return 1; }
+        std::remove(vault.c_str());
+        if (wrong.openJournal(vault, "wrongkey") || readFile(logName).size() != logSize) { std::cerr << "FAIL: journal log accepted wrong key\n"; return 1; }
+
+        // Crash after rotating the log to ".log.1" but before the snapshot was replaced
+        std::remove(logName.c_str());
+        {
+            HashTable r(11);
+            r.openJournal(vault, key);
+            r.emplace("x.com", "u", "a");
+            r.emplace("y.com", "u", "1");
+            r.compact();
+            r.emplace("x.com", "u", "b");
+            r.remove("y.com", "u");
+        }
+        std::rename(logName.c_str(), oldLog.c_str());
+        {
+            HashTable r(11);
+            Credential* x = nullptr;
+            if (!r.openJournal(vault, key) || !(x = r.search("x.com", "u")) || x->password != "b" || r.search("y.com", "u")) {
+                std::cerr << "FAIL: journal replay of rotated log\n"; return 1;
+            }
+            if (std::ifstream(oldLog).is_open()) { std::cerr << "FAIL: rotated log not compacted on open\n"; return 1; }
+        }
+        // Crash after the snapshot was replaced but before ".log.1" was deleted:
+        // replaying changes the snapshot already holds must not roll anything back
+        {
+            HashTable r(11);
+            r.openJournal(vault, key);
+            r.emplace("x.com", "u", "c");
+            r.emplace("z.com", "u", "1");
+        }
+        std::string rotated = readFile(logName);
+        {
+            HashTable r(11);
+            r.openJournal(vault, key);
+            r.compact();
+            r.emplace("x.com", "u", "d");
+        }
+        writeFile(oldLog, rotated);
+        {
+            HashTable r(11);
+            Credential* x = nullptr;
+            if (!r.openJournal(vault, key) || !(x = r.search("x.com", "u")) || x->password != "d" || !r.search("z.com", "u")) {
+                std::cerr << "FAIL: journal replay over a newer snapshot\n"; return 1;
+            }
+        }
+
+        // Background compaction: a small threshold forces many rotations
+        {
+            HashTable r(11);
+            r.openJournal(vault, key);
+            r.setCompactionThreshold(4096);
+            for (int i = 0; i < 3000; ++i) {
+                r.emplace("bg" + std::to_string(i % 500) + ".com", "u", "v" + std::to_string(i));
+                if (i % 7 == 0) r.remove("bg" + std::to_string((i * 3) % 500) + ".com", "u");
+                // Give the writer thread a turn; the log keeps growing while it runs
+                if (i % 100 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                if (r.journalSize() > 64 * 1024) { std::cerr << "FAIL: journal never compacted\n"; return 1; }
+            }
+            State expect = stateOf(r);
+            r.closeJournal();
+            if (r.journalFailed() || std::ifstream(oldLog).is_open()) { std::cerr << "FAIL: background compaction\n"; return 1; }
+            HashTable back(11);
+            if (!back.openJournal(vault, key) || stateOf(back) != expect) { std::cerr << "FAIL: journal state after background compaction\n"; return 1; }
+        }
+
+        // A compaction's snapshot is freed once it is done and the table lets go of it
+        {
+            HashTable r(11);
+            r.openJournal(vault, key);
+            r.setCompactionThreshold(4096);
+            std::weak_ptr<const void> snapshot;
+            for (int i = 0; i < 10000 && snapshot.expired(); ++i) {
+                r.emplace("snap" + std::to_string(i) + ".com", "u", "v");
+                snapshot = r.currentSnapshot();
+            }
+            if (snapshot.expired()) { std::cerr << "FAIL: no background compaction started\n"; return 1; }
+            r.closeJournal();
+            r.clear();
+            if (!snapshot.expired()) { std::cerr << "FAIL: background compaction leaks its snapshot\n"; return 1; }
+        }
+        std::remove(vault.c_str());
+        std::remove(logName.c_str());
+        std::remove(oldLog.c_str());
+    }
+
+    // Group commit: concurrent requests share commits, and every request is answered
+    // by a commit that started after it was made
+    {
+        std::atomic<int> edits(0);
+        std::atomic<int> calls(0);
+        std::atomic<int> lastCommitted(0);
+        std::vector<int> committedAt; // edits seen at the start of each commit (commit thread only)
+        CommitScheduler scheduler([&]() {
+            committedAt.push_back(edits.load());
+            lastCommitted = committedAt.back();
+            calls++;
+            std::this_thread::sleep_for(std::chrono::microseconds(300));
+            return true;
+        }, std::chrono::microseconds(500));
+        std::atomic<int> late(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; ++t) {
+            threads.emplace_back([&]() {
+                for (int i = 0; i < 50; ++i) {
+                    int mine = ++edits;
+                    std::shared_future<bool> done = scheduler.request();
+                    if (!done.get()) late++;
+                    // The commit that answered us started after our edit
+                    if (lastCommitted.load() < mine) late++;
+                }
+            });
+        }
+        for (std::thread& t : threads) t.join();
+        for (size_t c = 1; c < committedAt.size(); ++c) {
+            if (committedAt[c] < committedAt[c - 1]) late++;
+        }
+        if (late != 0 || committedAt.empty() || committedAt.back() != 400) { std::cerr << "FAIL: group commit missed a request\n"; return 1; }
+        if (calls >= 400 || scheduler.commits() != static_cast<uint64_t>(calls.load())) { std::cerr << "FAIL: group commit did not coalesce requests\n"; return 1; }
+
+        // Sharded table: edits from several threads are durable once their commit completes
+        const std::string vault = "test_commit.bin";
+        ConcurrentHashTable shared(8, 11);
+        shared.enableGroupCommit(vault, key, std::chrono::microseconds(1000));
+        std::atomic<int> failedCommits(0);
+        threads.clear();
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&shared, &failedCommits, t]() {
+                for (int i = 0; i < 25; ++i) {
+                    shared.emplace("gc" + std::to_string(t) + "-" + std::to_string(i) + ".com", "user", "pw");
+                    if (!shared.commit().get()) failedCommits++;
+                }
+            });
+        }
+        for (std::thread& t : threads) t.join();
+        HashTable saved(11);
+        if (failedCommits != 0 || !saved.load(vault, key) || saved.size() != 100) { std::cerr << "FAIL: group commit of sharded table\n"; return 1; }
+        if (shared.commits() >= 100) { std::cerr << "FAIL: sharded group commit did not coalesce\n"; return 1; }
+        shared.disableGroupCommit();
+        if (shared.commit().get()) { std::cerr << "FAIL: commit succeeded without group commit\n"; return 1; }
+        std::remove(vault.c_str());
+
+        // Journaled table: commit() syncs the log
+        HashTable journaled(11);
+        if (journaled.commit().get()) { std::cerr << "FAIL: commit succeeded without a journal\n"; return 1; }
+        journaled.openJournal(vault, key);
+        journaled.setCommitWindow(std::chrono::microseconds(0));
+        journaled.emplace("durable.com", "u", "p");
+        if (!journaled.commit().get()) { std::cerr << "FAIL: journal commit\n"; return 1; }
+        journaled.closeJournal();
+        std::remove(vault.c_str());
+        std::remove((vault + ".log").c_str());
+    }
+
+    // Indexed lookups: VaultReader answers from the file, decrypting only a block or two
+    {
+        HashTable src(11);
+        for (int i = 0; i < 20000; ++i) {
+            src.emplace("idx" + std::to_string(i % 5000) + ".example.com", "user" + std::to_string(i / 5000), "pw-" + std::to_string(i));
+        }
+        // One site whose accounts span many blocks
+        for (int i = 0; i < 300; ++i) src.emplace("crowded.com", "u" + std::to_string(i), std::string(100, 'a' + i % 26));
+        if (!src.save(fname, key)) { std::cerr << "FAIL: indexed save\n"; return 1; }
+
+        VaultReader reader;
+        if (!reader.open(fname, key) || reader.size() != static_cast<uint64_t>(src.size())) { std::cerr << "FAIL: VaultReader open\n"; return 1; }
+        Credential found;
+        for (int i = 0; i < 20000; i += 37) {
+            std::string site = "idx" + std::to_string(i % 5000) + ".example.com";
+            std::string user = "user" + std::to_string(i / 5000);
+            uint64_t before = reader.blocksRead();
+            if (!reader.find(site, user, found) || std::string_view(found.password) != "pw-" + std::to_string(i)) { std::cerr << "FAIL: VaultReader find " << site << "\n"; return 1; }
+            if (reader.blocksRead() - before > 2) { std::cerr << "FAIL: VaultReader read " << reader.blocksRead() - before << " blocks for one lookup\n"; return 1; }
+            if (!reader.find(site, "", found) || std::string_view(found.site) != site) { std::cerr << "FAIL: VaultReader site-only find\n"; return 1; }
+        }
+        for (int i = 0; i < 300; i += 7) {
+            if (!reader.find("crowded.com", "u" + std::to_string(i), found) || std::string_view(found.password) != std::string(100, 'a' + i % 26)) {
+                std::cerr << "FAIL: VaultReader find across blocks\n"; return 1;
+            }
+        }
+        if (reader.find("missing.example.com", "", found) || reader.find("idx1.example.com", "nobody", found)) { std::cerr << "FAIL: VaultReader found a missing key\n"; return 1; }
+
+        VaultReader wrongKey;
+        if (wrongKey.open(fname, "wrongkey")) { std::cerr << "FAIL: VaultReader opened with wrong key\n"; return 1; }
+
+        // A damaged block only fails the lookups that need it
+        std::string bytes;
+        {
+            std::ifstream in(fname, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        bytes[100] = static_cast<char>(bytes[100] ^ 1); // Inside the first block
+        {
+            std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        VaultReader damaged;
+        if (!damaged.open(fname, key)) { std::cerr << "FAIL: VaultReader rejected a file with one bad block\n"; return 1; }
+        int failures = 0;
+        for (int i = 0; i < 5000; ++i) failures += !damaged.find("idx" + std::to_string(i) + ".example.com", "", found);
+        if (failures == 0 || failures > 200) { std::cerr << "FAIL: damaged block affected " << failures << " lookups\n"; return 1; }
+        HashTable full(11);
+        if (full.load(fname, key)) { std::cerr << "FAIL: load accepted a damaged block\n"; return 1; }
+    }
+
+    // A load that fails at a later chunk wipes the passwords of the nodes it had
+    // already built from the earlier ones before their memory is released
+    {
+        HashTable source(11);
+        for (int i = 0; i < 5000; ++i) source.emplace("wipe" + std::to_string(i) + ".com", "u", "leaked-password-" + std::to_string(i));
+        if (!source.save(fname, key)) { std::cerr << "FAIL: save for partial load\n"; return 1; }
+        std::string bytes;
+        {
+            std::ifstream in(fname, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        // The chunk table (56-byte entries of an indexed file, then the count) ends the
+        // file; the byte before it is the last byte of the last chunk
+        uint64_t chunks = 0;
+        for (int b = 0; b < 8; ++b) chunks |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[bytes.size() - 8 + b])) << (8 * b);
+        const size_t lastPayloadByte = bytes.size() - 8 - static_cast<size_t>(chunks) * 56 - 1;
+        bytes[lastPayloadByte] = static_cast<char>(bytes[lastPayloadByte] ^ 1);
+        {
+            std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        CountingResource upstream;
+        upstream.secret = "leaked-password-";
+        std::pmr::memory_resource* previous = std::pmr::set_default_resource(&upstream);
+        HashTable partial(11); // Its string pool draws from upstream
+        std::pmr::set_default_resource(previous);
+        if (chunks < 4 || partial.load(fname, key, 1) || partial.size() != 0) {
+            std::cerr << "FAIL: load accepted a damaged last chunk\n"; return 1;
+        }
+        if (upstream.secretsFreed != 0) { std::cerr << "FAIL: failed load freed unwiped passwords\n"; return 1; }
+    }
+
+    // Compression: the codec round-trips any input with or without a dictionary and
+    // rejects damaged input; compressed vaults load, serve VaultReader lookups and
+    // carry a layout, and come out smaller
+    {
+        std::mt19937 rng(19);
+        const std::string dict = "\x10site.example.com" "\x11" "alice@example.org";
+        std::vector<std::string> inputs = {"", "a", "abc", "abcd", std::string(100000, 'a'), "alice@example.org"};
+        std::string text;
+        for (int i = 0; i < 2000; ++i) text += "site" + std::to_string(i % 97) + ".example.com alice@example.org ";
+        inputs.push_back(text);
+        std::string noise(5000, '\0');
+        for (char& c : noise) c = static_cast<char>(rng());
+        inputs.push_back(noise);
+        std::string mixed;
+        for (int i = 0; i < 300; ++i) mixed += noise.substr(rng() % 4000, rng() % 300) + std::string(rng() % 20, 'x');
+        inputs.push_back(mixed);
+        for (const std::string_view d : {std::string_view(), std::string_view(dict)}) {
+            LzEncoder encoder(d);
+            for (const std::string& in : inputs) {
+                std::string packed = "prefix";
+                encoder.compress(in.data(), in.size(), packed);
+                std::string out(in.size(), '\0');
+                if (!lzDecompress(packed.data() + 6, packed.size() - 6, &out[0], out.size(), d) || out != in) {
+                    std::cerr << "FAIL: LZ round trip of " << in.size() << " bytes\n"; return 1;
+                }
+                if (in.size() > 1000 && in != noise && packed.size() - 6 > in.size() / 4) {
+                    std::cerr << "FAIL: LZ compressed " << in.size() << " bytes to " << packed.size() - 6 << "\n"; return 1;
+                }
+                // Truncated input, or the wrong output size, fails cleanly
+                std::string big(in.size() + 1, '\0');
+                if (lzDecompress(packed.data() + 6, packed.size() - 7, &out[0], out.size(), d) ||
+                    lzDecompress(packed.data() + 6, packed.size() - 6, &big[0], big.size(), d)) {
+                    std::cerr << "FAIL: LZ accepted damaged input\n"; return 1;
+                }
+            }
+        }
+        // Matches that reach into the dictionary need the same dictionary to decode
+        {
+            LzEncoder encoder(dict);
+            std::string packed;
+            const std::string in = "alice@example.org site.example.com";
+            encoder.compress(in.data(), in.size(), packed);
+            std::string out(in.size(), '\0');
+            if (packed.size() >= in.size() / 2 || lzDecompress(packed.data(), packed.size(), &out[0], out.size(), "")) {
+                std::cerr << "FAIL: LZ dictionary matches\n"; return 1;
+            }
+        }
+
+        // The same usernames on many sites, plus fields of arbitrary bytes
+        HashTable src(11);
+        std::map<std::pair<std::string, std::string>, std::string> expected;
+        for (int i = 0; i < 40000; ++i) {
+            std::string site = "shop" + std::to_string(i % 9000) + ".example.com";
+            std::string user = "person" + std::to_string(i % 50) + "@mail.example.org";
+            std::string pass = "pw-" + std::to_string(rng());
+            if (i % 1000 == 0) pass = noise.substr(i % 4000, 500);
+            src.emplace(site, user, pass);
+            expected[{site, user}] = pass;
+        }
+        if (!src.save(fname, key)) { std::cerr << "FAIL: uncompressed save\n"; return 1; }
+        std::ifstream plainFile(fname, std::ios::binary | std::ios::ate);
+        const std::streamoff plainSize = plainFile.tellg();
+        plainFile.close();
+        src.setCompression(true);
+        src.setSaveLayout(true);
+        if (!src.save(fname, key)) { std::cerr << "FAIL: compressed save\n"; return 1; }
+        std::ifstream packedFile(fname, std::ios::binary | std::ios::ate);
+        const std::streamoff packedSize = packedFile.tellg();
+        packedFile.close();
+        // The saved layout (about 20 bytes per entry) is not compressed
+        if (packedSize - 20 * static_cast<std::streamoff>(expected.size()) > plainSize / 2) {
+            std::cerr << "FAIL: compressed vault of " << packedSize << " bytes (uncompressed " << plainSize << ")\n"; return 1;
+        }
+        for (int threads : {1, 4}) {
+            HashTable loaded(11);
+            if (!loaded.load(fname, key, threads) || !loaded.loadedLayout() || loaded.size() != static_cast<int>(expected.size())) {
+                std::cerr << "FAIL: load compressed vault\n"; return 1;
+            }
+            for (const auto& e : expected) {
+                Credential* c = loaded.search(e.first.first, e.first.second);
+                if (c == nullptr || std::string_view(c->password) != e.second) { std::cerr << "FAIL: compressed entry " << e.first.first << "\n"; return 1; }
+            }
+        }
+        VaultReader reader;
+        Credential found;
+        if (!reader.open(fname, key)) { std::cerr << "FAIL: VaultReader open compressed\n"; return 1; }
+        for (int i = 0; i < 40000; i += 41) {
+            std::string site = "shop" + std::to_string(i % 9000) + ".example.com";
+            std::string user = "person" + std::to_string(i % 50) + "@mail.example.org";
+            if (!reader.find(site, user, found) || std::string_view(found.password) != expected[{site, user}]) {
+                std::cerr << "FAIL: VaultReader find in compressed vault\n"; return 1;
+            }
+        }
+
+        // The dictionary is covered by the file HMAC (it ends 8 bytes before the layout)
+        std::string bytes;
+        {
+            std::ifstream in(fname, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        const size_t layoutSize = static_cast<size_t>(bytes[bytes.size() - 8] & 0xff) |
+                                  static_cast<size_t>(bytes[bytes.size() - 7] & 0xff) << 8 |
+                                  static_cast<size_t>(bytes[bytes.size() - 6] & 0xff) << 16 |
+                                  static_cast<size_t>(bytes[bytes.size() - 5] & 0xff) << 24;
+        const size_t dictEnd = bytes.size() - 8 - layoutSize - 8;
+        bytes[dictEnd - 1] = static_cast<char>(bytes[dictEnd - 1] ^ 1);
+        {
+            std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        HashTable damaged(11);
+        VaultReader damagedReader;
+        if (damaged.load(fname, key) || damagedReader.open(fname, key)) { std::cerr << "FAIL: accepted a damaged dictionary\n"; return 1; }
+
+        // Journal compaction writes compressed snapshots
+        std::remove(fname.c_str());
+        std::remove((fname + ".log").c_str());
+        {
+            HashTable journaled(11);
+            journaled.setCompression(true);
+            if (!journaled.openJournal(fname, key)) { std::cerr << "FAIL: openJournal for compression\n"; return 1; }
+            for (const auto& e : expected) journaled.emplace(e.first.first, e.first.second, e.second);
+            if (!journaled.compact()) { std::cerr << "FAIL: compact with compression\n"; return 1; }
+        }
+        HashTable reopened(11);
+        if (!reopened.openJournal(fname, key) || reopened.size() != static_cast<int>(expected.size()) ||
+            !reopened.search("shop1.example.com", "person1@mail.example.org")) {
+            std::cerr << "FAIL: reopen a journal with a compressed snapshot\n"; return 1;
+        }
+        reopened.closeJournal();
+        std::remove((fname + ".log").c_str());
+    }
+
+    // CSV import/export: streams across block boundaries (lines split between reads,
+    // CRLF, blank lines, a final line without a newline), updates existing keys,
+    // reports the first malformed line, and export round-trips through import
+    {
+        std::string csv;
+        for (int i = 0; i < 40000; i++) {
+            csv += "\"site" + std::to_string(i % 5000) + ".example.com\",\"user" + std::to_string(i) + "\",\"" +
+                   std::string(static_cast<size_t>(i % 7), 'p') + std::to_string(i) + "\"";
+            csv += i % 3 == 0 ? "\r\n" : "\n";
+            if (i % 1000 == 0) csv += "\n";
+        }
+        csv += "\"site0.example.com\",\"user0\",\"changed\""; // Same key again, no newline
+        std::istringstream in(csv);
+        HashTable imported(11);
+        size_t records = 0, badLine = 0;
+        if (!importCsv(imported, in, &records, &badLine) || records != 40001 || badLine != 0 ||
+            imported.size() != 40000) {
+            std::cerr << "FAIL: importCsv\n"; return 1;
+        }
+        Credential* c = imported.search("site1.example.com", "user1");
+        Credential* changed = imported.search("site0.example.com", "user0");
+        if (!c || c->password != "p1" || !changed || changed->password != "changed") {
+            std::cerr << "FAIL: importCsv records\n"; return 1;
+        }
+
+        std::ostringstream out;
+        size_t exported = 0;
+        if (!exportCsv(imported, out, &exported) || exported != 40000) { std::cerr << "FAIL: exportCsv\n"; return 1; }
+        std::istringstream back(out.str());
+        HashTable roundTrip(11);
+        if (!importCsv(roundTrip, back) || roundTrip.size() != 40000) { std::cerr << "FAIL: CSV round trip\n"; return 1; }
+        bool same = true;
+        imported.forEach([&](const Credential& cred) {
+            Credential* r = roundTrip.search(cred.site, cred.username);
+            same = same && r != nullptr && r->password == cred.password;
+        });
+        if (!same) { std::cerr << "FAIL: CSV round trip contents\n"; return 1; }
+
+        std::istringstream bad("\"a\",\"b\",\"c\"\n\n\"d\",\"e\"\n\"f\",\"g\",\"h\"\n");
+        HashTable partial(11);
+        if (importCsv(partial, bad, &records, &badLine) || badLine != 3 || records != 1 || partial.size() != 1) {
+            std::cerr << "FAIL: importCsv malformed line\n"; return 1;
+        }
+        // Line numbers count the line breaks inside quoted fields
+        std::istringstream afterBreak("\"a\",\"two\nlines\",\"c\"\n\"d\",\"e\"x,\"f\"\n");
+        HashTable partial2(11);
+        if (importCsv(partial2, afterBreak, &records, &badLine) || badLine != 3 || records != 1) {
+            std::cerr << "FAIL: importCsv line number after a quoted line break\n"; return 1;
+        }
+    }
+
+    // CSV quoting: fields with quotes, commas, line breaks and surrounding spaces
+    // export and import back exactly, records with quoted line breaks span the
+    // 1 MiB blocks, and bare fields and spaces around quotes are accepted
+    {
+        const char alphabet[] = {'"', ',', '\n', '\r', ' ', 'a', 'b', '\t'};
+        std::mt19937 rng(4180);
+        HashTable table(11);
+        for (int i = 0; i < 30000; i++) {
+            std::string fields[3];
+            for (std::string& f : fields) {
+                const size_t len = rng() % 24;
+                for (size_t k = 0; k < len; k++) f += alphabet[rng() % sizeof(alphabet)];
+            }
+            table.emplace(fields[0] + std::to_string(i), fields[1], fields[2]);
+            Credential cred(fields[0], fields[1], fields[2]);
+            Credential back = Credential::fromCSV(cred.toCSV());
+            if (back.site != cred.site || back.username != cred.username || back.password != cred.password) {
+                std::cerr << "FAIL: toCSV/fromCSV round trip\n"; return 1;
+            }
+        }
+        std::ostringstream out;
+        if (!exportCsv(table, out)) { std::cerr << "FAIL: exportCsv with quoting\n"; return 1; }
+        std::istringstream in(out.str());
+        HashTable back(11);
+        size_t records = 0, badLine = 0;
+        if (out.str().size() < (1 << 20) || !importCsv(back, in, &records, &badLine) || records != 30000 ||
+            back.size() != 30000) {
+            std::cerr << "FAIL: importCsv of quoted fields, line " << badLine << "\n"; return 1;
+        }
+        bool same = true;
+        table.forEach([&](const Credential& cred) {
+            const Credential* r = back.search(cred.site, cred.username);
+            same = same && r != nullptr && r->password == cred.password;
+        });
+        if (!same) { std::cerr << "FAIL: CSV quoting round trip contents\n"; return 1; }
+
+        std::istringstream loose("bare.com,bob,pw\r\n  \"q.com\" , \"say \"\"hi\"\"\",\"\"\n");
+        HashTable looseTable(11);
+        const Credential* bare = nullptr;
+        const Credential* quoted = nullptr;
+        if (importCsv(looseTable, loose, &records)) {
+            bare = looseTable.search("bare.com", "bob");
+            quoted = looseTable.search("q.com", "say \"hi\"");
+        }
+        if (records != 2 || !bare || bare->password != "pw" || !quoted || !quoted->password.empty()) {
+            std::cerr << "FAIL: importCsv bare fields and spaces\n"; return 1;
+        }
+    }
+
+    // Stats: the index shape is always reported; the counters only in a
+    // HASHTABLE_STATS build, where they must add up
+    {
+        HashTable table(11);
+        for (int i = 0; i < 1000; i++) table.emplace("site" + std::to_string(i), "user", "pw");
+        TableStats s = table.stats();
+        int histogramTotal = 0;
+        for (int n : s.probeLengths) histogramTotal += n;
+        if (s.size != 1000 || s.capacity < 1000 || s.loadFactor <= 0 || s.loadFactor > 0.875 ||
+            histogramTotal != 1000 || s.maxProbeLength != static_cast<int>(s.probeLengths.size()) - 1) {
+            std::cerr << "FAIL: stats index shape\n"; return 1;
+        }
+        if (s.countersEnabled != (HASHTABLE_STATS != 0)) { std::cerr << "FAIL: stats countersEnabled\n"; return 1; }
+#if HASHTABLE_STATS
+        table.resetStats();
+        for (int i = 0; i < 100; i++) table.search("site" + std::to_string(i), "user");
+        for (int i = 0; i < 50; i++) table.search("absent" + std::to_string(i), "user");
+        table.rehash(table.stats().capacity * 2);
+        if (!table.save(fname, "stats-key")) { std::cerr << "FAIL: save for stats\n"; return 1; }
+        HashTable loaded(11);
+        if (!loaded.load(fname, "stats-key")) { std::cerr << "FAIL: load for stats\n"; return 1; }
+        s = table.stats();
+        TableStats l = loaded.stats();
+        if (s.hits != 100 || s.misses != 50 || s.lookups != 150 || s.groupsProbed < 150 || s.probesPerLookup() < 1 ||
+            s.rehashes != 1 || s.rehashSeconds <= 0) {
+            std::cerr << "FAIL: stats lookup and rehash counters\n"; return 1;
+        }
+        if (s.save.runs != 1 || s.save.serialize <= 0 || s.save.cipher <= 0 || s.save.mac <= 0 || s.save.io <= 0 ||
+            l.load.runs != 1 || l.load.parse <= 0 || l.load.cipher <= 0 || l.load.mac <= 0 || s.load.runs != 0) {
+            std::cerr << "FAIL: stats save/load phases\n"; return 1;
+        }
+        table.resetStats();
+        s = table.stats();
+        if (s.lookups != 0 || s.rehashes != 0 || s.save.runs != 0 || s.save.io != 0) { std::cerr << "FAIL: resetStats\n"; return 1; }
+#else
+        if (s.lookups != 0 || s.rehashes != 0 || s.save.runs != 0) { std::cerr << "FAIL: stats counters without HASHTABLE_STATS\n"; return 1; }
+#endif
+    }
+
+    // Secondary indexes: after random inserts, updates, removes and growth, after
+    // load() (serial and parallel) and journal replay, every site and username range
+    // holds exactly the matching entries
+    {
+        typedef std::map<std::pair<std::string, std::string>, std::string> Model;
+        auto matches = [](HashTable& table, const Model& model) {
+            std::map<std::string, std::multiset<std::string>> bySite, byUser;
+            for (const auto& e : model) {
+                bySite[e.first.first].insert(e.first.second + "/" + e.second);
+                byUser[e.first.second].insert(e.first.first + "/" + e.second);
+            }
+            for (const auto& site : bySite) {
+                std::multiset<std::string> found;
+                HashTable::EntryRange range = table.entriesForSite(site.first);
+                for (const Credential& c : range) {
+                    if (std::string_view(c.site) != site.first) return false;
+                    found.insert(std::string(c.username) + "/" + std::string(c.password));
+                }
+                if (found != site.second || range.size() != found.size()) return false;
+            }
+            for (const auto& user : byUser) {
+                std::multiset<std::string> found;
+                for (const Credential& c : table.entriesForUsername(user.first)) {
+                    if (std::string_view(c.username) != user.first) return false;
+                    found.insert(std::string(c.site) + "/" + std::string(c.password));
+                }
+                if (found != user.second || table.entriesForUsername(user.first).size() != found.size()) return false;
+            }
+            return table.entriesForSite("absent").empty() && table.entriesForUsername("absent").empty();
+        };
+
+        HashTable table(11);
+        Model model;
+        for (int i = 0; i < 300; i++) {
+            table.emplace("s" + std::to_string(i % 40), "u" + std::to_string(i % 70), "old");
+            model[std::make_pair("s" + std::to_string(i % 40), "u" + std::to_string(i % 70))] = "old";
+        }
+        table.setSecondaryIndexes(true);
+        if (!table.secondaryIndexes() || !matches(table, model)) { std::cerr << "FAIL: secondary index build\n"; return 1; }
+
+        std::mt19937 rng(25);
+        for (int i = 0; i < 20000; i++) { // Grows incrementally several times and churns node ids
+            const std::string site = "s" + std::to_string(rng() % 400);
+            const std::string user = "u" + std::to_string(rng() % 300);
+            const std::string pass = "p" + std::to_string(i);
+            switch (rng() % 4) {
+                case 0: case 1: table.emplace(site, user, pass); model[std::make_pair(site, user)] = pass; break;
+                case 2: if (table.update(site, user, pass)) model[std::make_pair(site, user)] = pass; break;
+                default: table.remove(site, user); model.erase(std::make_pair(site, user)); break;
+            }
+        }
+        if (!matches(table, model)) { std::cerr << "FAIL: secondary indexes after churn\n"; return 1; }
+        Credential* first = table.search(model.begin()->first.first);
+        if (first == nullptr || std::string_view(first->site) != model.begin()->first.first) { std::cerr << "FAIL: search(site) via index\n"; return 1; }
+        table.rehash(table.stats().capacity * 4);
+        if (!matches(table, model)) { std::cerr << "FAIL: secondary indexes after rehash\n"; return 1; }
+
+        if (!table.save(fname, key)) { std::cerr << "FAIL: save for secondary indexes\n"; return 1; }
+        for (int threads : {1, 4}) {
+            HashTable loaded(11);
+            loaded.setSecondaryIndexes(true);
+            loaded.emplace("stale", "stale", "x"); // Replaced by the file's contents
+            if (!loaded.load(fname, key, threads) || !matches(loaded, model) || !loaded.entriesForSite("stale").empty()) {
+                std::cerr << "FAIL: secondary indexes after load (" << threads << " threads)\n"; return 1;
+            }
+        }
+
+        std::remove((fname + ".log").c_str());
+        {
+            HashTable journaled(11);
+            if (!journaled.openJournal(fname, key)) { std::cerr << "FAIL: open journal for secondary indexes\n"; return 1; }
+            journaled.emplace("journal.com", "u1", "j");
+            journaled.remove(model.begin()->first.first, model.begin()->first.second);
+            journaled.closeJournal();
+        }
+        model.erase(model.begin());
+        model[std::make_pair("journal.com", "u1")] = "j";
+        HashTable replayed(11);
+        replayed.setSecondaryIndexes(true);
+        if (!replayed.openJournal(fname, key) || !matches(replayed, model)) {
+            std::cerr << "FAIL: secondary indexes after journal replay\n"; return 1;
+        }
+        replayed.closeJournal();
+        std::remove((fname + ".log").c_str());
+
+        table.clear();
+        if (!table.entriesForSite("s1").empty() || !matches(table, Model())) { std::cerr << "FAIL: secondary indexes after clear\n"; return 1; }
+        table.emplace("a.com", "bob", "pw");
+        table.setSecondaryIndexes(false);
+        if (table.secondaryIndexes() || !table.entriesForSite("a.com").empty() || table.search("a.com") == nullptr) {
+            std::cerr << "FAIL: disabling secondary indexes\n"; return 1;
+        }
+    }
+
+    // Daemon: every operation over the socket, binary-safe fields, a deep pipeline
+    // answered in order, several clients at once, a malformed request closing only
+    // its own connection, a stored field too long for the protocol, and stop()
+    // ending run() and removing the socket file
+#if defined(__linux__)
+    {
+        const std::string socketPath = "test_vault.sock";
+        HashTable served(11);
+        for (int i = 0; i < 1000; i++) served.emplace("site" + std::to_string(i), "user", "pw" + std::to_string(i));
+        served.emplace("long", "user", std::string(70000, 'x'));
+        VaultServer server(served);
+        if (!server.listen(socketPath)) { std::cerr << "FAIL: server listen\n"; return 1; }
+        std::atomic<bool> runOk{false};
+        std::thread loop([&] { runOk = server.run(); });
+
+        VaultClient client;
+        VaultClient::Response r;
+        if (!client.connect(socketPath)) { std::cerr << "FAIL: client connect\n"; return 1; }
+        const std::string binary("n\0l\"\n", 5);
+        bool ok = client.call(VAULT_FIND, "site7", "user", "", r) && r.status == VAULT_OK && r.site == "site7" &&
+                  r.username == "user" && r.password == "pw7";
+        ok = ok && client.call(VAULT_FIND, "site7", "", "", r) && r.status == VAULT_OK && r.password == "pw7";
+        ok = ok && client.call(VAULT_FIND, "absent", "user", "", r) && r.status == VAULT_NOT_FOUND && r.site.empty();
+        ok = ok && client.call(VAULT_ADD, binary, "user", binary, r) && r.status == VAULT_OK;
+        ok = ok && client.call(VAULT_FIND, binary, "user", "", r) && r.status == VAULT_OK && r.password == binary;
+        ok = ok && client.call(VAULT_UPDATE, "site8", "user", "new", r) && r.status == VAULT_OK;
+        ok = ok && client.call(VAULT_UPDATE, "absent", "user", "new", r) && r.status == VAULT_NOT_FOUND;
+        ok = ok && client.call(VAULT_DELETE, "site9", "user", "", r) && r.status == VAULT_OK;
+        ok = ok && client.call(VAULT_DELETE, "site9", "user", "", r) && r.status == VAULT_NOT_FOUND;
+        if (!ok) { std::cerr << "FAIL: daemon operations\n"; return 1; }
+        // Not sent with a truncated u16 length: refused, and the connection goes on
+        if (!client.call(VAULT_FIND, "long", "user", "", r) || r.status != VAULT_BAD_REQUEST || !r.password.empty() ||
+            !client.call(VAULT_FIND, "site7", "user", "", r) || r.password != "pw7") {
+            std::cerr << "FAIL: daemon field over 65535 bytes\n"; return 1;
+        }
+
+        // 5000 requests in one flush: read and answered across many partial frames
+        for (int i = 0; i < 5000; i++) client.queue(VAULT_FIND, "site" + std::to_string(i % 1200), "user");
+        if (!client.flush()) { std::cerr << "FAIL: daemon pipeline flush\n"; return 1; }
+        for (int i = 0; i < 5000 && ok; i++) {
+            const int site = i % 1200;
+            const bool present = site < 1000 && site != 9;
+            ok = client.next(r) && r.status == (present ? VAULT_OK : VAULT_NOT_FOUND) &&
+                 (!present || r.password == (site == 8 ? "new" : "pw" + std::to_string(site)));
+        }
+        if (!ok) { std::cerr << "FAIL: daemon pipelined answers\n"; return 1; }
+
+        std::atomic<int> clientFailures{0};
+        std::vector<std::thread> clients;
+        for (int t = 0; t < 4; t++) {
+            clients.emplace_back([&, t] {
+                VaultClient c;
+                VaultClient::Response answer;
+                if (!c.connect(socketPath)) { clientFailures++; return; }
+                for (int i = 0; i < 500; i++) {
+                    const std::string site = "t" + std::to_string(t) + "-" + std::to_string(i);
+                    if (!c.call(VAULT_ADD, site, "user", "x", answer) || answer.status != VAULT_OK ||
+                        !c.call(VAULT_FIND, site, "user", "", answer) || answer.password != "x") {
+                        clientFailures++;
+                    }
+                }
+            });
+        }
+        for (std::thread& t : clients) t.join();
+        if (clientFailures != 0) { std::cerr << "FAIL: concurrent daemon clients\n"; return 1; }
+
+        VaultClient badClient;
+        if (!badClient.connect(socketPath) || !badClient.call(static_cast<VaultOp>(9), "a", "b", "", r) ||
+            r.status != VAULT_BAD_REQUEST || badClient.call(VAULT_FIND, "site1", "user", "", r)) {
+            std::cerr << "FAIL: daemon malformed request\n"; return 1;
+        }
+        if (!client.call(VAULT_FIND, "site1", "user", "", r) || r.status != VAULT_OK) {
+            std::cerr << "FAIL: daemon after a malformed request\n"; return 1;
+        }
+
+        server.stop();
+        loop.join();
+        if (!runOk || server.requestsServed() < 5000 + 4000 || served.size() != 1001 + 2000 ||
+            std::ifstream(socketPath).good()) {
+            std::cerr << "FAIL: daemon stop\n"; return 1;
+        }
+    }
+
+    // Daemon on a journaled vault: changes are answered only after a commit, so the
+    // acknowledged ones are on disk and a reopen sees them
+    {
+        const std::string socketPath = "test_vault.sock";
+        const std::string vault = "test_served.bin";
+        HashTable seed(11);
+        seed.emplace("keep.com", "user", "pw");
+        seed.emplace("gone.com", "user", "pw");
+        if (!seed.save(vault, "k")) { std::cerr << "FAIL: daemon vault save\n"; return 1; }
+
+        HashTable served(11);
+        served.openJournal(vault, "k");
+        VaultServer server(served);
+        if (!server.listen(socketPath)) { std::cerr << "FAIL: journaled server listen\n"; return 1; }
+        std::thread loop([&] { server.run(); });
+        VaultClient client;
+        VaultClient::Response r;
+        bool ok = client.connect(socketPath);
+        client.queue(VAULT_ADD, "new.com", "user", "fresh");
+        client.queue(VAULT_UPDATE, "keep.com", "user", "changed");
+        client.queue(VAULT_DELETE, "gone.com", "user");
+        client.queue(VAULT_FIND, "new.com", "user");
+        ok = ok && client.flush();
+        for (int i = 0; i < 4 && ok; i++) ok = client.next(r) && r.status == VAULT_OK;
+        if (!ok) { std::cerr << "FAIL: journaled daemon answers\n"; return 1; }
+        if (served.journalCommits() == 0) { std::cerr << "FAIL: daemon answered changes before a commit\n"; return 1; }
+
+        // Read the files while the server still holds the journal open
+        HashTable reopened(11);
+        const Credential* fresh = nullptr;
+        const Credential* kept = nullptr;
+        if (reopened.openJournal(vault, "k")) {
+            fresh = reopened.search("new.com", "user");
+            kept = reopened.search("keep.com", "user");
+        }
+        if (fresh == nullptr || fresh->password != "fresh" || kept == nullptr || kept->password != "changed" ||
+            reopened.search("gone.com", "user") != nullptr) {
+            std::cerr << "FAIL: acknowledged daemon changes not on disk\n"; return 1;
+        }
+        reopened.closeJournal();
+        client.close();
+        server.stop();
+        loop.join();
+        served.closeJournal();
+        std::remove(vault.c_str());
+        std::remove((vault + ".log").c_str());
+    }
+#endif
+
     // Cleanup
     std::remove(fname.c_str());
 